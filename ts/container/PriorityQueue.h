@@ -1,16 +1,27 @@
 #pragma once
 
-#include <list>
+#include <vector>
 #include <algorithm>
+#include <functional>
 
 TS_PACKAGE1(util)
 
+/* Indexed 4-ary heap, the element the sorting predicate orders first is on top.
+ * push, pop, erase and update are O(log n), top and contains are O(1).
+ *
+ * Every pushed element gets a handle that stays valid until the element is popped or erased,
+ * handles of removed elements are never mistaken for newer ones. Iteration goes through the
+ * elements in heap order, not in sorted order.
+ */
 template<class Type, class SortingPredicate = std::less<Type>>
 class PriorityQueue
 {
-	typedef std::list<Type> Container;
+	typedef std::vector<Type> Container;
 
 public:
+	typedef BigSizeType Handle;
+	static constexpr Handle InvalidHandle = ~0ULL;
+
 	typedef typename Container::iterator iterator;
 	typedef typename Container::const_iterator const_iterator;
 
@@ -22,69 +33,115 @@ public:
 	PriorityQueue(PriorityQueue &&) = delete;
 	PriorityQueue &operator=(PriorityQueue &&) = delete;
 
-	iterator begin() { return container.begin(); }
-	iterator end() { return container.end(); }
-	const_iterator begin() const { return container.begin(); }
-	const_iterator end() const { return container.end(); }
+	iterator begin() { return values.begin(); }
+	iterator end() { return values.end(); }
+	const_iterator begin() const { return values.begin(); }
+	const_iterator end() const { return values.end(); }
 
 	bool empty() const
 	{
-		return container.empty();
+		return values.empty();
 	}
 
 	BigSizeType size() const
 	{
-		return container.size();
+		return values.size();
 	}
 
-	void push(const Type &value)
+	Handle push(const Type &value)
 	{
-		container.push_back(value);
-		container.sort(sorting);
+		values.push_back(value);
+		return pushHandle();
 	}
 
-	void push(Type &&value)
+	Handle push(Type &&value)
 	{
-		container.push_back(std::move(value));
-		container.sort(sorting);
+		values.push_back(std::move(value));
+		return pushHandle();
 	}
 
 	Type &top()
 	{
 		TS_ASSERT(!empty());
-		return container.front();
+		return values.front();
 	}
 
 	const Type &top() const
 	{
 		TS_ASSERT(!empty());
-		return container.front();
+		return values.front();
+	}
+
+	Handle topHandle() const
+	{
+		TS_ASSERT(!empty());
+		return makeHandle(slotIndices.front());
 	}
 
 	void pop()
 	{
 		TS_ASSERT(!empty());
-		container.pop_front();
+		removeAt(0);
 	}
 
-	iterator find_if(std::function<bool(const Type &)> predicate)
+	bool contains(Handle handle) const
 	{
-		for (iterator it = begin(); it != end(); ++it)
-		{
-			if (predicate(*it))
-				return it;
-		}
-		return end();
+		return findPosition(handle) != InvalidPosition;
+	}
+
+	// Element of a handle that's in the queue
+	Type &get(Handle handle)
+	{
+		const SizeType position = findPosition(handle);
+		TS_ASSERT(position != InvalidPosition && "Handle is not in the queue.");
+		return values[position];
+	}
+
+	// Returns false if the handle isn't in the queue
+	bool erase(Handle handle)
+	{
+		const SizeType position = findPosition(handle);
+		if (position == InvalidPosition)
+			return false;
+
+		removeAt(position);
+		return true;
+	}
+
+	/* Moves the element to its place after whatever it's sorted by has changed,
+	 * either way, so it works as both decrease-key and increase-key.
+	 * Returns false if the handle isn't in the queue.
+	 */
+	bool update(Handle handle)
+	{
+		const SizeType position = findPosition(handle);
+		if (position == InvalidPosition)
+			return false;
+
+		restore(position);
+		return true;
+	}
+
+	bool update(Handle handle, const Type &value)
+	{
+		const SizeType position = findPosition(handle);
+		if (position == InvalidPosition)
+			return false;
+
+		values[position] = value;
+		restore(position);
+		return true;
 	}
 
-	iterator erase(iterator it)
+	iterator find_if(std::function<bool(const Type &)> predicate)
 	{
-		return container.erase(it);
+		return std::find_if(values.begin(), values.end(), predicate);
 	}
 
-	const_iterator erase(const_iterator it)
+	// Invalidates all iterators, the heap is reordered around the erased element
+	void erase(const_iterator it)
 	{
-		return container.erase(it);
+		removeAt((SizeType)(it - values.cbegin()));
 	}
 
 	bool erase_if(std::function<bool(const Type &)> predicate)
@@ -100,11 +157,175 @@ public:
 
 	void clear()
 	{
-		container.clear();
+		for (SizeType slotIndex : slotIndices)
+			releaseSlot(slotIndex);
+
+		values.clear();
+		slotIndices.clear();
+	}
+
+	void reserve(SizeType capacity)
+	{
+		values.reserve(capacity);
+		slotIndices.reserve(capacity);
+		slots.reserve(capacity);
 	}
 
 private:
-	std::list<Type> container;
+	static constexpr SizeType Arity = 4;
+	static constexpr SizeType InvalidPosition = ~0U;
+
+	// Handles point to slots, slots point to positions in the heap.
+	// Generation changes every time a slot is released so old handles stop matching.
+	struct Slot
+	{
+		SizeType position = InvalidPosition;
+		SizeType generation = 0;
+	};
+
+	Handle makeHandle(SizeType slotIndex) const
+	{
+		return ((Handle)slots[slotIndex].generation << 32) | slotIndex;
+	}
+
+	SizeType findPosition(Handle handle) const
+	{
+		const SizeType slotIndex = (SizeType)(handle & 0xFFFFFFFFULL);
+		const SizeType generation = (SizeType)(handle >> 32);
+
+		if (slotIndex >= slots.size() || slots[slotIndex].generation != generation)
+			return InvalidPosition;
+
+		return slots[slotIndex].position;
+	}
+
+	// Value was appended to the heap, gives it a slot and moves it in place
+	Handle pushHandle()
+	{
+		SizeType slotIndex;
+		if (!freeSlots.empty())
+		{
+			slotIndex = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			slotIndex = (SizeType)slots.size();
+			slots.emplace_back();
+		}
+
+		const SizeType position = (SizeType)values.size() - 1;
+		slotIndices.push_back(slotIndex);
+		slots[slotIndex].position = position;
+
+		siftUp(position);
+		return makeHandle(slotIndex);
+	}
+
+	void releaseSlot(SizeType slotIndex)
+	{
+		slots[slotIndex].position = InvalidPosition;
+		slots[slotIndex].generation++;
+		freeSlots.push_back(slotIndex);
+	}
+
+	void removeAt(SizeType position)
+	{
+		TS_ASSERT(position < values.size());
+
+		releaseSlot(slotIndices[position]);
+
+		const SizeType last = (SizeType)values.size() - 1;
+		if (position != last)
+		{
+			values[position] = std::move(values[last]);
+			slotIndices[position] = slotIndices[last];
+			slots[slotIndices[position]].position = position;
+		}
+
+		values.pop_back();
+		slotIndices.pop_back();
+
+		if (position < values.size())
+			restore(position);
+	}
+
+	void restore(SizeType position)
+	{
+		if (position > 0 && sorting(values[position], values[(position - 1) / Arity]))
+			siftUp(position);
+		else
+			siftDown(position);
+	}
+
+	void moveTo(SizeType from, SizeType to)
+	{
+		values[to] = std::move(values[from]);
+		slotIndices[to] = slotIndices[from];
+		slots[slotIndices[to]].position = to;
+	}
+
+	// Moving the element through a hole instead of swapping saves a move per level
+	void siftUp(SizeType position)
+	{
+		Type value = std::move(values[position]);
+		const SizeType slotIndex = slotIndices[position];
+
+		while (position > 0)
+		{
+			const SizeType parent = (position - 1) / Arity;
+			if (!sorting(value, values[parent]))
+				break;
+
+			moveTo(parent, position);
+			position = parent;
+		}
+
+		values[position] = std::move(value);
+		slotIndices[position] = slotIndex;
+		slots[slotIndex].position = position;
+	}
+
+	void siftDown(SizeType position)
+	{
+		const SizeType count = (SizeType)values.size();
+
+		Type value = std::move(values[position]);
+		const SizeType slotIndex = slotIndices[position];
+
+		while (true)
+		{
+			const SizeType firstChild = position * Arity + 1;
+			if (firstChild >= count)
+				break;
+
+			SizeType best = firstChild;
+			const SizeType lastChild = std::min(firstChild + Arity, count);
+			for (SizeType child = firstChild + 1; child < lastChild; ++child)
+			{
+				if (sorting(values[child], values[best]))
+					best = child;
+			}
+
+			if (!sorting(values[best], value))
+				break;
+
+			moveTo(best, position);
+			position = best;
+		}
+
+		values[position] = std::move(value);
+		slotIndices[position] = slotIndex;
+		slots[slotIndex].position = position;
+	}
+
+	// Heap order, slotIndices[i] is the slot of values[i]
+	Container values;
+	std::vector<SizeType> slotIndices;
+
+	std::vector<Slot> slots;
+	std::vector<SizeType> freeSlots;
+
 	SortingPredicate sorting;
 };
 
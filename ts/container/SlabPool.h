@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+TS_PACKAGE1(util)
+
+/* Recycles fixed size storage for objects of one type. Storage is allocated in slabs
+ * of several objects and freed storage is reused before a new slab is allocated,
+ * so once the pool has grown to its working size it no longer allocates at all.
+ *
+ * Only storage is handed out, the caller constructs and destroys the objects.
+ * Not thread safe, slabs are freed when the pool is destroyed.
+ */
+template<class Type, SizeType NumObjectsPerSlab = 64>
+class SlabPool : public lang::Noncopyable
+{
+public:
+	SlabPool() = default;
+
+	~SlabPool()
+	{
+		for (Slot *slab : slabs)
+			delete[] slab;
+	}
+
+	// Returns: uninitialized storage for one object
+	void *allocate()
+	{
+		if (freeSlots == nullptr)
+			allocateSlab();
+
+		Slot *slot = freeSlots;
+		freeSlots = slot->next;
+		numAllocated++;
+		return slot->storage;
+	}
+
+	// Object must have been destroyed already
+	void free(void *storage)
+	{
+		TS_ASSERT(storage != nullptr && numAllocated > 0);
+
+		Slot *slot = static_cast<Slot *>(storage);
+		slot->next = freeSlots;
+		freeSlots = slot;
+		numAllocated--;
+	}
+
+	SizeType getNumAllocated() const
+	{
+		return numAllocated;
+	}
+
+	SizeType getCapacity() const
+	{
+		return (SizeType)slabs.size() * NumObjectsPerSlab;
+	}
+
+private:
+	union Slot
+	{
+		Slot *next;
+		alignas(Type) Byte storage[sizeof(Type)];
+	};
+
+	void allocateSlab()
+	{
+		Slot *slab = new Slot[NumObjectsPerSlab];
+		slabs.push_back(slab);
+
+		// Chained in order so consecutive allocations are next to each other
+		for (SizeType i = 0; i < NumObjectsPerSlab; ++i)
+			slab[i].next = i + 1 < NumObjectsPerSlab ? &slab[i + 1] : freeSlots;
+		freeSlots = slab;
+	}
+
+	std::vector<Slot *> slabs;
+	Slot *freeSlots = nullptr;
+	SizeType numAllocated = 0;
+};
+
+TS_END_PACKAGE1()
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <functional>
+#include <type_traits>
+#include <new>
+
+TS_PACKAGE1(util)
+
+template<class Signature, SizeType InlineSize = 64>
+class SmallFunction;
+
+/* Move-only counterpart of std::function that keeps callables of up to InlineSize bytes
+ * inside itself instead of allocating them. Larger callables, and ones that may throw
+ * when moved, are allocated on the heap the way std::function would.
+ * Since it's never copied, move-only callables such as lambdas holding a promise are fine.
+ */
+template<class ReturnType, class... Args, SizeType InlineSize>
+class SmallFunction<ReturnType(Args...), InlineSize>
+{
+	static_assert(InlineSize >= sizeof(void *), "Inline storage has to fit at least a pointer to a heap allocated callable.");
+
+public:
+	SmallFunction() = default;
+
+	SmallFunction(std::nullptr_t)
+	{
+	}
+
+	template<class Function, class = typename std::enable_if<!std::is_same<typename std::decay<Function>::type, SmallFunction>::value>::type>
+	SmallFunction(Function &&function)
+	{
+		typedef typename std::decay<Function>::type FunctionType;
+
+		if constexpr (fitsInline<FunctionType>())
+		{
+			new (storage) FunctionType(std::forward<Function>(function));
+			operations = &InlineOperations<FunctionType>::operations;
+		}
+		else
+		{
+			*reinterpret_cast<FunctionType **>(storage) = new FunctionType(std::forward<Function>(function));
+			operations = &HeapOperations<FunctionType>::operations;
+		}
+	}
+
+	~SmallFunction()
+	{
+		reset();
+	}
+
+	SmallFunction(SmallFunction &&other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	SmallFunction &operator=(SmallFunction &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			moveFrom(other);
+		}
+		return *this;
+	}
+
+	ReturnType operator()(Args... args)
+	{
+		TS_ASSERT(operations != nullptr && "Calling an empty function.");
+		return operations->invoke(storage, std::forward<Args>(args)...);
+	}
+
+	void reset()
+	{
+		if (operations != nullptr)
+		{
+			operations->destroy(storage);
+			operations = nullptr;
+		}
+	}
+
+	// Returns true if the callable is stored without a heap allocation
+	bool isInline() const
+	{
+		return operations != nullptr && operations->isInline;
+	}
+
+	explicit operator bool() const
+	{
+		return operations != nullptr;
+	}
+
+	template<class FunctionType>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(FunctionType) <= InlineSize &&
+			alignof(FunctionType) <= alignof(std::max_align_t) &&
+			std::is_nothrow_move_constructible<FunctionType>::value;
+	}
+
+private:
+	struct Operations
+	{
+		ReturnType (*invoke)(void *storage, Args&&... args);
+		// Move constructs into the destination and destroys the source
+		void (*move)(void *source, void *destination);
+		void (*destroy)(void *storage);
+		bool isInline;
+	};
+
+	template<class FunctionType>
+	struct InlineOperations
+	{
+		static ReturnType invoke(void *storage, Args&&... args)
+		{
+			return std::invoke(*static_cast<FunctionType *>(storage), std::forward<Args>(args)...);
+		}
+
+		static void move(void *source, void *destination)
+		{
+			new (destination) FunctionType(std::move(*static_cast<FunctionType *>(source)));
+			static_cast<FunctionType *>(source)->~FunctionType();
+		}
+
+		static void destroy(void *storage)
+		{
+			static_cast<FunctionType *>(storage)->~FunctionType();
+		}
+
+		static constexpr Operations operations = { &invoke, &move, &destroy, true };
+	};
+
+	template<class FunctionType>
+	struct HeapOperations
+	{
+		static ReturnType invoke(void *storage, Args&&... args)
+		{
+			return std::invoke(**static_cast<FunctionType **>(storage), std::forward<Args>(args)...);
+		}
+
+		static void move(void *source, void *destination)
+		{
+			*static_cast<FunctionType **>(destination) = *static_cast<FunctionType **>(source);
+		}
+
+		static void destroy(void *storage)
+		{
+			delete *static_cast<FunctionType **>(storage);
+		}
+
+		static constexpr Operations operations = { &invoke, &move, &destroy, false };
+	};
+
+	void moveFrom(SmallFunction &other)
+	{
+		if (other.operations != nullptr)
+		{
+			other.operations->move(other.storage, storage);
+			operations = std::exchange(other.operations, nullptr);
+		}
+	}
+
+	alignas(std::max_align_t) Byte storage[InlineSize];
+	const Operations *operations = nullptr;
+};
+
+TS_END_PACKAGE1()
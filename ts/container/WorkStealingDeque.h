@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+TS_PACKAGE1(util)
+
+/* Chase-Lev work stealing deque, with the memory orderings from
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al. 2013).
+ *
+ * The owning thread pushes and pops at the bottom, any other thread may steal from the top.
+ * Nothing takes a lock, the owner only contends with thieves over the last element.
+ * Type has to be trivially copyable, in practice a pointer.
+ */
+template<class Type>
+class WorkStealingDeque : public lang::Noncopyable
+{
+public:
+	explicit WorkStealingDeque(int64_t initialCapacity = 64)
+	{
+		TS_ASSERT(initialCapacity > 0 && (initialCapacity & (initialCapacity - 1)) == 0 && "Capacity must be a power of two.");
+		array.store(new Array(initialCapacity), std::memory_order_relaxed);
+	}
+
+	~WorkStealingDeque()
+	{
+		delete array.load(std::memory_order_relaxed);
+		for (Array *retired : retiredArrays)
+			delete retired;
+	}
+
+	// Owner only
+	void push(Type value)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		Array *a = array.load(std::memory_order_relaxed);
+
+		if (b - t > a->capacity - 1)
+			a = grow(a, t, b);
+
+		a->put(b, value);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	// Owner only, takes the most recently pushed element. Returns false if empty.
+	bool pop(Type &value)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Array *a = array.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		value = a->get(b);
+		if (t == b)
+		{
+			// Last element, a thief may be taking it at the same time
+			const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	// Any thread, takes the oldest element. Returns false if empty or another thread got it first.
+	bool steal(Type &value)
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return false;
+
+		Array *a = array.load(std::memory_order_acquire);
+		value = a->get(t);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	// Approximate when other threads are pushing or popping
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	SizeType size() const
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_relaxed);
+		return b > t ? (SizeType)(b - t) : 0;
+	}
+
+private:
+	struct Array
+	{
+		explicit Array(int64_t capacity)
+			: capacity(capacity)
+			, mask(capacity - 1)
+			, buffer(new std::atomic<Type>[capacity])
+		{
+		}
+
+		~Array()
+		{
+			delete[] buffer;
+		}
+
+		Type get(int64_t index) const
+		{
+			return buffer[index & mask].load(std::memory_order_relaxed);
+		}
+
+		void put(int64_t index, Type value)
+		{
+			buffer[index & mask].store(value, std::memory_order_relaxed);
+		}
+
+		const int64_t capacity;
+		const int64_t mask;
+		std::atomic<Type> *buffer;
+	};
+
+	Array *grow(Array *current, int64_t t, int64_t b)
+	{
+		Array *grown = new Array(current->capacity * 2);
+		for (int64_t i = t; i < b; ++i)
+			grown->put(i, current->get(i));
+
+		// Thieves may still be reading from the old array, it's kept until the deque is destroyed
+		retiredArrays.push_back(current);
+		array.store(grown, std::memory_order_release);
+		return grown;
+	}
+
+	alignas(64) std::atomic<int64_t> top = 0;
+	alignas(64) std::atomic<int64_t> bottom = 0;
+	alignas(64) std::atomic<Array *> array = nullptr;
+
+	std::vector<Array *> retiredArrays;
+};
+
+TS_END_PACKAGE1()
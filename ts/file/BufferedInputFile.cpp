@@ -0,0 +1,307 @@
+#include "Precompiled.h"
+#include "ts/file/BufferedInputFile.h"
+
+TS_PACKAGE1(file)
+
+// Reads going to the file are limited by InputFile taking 32-bit sizes
+static const BigSizeType MaxFileReadSize = 1024 * 1024 * 1024;
+
+BufferedInputFile::BufferedInputFile()
+{
+}
+
+BufferedInputFile::~BufferedInputFile()
+{
+	close();
+}
+
+bool BufferedInputFile::open(const String &filepath, SizeType blockSizeParam, BackingMode backingMode)
+{
+	TS_ASSERT(!isOpen() && "BufferedInputFile is already opened.");
+	if (isOpen())
+		return false;
+
+	if (backingMode == Backing_PreferMapping && mappedFile.open(filepath, MappedFileAccess_Sequential))
+	{
+		memory = mappedFile.getData();
+		filesize = mappedFile.getSize();
+		return true;
+	}
+
+	InputFile fileParam;
+	if (!fileParam.open(filepath, InputFileMode_ReadBinary))
+		return false;
+
+	return open(std::move(fileParam), blockSizeParam);
+}
+
+bool BufferedInputFile::open(InputFile &&fileParam, SizeType blockSizeParam, const Byte *prefetched, SizeType numPrefetched)
+{
+	TS_ASSERT(!isOpen() && "BufferedInputFile is already opened.");
+	if (isOpen())
+		return false;
+
+	TS_ASSERT(fileParam.isOpen() && "InputFile is not opened.");
+	if (!fileParam.isOpen())
+		return false;
+
+	file = std::move(fileParam);
+
+	blockSize = math::max(blockSizeParam, 4096U);
+
+	filesize = file.getSize();
+	filePosition = -1;
+
+	if (filesize < 0)
+	{
+		TS_LOG_ERROR("Unable to get file size.\n");
+		file.close();
+		return false;
+	}
+
+	// No point in a block larger than the file
+	blockSize = (SizeType)math::min((PosType)blockSize, math::max(filesize, (PosType)4096));
+
+	// Prefetched bytes make up the first block, reading continues where they end
+	if (prefetched != nullptr && numPrefetched > 0)
+	{
+		block.assign(prefetched, prefetched + numPrefetched);
+		blockStart = 0;
+		blockLength = numPrefetched;
+		filePosition = (PosType)numPrefetched;
+	}
+
+	return true;
+}
+
+bool BufferedInputFile::openMemory(const Byte *data, PosType size)
+{
+	TS_ASSERT(!isOpen() && "BufferedInputFile is already opened.");
+	if (isOpen())
+		return false;
+
+	TS_ASSERT(data != nullptr && size > 0);
+	if (data == nullptr || size <= 0)
+		return false;
+
+	memory = data;
+	filesize = size;
+	return true;
+}
+
+void BufferedInputFile::close()
+{
+	file.close();
+	mappedFile.close();
+	memory = nullptr;
+
+	block.clear();
+	block.shrink_to_fit();
+
+	blockStart = 0;
+	blockLength = 0;
+	filePosition = -1;
+	position = 0;
+	filesize = -1;
+	eof = false;
+	bad = false;
+}
+
+bool BufferedInputFile::fillBlock()
+{
+	TS_ASSERT(file.isOpen());
+
+	// Sequential refills continue right where the previous block ended
+	if (position != blockStart + (PosType)blockLength)
+		stats.numBlockMisses++;
+
+	if (filePosition != position)
+	{
+		if (file.seek(position) != position)
+		{
+			bad = true;
+			return false;
+		}
+		filePosition = position;
+	}
+
+	if (block.size() < blockSize)
+		block.resize(blockSize);
+
+	const PosType numBytesRead = file.read(&block[0], blockSize);
+	stats.numFileReads++;
+
+	if (numBytesRead < 0)
+	{
+		bad = true;
+		return false;
+	}
+
+	stats.numFileBytesRead += (BigSizeType)numBytesRead;
+
+	blockStart = position;
+	blockLength = (SizeType)numBytesRead;
+	filePosition += numBytesRead;
+
+	return numBytesRead > 0;
+}
+
+PosType BufferedInputFile::read(void *outBuffer, BigSizeType numBytesToRead)
+{
+	TS_ASSERT(outBuffer != nullptr);
+	TS_ASSERT(isOpen() && "BufferedInputFile is not opened.");
+
+	if (!isOpen() || bad)
+		return -1;
+
+	if (eof)
+		return 0;
+
+	stats.numReads++;
+
+	if (position >= filesize)
+	{
+		eof = true;
+		return 0;
+	}
+
+	const BigSizeType numAvailable = math::min(numBytesToRead, (BigSizeType)(filesize - position));
+
+	Byte *destination = static_cast<Byte*>(outBuffer);
+
+	if (memory != nullptr)
+	{
+		memcpy(destination, memory + position, (size_t)numAvailable);
+		destination += numAvailable;
+		position += (PosType)numAvailable;
+	}
+	else
+	{
+		BigSizeType numRemaining = numAvailable;
+		while (numRemaining > 0)
+		{
+			const PosType blockEnd = blockStart + (PosType)blockLength;
+			if (position >= blockStart && position < blockEnd)
+			{
+				const BigSizeType numToCopy = math::min(numRemaining, (BigSizeType)(blockEnd - position));
+				memcpy(destination, &block[(size_t)(position - blockStart)], (size_t)numToCopy);
+
+				destination += numToCopy;
+				position += (PosType)numToCopy;
+				numRemaining -= numToCopy;
+			}
+			else if (numRemaining >= blockSize)
+			{
+				// Going through the block would only add a copy, read straight to the destination
+				if (filePosition != position)
+				{
+					if (file.seek(position) != position)
+					{
+						bad = true;
+						return -1;
+					}
+					filePosition = position;
+				}
+
+				const PosType numBytesRead = file.read(destination, (uint32_t)math::min(numRemaining, MaxFileReadSize));
+				stats.numFileReads++;
+
+				if (numBytesRead <= 0)
+				{
+					bad = (numBytesRead < 0);
+					break;
+				}
+
+				stats.numFileBytesRead += (BigSizeType)numBytesRead;
+
+				destination += numBytesRead;
+				position += numBytesRead;
+				filePosition += numBytesRead;
+				numRemaining -= (BigSizeType)numBytesRead;
+			}
+			else if (!fillBlock())
+			{
+				break;
+			}
+		}
+
+		if (bad)
+			return -1;
+	}
+
+	const BigSizeType numBytesRead = (BigSizeType)(destination - static_cast<Byte*>(outBuffer));
+	stats.numBytesRead += numBytesRead;
+
+	if (numBytesRead < numBytesToRead)
+		eof = true;
+
+	return (PosType)numBytesRead;
+}
+
+PosType BufferedInputFile::seek(PosType pos, InputFile::SeekOrigin seekOrigin)
+{
+	TS_ASSERT(isOpen() && "BufferedInputFile is not opened.");
+	if (!isOpen() || bad)
+		return -1;
+
+	PosType newPosition;
+	switch (seekOrigin)
+	{
+		default:
+		case InputFile::SeekFromBeginning: newPosition = pos; break;
+		case InputFile::SeekFromCurrent:   newPosition = position + pos; break;
+		case InputFile::SeekFromEnd:       newPosition = filesize + pos; break;
+	}
+
+	if (newPosition < 0)
+		return -1;
+
+	position = newPosition;
+	eof = false;
+
+	return position;
+}
+
+PosType BufferedInputFile::tell() const
+{
+	TS_ASSERT(isOpen() && "BufferedInputFile is not opened.");
+	if (!isOpen() || bad)
+		return -1;
+
+	return position;
+}
+
+PosType BufferedInputFile::getSize()
+{
+	if (!isOpen() || bad)
+		return -1;
+
+	return filesize;
+}
+
+bool BufferedInputFile::isOpen() const
+{
+	return file.isOpen() || memory != nullptr;
+}
+
+bool BufferedInputFile::isEOF() const
+{
+	return eof;
+}
+
+bool BufferedInputFile::isBad() const
+{
+	return bad;
+}
+
+bool BufferedInputFile::isMapped() const
+{
+	return memory != nullptr;
+}
+
+const BufferedInputFile::ReadStats &BufferedInputFile::getStats() const
+{
+	return stats;
+}
+
+TS_END_PACKAGE1()
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ts/file/InputFile.h"
+#include "ts/file/MappedFile.h"
+
+TS_PACKAGE1(file)
+
+/* Read-ahead reader for parsers doing lots of small reads, such as demuxers reading one
+ * element at a time. Reads are served from a large block that is refilled sequentially,
+ * so the file is read with a handful of big reads instead of one call per small read.
+ * Optionally the file is memory mapped instead, in which case no reads are done at all.
+ */
+class BufferedInputFile : public lang::Noncopyable
+{
+public:
+	static const SizeType DefaultBlockSize = 4 * 1024 * 1024;
+
+	enum BackingMode
+	{
+		// Regular file reads in blocks of the given size
+		Backing_Read,
+		// Memory map the file, falls back to reading if mapping fails
+		Backing_PreferMapping,
+	};
+
+	BufferedInputFile();
+	~BufferedInputFile();
+
+	/* Opens file for reading.
+	 * Returns: true if file open succeeded. In case of failure the reason is output to the log.
+	 */
+	bool open(const String &filepath, SizeType blockSize = DefaultBlockSize, BackingMode backingMode = Backing_Read);
+
+	/* Takes over an already opened file positioned at numPrefetched. Prefetched bytes are the
+	 * start of the file read earlier, those are served from memory instead of being read again.
+	 * Returns: true if the file is usable.
+	 */
+	bool open(InputFile &&file, SizeType blockSize = DefaultBlockSize, const Byte *prefetched = nullptr, SizeType numPrefetched = 0);
+
+	/* Reads from memory the caller keeps valid until closed, e.g. a mapping shared with others.
+	 * Returns: true if the data is usable.
+	 */
+	bool openMemory(const Byte *data, PosType size);
+
+	/* Closes opened file and frees the buffer, also clearing flags. Stats are kept.
+	 */
+	void close();
+
+	/* Reads size bytes to the outBuffer, same as InputFile::read.
+	 * Returns one of these:
+	 *    number of bytes read (may be less than bytes requested when reaching end of file),
+	 *    0 if already end of file,
+	 *    or -1 on failure or bad.
+	 */
+	PosType read(void *outBuffer, BigSizeType numBytesToRead);
+
+	/* Sets read position relative to the seek origin. Seeking is free, the position is
+	 * only applied to the file when the next block needs to be read.
+	 * Returns: new position, or -1 if failure/bad.
+	 */
+	PosType seek(PosType pos, InputFile::SeekOrigin seekOrigin = InputFile::SeekFromBeginning);
+
+	/* Returns: current read position, or -1 if failure or bad.
+	 */
+	PosType tell() const;
+
+	/* Returns: full file size in bytes, or -1 if failure or bad.
+	 */
+	PosType getSize();
+
+	bool isOpen() const;
+	bool isEOF() const;
+	bool isBad() const;
+
+	/* Returns: true if the file is read through a memory mapping or from memory.
+	 */
+	bool isMapped() const;
+
+	struct ReadStats
+	{
+		// Reads done on the underlying file
+		BigSizeType numFileReads = 0;
+		BigSizeType numFileBytesRead = 0;
+		// Reads requested from this reader
+		BigSizeType numReads = 0;
+		BigSizeType numBytesRead = 0;
+		// Seeks that landed outside of the current block
+		BigSizeType numBlockMisses = 0;
+	};
+	const ReadStats &getStats() const;
+
+private:
+	bool fillBlock();
+
+	InputFile file;
+	MappedFile mappedFile;
+	// Mapped data, either mappedFile's or memory given to openMemory
+	const Byte *memory = nullptr;
+
+	std::vector<Byte> block;
+	SizeType blockSize = DefaultBlockSize;
+
+	// File offset of the first byte in the block and number of valid bytes in it
+	PosType blockStart = 0;
+	SizeType blockLength = 0;
+
+	// Offset where the underlying file is positioned at, -1 if not known
+	PosType filePosition = -1;
+
+	PosType position = 0;
+	PosType filesize = -1;
+
+	bool eof = false;
+	bool bad = false;
+
+	ReadStats stats;
+};
+
+TS_END_PACKAGE1()
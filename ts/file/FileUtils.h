@@ -82,6 +82,16 @@ extern bool isDirectory(const String &path);
  */
 extern bool removeFile(const String &path);
 
+/* Creates the directory and any missing parent directories.
+ * Returns: true if the directory exists afterwards.
+ */
+extern bool createDirectory(const String &path);
+
+/* Renames or moves the file, replacing the destination if it exists.
+ * Returns: true if the operation was successful.
+ */
+extern bool renameFile(const String &sourcePath, const String &destinationPath);
+
 /* Returns the base directory path where the current executable is located.
  */
 extern String getExecutableDirectory();
@@ -108,6 +108,9 @@ public:
 	bool operator!() const;
 
 private:
+	// Maps files opened by an input file without opening them again
+	friend class MappedFile;
+
 	void *m_handle = nullptr;
 	bool m_eof = false;
 	mutable bool m_bad = false;
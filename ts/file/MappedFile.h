@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+
+TS_PACKAGE1(file)
+
+class InputFile;
+
+enum MappedFileAccessHint
+{
+	// File will be mostly read from the beginning to the end
+	MappedFileAccess_Sequential,
+	// File will be read in no particular order
+	MappedFileAccess_Random,
+};
+
+/* Read-only memory mapping of a whole file. The mapping is private to the process
+ * and the data must never be written to.
+ */
+class MappedFile : public lang::Noncopyable
+{
+public:
+	MappedFile();
+	MappedFile(const String &filepath, MappedFileAccessHint accessHint = MappedFileAccess_Sequential);
+	~MappedFile();
+
+	// Move constructor and assignment
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+
+	/* Opens and maps the whole file to memory.
+	 * Returns: true if the mapping succeeded. In case of failure the reason is output to the log.
+	 * Mapping can fail on some filesystems even if the file can be normally opened, so
+	 * callers should be prepared to fall back to regular reading.
+	 */
+	bool open(const String &filepath, MappedFileAccessHint accessHint = MappedFileAccess_Sequential);
+
+	/* Maps the whole file already opened by the input file, the file isn't opened again.
+	 * The input file may be closed afterwards, the mapping stays valid until closed.
+	 * Returns: true if the mapping succeeded. In case of failure the reason is output to the log.
+	 */
+	bool open(const InputFile &file, MappedFileAccessHint accessHint = MappedFileAccess_Sequential);
+
+	/* Unmaps and closes the file.
+	 */
+	void close();
+
+	/* Returns: pointer to the beginning of the mapped data, or nullptr if not mapped.
+	 */
+	const unsigned char *getData() const;
+
+	/* Returns: size of the mapped data in bytes, or -1 if not mapped.
+	 */
+	PosType getSize() const;
+
+	/* Returns: true if file is mapped and readable.
+	 */
+	bool isOpen() const;
+
+	/* Returns: true if file is mapped and readable.
+	 */
+	operator bool() const;
+
+	/* Returns: true if file is not mapped.
+	 */
+	bool operator!() const;
+
+private:
+	void *m_handle = nullptr;
+	void *m_mappingHandle = nullptr;
+	unsigned char *m_data = nullptr;
+	PosType m_filesize = -1;
+};
+
+TS_END_PACKAGE1()
@@ -107,6 +107,34 @@ extern bool removeFile(const String &path)
 	return false;
 }
 
+extern bool createDirectory(const String &path)
+{
+	const std::string utf8Path = path.toUtf8();
+
+	// Parents first, existing ones are skipped
+	for (size_t position = 1; position <= utf8Path.size(); ++position)
+	{
+		if (position < utf8Path.size() && utf8Path[position] != '/')
+			continue;
+
+		const std::string partialPath = utf8Path.substr(0, position);
+		if (mkdir(partialPath.c_str(), 0755) != 0 && errno != EEXIST)
+		{
+			TS_LOG_ERROR("Unable to create directory. Path: %s. Error: %s", path, strerror(errno));
+			return false;
+		}
+	}
+	return true;
+}
+
+extern bool renameFile(const String &sourcePath, const String &destinationPath)
+{
+	if (rename(sourcePath.toUtf8().c_str(), destinationPath.toUtf8().c_str()) == 0)
+		return true;
+	TS_LOG_ERROR("Unable to rename file. File: %s. Destination: %s. Error: %s", sourcePath, destinationPath, strerror(errno));
+	return false;
+}
+
 extern bool getFileModifiedTime(const String &path, int64_t &modifiedTime)
 {
 	
@@ -0,0 +1,159 @@
+#include "Precompiled.h"
+
+#if TS_PLATFORM == TS_LINUX
+
+#include "ts/file/MappedFile.h"
+#include "ts/file/InputFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+TS_PACKAGE1(file)
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const String &filepath, MappedFileAccessHint accessHint)
+{
+	open(filepath, accessHint);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+{
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+	if (this != &other)
+	{
+		close();
+
+		m_handle = std::exchange(other.m_handle, nullptr);
+		m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+		m_data = std::exchange(other.m_data, nullptr);
+		m_filesize = std::exchange(other.m_filesize, -1);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const String &filepath, MappedFileAccessHint accessHint)
+{
+	TS_ASSERT(m_data == nullptr && "MappedFile is already opened.");
+	if (m_data != nullptr)
+		return false;
+
+	int fd = ::open(filepath.toUtf8().c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		TS_LOG_ERROR("Open failed. File: %s - Error: %s\n", filepath, strerror(errno));
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == -1 || fileStat.st_size <= 0)
+	{
+		// Empty files can't be mapped, not really an error but nothing to do either.
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// Mapping holds its own reference to the file, descriptor is no longer needed.
+	::close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		TS_LOG_WARNING("Mapping failed. File: %s - Error: %s\n", filepath, strerror(errno));
+		return false;
+	}
+
+	madvise(data, (size_t)fileStat.st_size,
+		accessHint == MappedFileAccess_Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+	m_data = static_cast<unsigned char*>(data);
+	m_filesize = (PosType)fileStat.st_size;
+	return true;
+}
+
+bool MappedFile::open(const InputFile &file, MappedFileAccessHint accessHint)
+{
+	TS_ASSERT(m_data == nullptr && "MappedFile is already opened.");
+	if (m_data != nullptr)
+		return false;
+
+	TS_ASSERT(file.isOpen() && "InputFile is not opened.");
+	if (!file.isOpen())
+		return false;
+
+	const int fd = fileno(static_cast<FILE*>(file.m_handle));
+
+	struct stat fileStat;
+	if (fd == -1 || fstat(fd, &fileStat) == -1 || fileStat.st_size <= 0)
+		return false;
+
+	// Mapping holds its own reference to the file, the descriptor stays with the input file
+	void *data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		TS_LOG_WARNING("Mapping failed. Error: %s\n", strerror(errno));
+		return false;
+	}
+
+	madvise(data, (size_t)fileStat.st_size,
+		accessHint == MappedFileAccess_Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+	m_data = static_cast<unsigned char*>(data);
+	m_filesize = (PosType)fileStat.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+	{
+		munmap(m_data, (size_t)m_filesize);
+	}
+	m_handle = nullptr;
+	m_mappingHandle = nullptr;
+	m_data = nullptr;
+	m_filesize = -1;
+}
+
+const unsigned char *MappedFile::getData() const
+{
+	return m_data;
+}
+
+PosType MappedFile::getSize() const
+{
+	return m_filesize;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+MappedFile::operator bool() const
+{
+	return isOpen();
+}
+
+bool MappedFile::operator!() const
+{
+	return !isOpen();
+}
+
+TS_END_PACKAGE1()
+
+#endif
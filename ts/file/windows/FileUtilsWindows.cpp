@@ -8,6 +8,7 @@
 #include "ts/lang/common/IncludeWindows.h"
 #include <shlwapi.h>
 #include <shellapi.h>
+#include <shlobj.h>
 
 #define MAX_PATH_LENGTH MAX_PATH
 
@@ -59,6 +60,29 @@ extern bool removeFile(const String &path)
 	return true;
 }
 
+extern bool createDirectory(const String &path)
+{
+	const int result = SHCreateDirectoryExW(nullptr, path.toWideString().c_str(), nullptr);
+	if (result != ERROR_SUCCESS && result != ERROR_ALREADY_EXISTS && result != ERROR_FILE_EXISTS)
+	{
+		TS_LOG_ERROR("Unable to create directory. Path: %s. Error: %s",
+			path, windows::getLastErrorAsString());
+		return false;
+	}
+	return true;
+}
+
+extern bool renameFile(const String &sourcePath, const String &destinationPath)
+{
+	if (MoveFileExW(sourcePath.toWideString().c_str(), destinationPath.toWideString().c_str(), MOVEFILE_REPLACE_EXISTING) == FALSE)
+	{
+		TS_LOG_ERROR("Unable to rename file. File: %s. Destination: %s. Error: %s",
+			sourcePath, destinationPath, windows::getLastErrorAsString());
+		return false;
+	}
+	return true;
+}
+
 extern String getExecutableDirectory()
 {
 	// Cache executable path
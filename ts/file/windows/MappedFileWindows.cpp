@@ -0,0 +1,190 @@
+#include "Precompiled.h"
+
+#if TS_PLATFORM == TS_WINDOWS
+
+#include "ts/file/MappedFile.h"
+#include "ts/file/InputFile.h"
+
+#include "ts/lang/common/IncludeWindows.h"
+#include "ts/lang/common/WindowsUtils.h"
+
+TS_PACKAGE1(file)
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const String &filepath, MappedFileAccessHint accessHint)
+{
+	open(filepath, accessHint);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+{
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+	if (this != &other)
+	{
+		close();
+
+		m_handle = std::exchange(other.m_handle, nullptr);
+		m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+		m_data = std::exchange(other.m_data, nullptr);
+		m_filesize = std::exchange(other.m_filesize, -1);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const String &filepath, MappedFileAccessHint accessHint)
+{
+	TS_ASSERT(m_data == nullptr && "MappedFile is already opened.");
+	if (m_data != nullptr)
+		return false;
+
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	flags |= (accessHint == MappedFileAccess_Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS);
+
+	HANDLE fileHandle = CreateFileW(
+		filepath.toWideString().c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		flags,
+		nullptr
+	);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		TS_WLOG_ERROR("File open failed: %s  File: %s\n",
+			windows::getLastErrorAsString(), filepath);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fileHandle, &size) == FALSE || size.QuadPart <= 0)
+	{
+		// Empty files can't be mapped, not really an error but nothing to do either.
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		TS_WLOG_WARNING("File mapping failed: %s  File: %s\n",
+			windows::getLastErrorAsString(), filepath);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		TS_WLOG_WARNING("Map view failed: %s  File: %s\n",
+			windows::getLastErrorAsString(), filepath);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	m_handle = fileHandle;
+	m_mappingHandle = mappingHandle;
+	m_data = static_cast<unsigned char*>(data);
+	m_filesize = (PosType)size.QuadPart;
+	return true;
+}
+
+bool MappedFile::open(const InputFile &file, MappedFileAccessHint accessHint)
+{
+	TS_ASSERT(m_data == nullptr && "MappedFile is already opened.");
+	if (m_data != nullptr)
+		return false;
+
+	TS_ASSERT(file.isOpen() && "InputFile is not opened.");
+	if (!file.isOpen())
+		return false;
+
+	// Access hint is given when opening a file, an already opened one keeps its own
+	HANDLE fileHandle = (HANDLE)file.m_handle;
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fileHandle, &size) == FALSE || size.QuadPart <= 0)
+		return false;
+
+	// Mapping object holds its own reference to the file, the handle stays with the input file
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		TS_WLOG_WARNING("File mapping failed: %s\n", windows::getLastErrorAsString());
+		return false;
+	}
+
+	void *data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		TS_WLOG_WARNING("Map view failed: %s\n", windows::getLastErrorAsString());
+		CloseHandle(mappingHandle);
+		return false;
+	}
+
+	m_handle = nullptr;
+	m_mappingHandle = mappingHandle;
+	m_data = static_cast<unsigned char*>(data);
+	m_filesize = (PosType)size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+
+	if (m_mappingHandle != nullptr)
+		CloseHandle((HANDLE)m_mappingHandle);
+
+	if (m_handle != nullptr && m_handle != INVALID_HANDLE_VALUE)
+		CloseHandle((HANDLE)m_handle);
+
+	m_handle = nullptr;
+	m_mappingHandle = nullptr;
+	m_data = nullptr;
+	m_filesize = -1;
+}
+
+const unsigned char *MappedFile::getData() const
+{
+	return m_data;
+}
+
+PosType MappedFile::getSize() const
+{
+	return m_filesize;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+MappedFile::operator bool() const
+{
+	return isOpen();
+}
+
+bool MappedFile::operator!() const
+{
+	return !isOpen();
+}
+
+TS_END_PACKAGE1()
+
+#endif
@@ -6,6 +6,9 @@
 #define APP_LOG_FILE "Ivie.log"
 #define APP_CONFIG_FILE "options.ini"
 
+// Relative to the executable directory
+#define APP_THUMBNAIL_CACHE_DIRECTORY "cache/thumbnails"
+
 // Window and display
 #define APP_WINDOW_TITLE "Ivie - The Third Try"
 #define APP_WINDOW_ICON_PATH "ivie_logo_32.png"
@@ -5,6 +5,7 @@
 #include "Application.h"
 
 #include "ts/engine/system/Commando.h"
+#include "ts/ivie/benchmark/Benchmark.h"
 
 #include "ts/file/FileList.h"
 
@@ -44,6 +45,10 @@ int main(int numArgs, const char **argv)
 			TS_LOG_WARNING("Failed to parse command line arguments.");
 	}
 
+	String benchmarkName;
+	if (commando.getFlagParameter("benchmark", benchmarkName))
+		return app::benchmark::runBenchmarks(benchmarkName) ? 0 : 1;
+
 	app::Application app(commando);
 	int returnCode = app.launch();
 	return returnCode;
@@ -8,6 +8,7 @@
 #include <shellapi.h>
 
 #include "ts/engine/system/Commando.h"
+#include "ts/ivie/benchmark/Benchmark.h"
 
 #include "zip.h"
 #include "ts/file/OutputFile.h"
@@ -112,6 +113,10 @@ int __stdcall wWinMain(HINSTANCE instance, HINSTANCE, LPWSTR cmdArgs, int window
 		LocalFree(argList);
 	}
 
+	String benchmarkName;
+	if (commando.getFlagParameter("benchmark", benchmarkName))
+		return app::benchmark::runBenchmarks(benchmarkName) ? 0 : 1;
+
 	app::Application app(commando);
 	int returnCode = app.launch();
 	return returnCode;
@@ -0,0 +1,91 @@
+#include "Precompiled.h"
+#include "Benchmark.h"
+
+#include "ts/lang/time/SteadyTimer.h"
+
+TS_PACKAGE2(app, benchmark)
+
+extern void pixelKernelBenchmark();
+extern void yuvRepackBenchmark();
+extern void thumbnailBenchmark();
+extern void schedulerBenchmark();
+extern void priorityQueueBenchmark();
+extern void schedulerThroughputBenchmark();
+extern void schedulerAllocationBenchmark();
+
+struct BenchmarkEntry
+{
+	const char *name;
+	void (*function)();
+};
+
+static const BenchmarkEntry benchmarks[] =
+{
+	{ "pixels",    pixelKernelBenchmark },
+	{ "yuv",       yuvRepackBenchmark },
+	{ "thumbnail", thumbnailBenchmark },
+	{ "scheduler", schedulerBenchmark },
+	{ "queue",     priorityQueueBenchmark },
+	{ "throughput", schedulerThroughputBenchmark },
+	{ "allocations", schedulerAllocationBenchmark },
+};
+
+static bool benchmarkFailed = false;
+
+bool runBenchmarks(const String &name)
+{
+	bool found = false;
+	benchmarkFailed = false;
+
+	for (const BenchmarkEntry &entry : benchmarks)
+	{
+		if (name != "all" && name != entry.name)
+			continue;
+
+		common::Log::write(TS_FMT("\n--- Benchmark: %s\n", entry.name));
+		entry.function();
+		found = true;
+	}
+
+	if (!found)
+	{
+		TS_LOG_ERROR("Unknown benchmark '%s'.", name);
+
+		String available;
+		for (const BenchmarkEntry &entry : benchmarks)
+			available.append(TS_FMT(" %s", entry.name));
+		common::Log::write(TS_FMT("Available benchmarks: all%s\n", available));
+	}
+
+	return found && !benchmarkFailed;
+}
+
+void reportFailure(const String &message)
+{
+	TS_LOG_ERROR("Benchmark failed: %s", message);
+	benchmarkFailed = true;
+}
+
+TimeSpan measureFastest(SizeType numRuns, const std::function<void()> &function)
+{
+	TimeSpan fastest = TimeSpan::zero;
+	for (SizeType i = 0; i < numRuns; ++i)
+	{
+		SteadyTimer timer;
+		function();
+		TimeSpan elapsed = timer.getElapsedTime();
+
+		if (i == 0 || elapsed < fastest)
+			fastest = elapsed;
+	}
+	return fastest;
+}
+
+void reportThroughput(const String &label, TimeSpan duration, BigSizeType numPixels)
+{
+	const double seconds = std::max(duration.getMicroseconds(), (int64_t)1) / 1000000.0;
+	common::Log::write(TS_FMT("  %-40s %9.3f ms  %9.1f MP/s\n",
+		label.toUtf8(), duration.getMicroseconds() / 1000.0, numPixels / seconds / 1000000.0));
+}
+
+TS_END_PACKAGE2()
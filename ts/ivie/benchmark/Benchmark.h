@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+
+TS_PACKAGE2(app, benchmark)
+
+/* Runs the benchmark with the given name, or all of them if the name is "all".
+ * Results are written to the log. Started with the command line flag: -benchmark <name>
+ * Returns: false if no benchmark matched the name or a benchmark reported a failure.
+ */
+extern bool runBenchmarks(const String &name);
+
+/* Logs the error and makes runBenchmarks return false once the benchmarks have run,
+ * for benchmarks that check their results.
+ */
+extern void reportFailure(const String &message);
+
+/* Runs the function the given number of times.
+ * Returns: duration of the fastest run, which is the least disturbed by everything else.
+ */
+extern TimeSpan measureFastest(SizeType numRuns, const std::function<void()> &function);
+
+/* Writes a result line with throughput in megapixels per second.
+ */
+extern void reportThroughput(const String &label, TimeSpan duration, BigSizeType numPixels);
+
+TS_END_PACKAGE2()
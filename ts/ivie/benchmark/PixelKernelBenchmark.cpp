@@ -0,0 +1,178 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/ivie/image/PixelKernels.h"
+#include "ts/ivie/image/FreeImageStaticInitializer.h"
+
+#include "FreeImage.h"
+
+#include <random>
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+// Roughly a 24 megapixel camera image
+const SizeType ImageWidth = 6000;
+const SizeType ImageHeight = 4000;
+const SizeType NumRuns = 5;
+
+FIBITMAP *makeNoiseBitmap(uint32_t bitdepth, bool greyscale)
+{
+	FIBITMAP *bitmap = FreeImage_Allocate(ImageWidth, ImageHeight, bitdepth);
+	TS_ASSERT(bitmap != nullptr);
+
+	std::mt19937 random(1337);
+	BYTE *bits = FreeImage_GetBits(bitmap);
+	const size_t numBytes = (size_t)FreeImage_GetPitch(bitmap) * ImageHeight;
+	for (size_t i = 0; i < numBytes; ++i)
+		bits[i] = (BYTE)random();
+
+	if (bitdepth == 8)
+	{
+		RGBQUAD *palette = FreeImage_GetPalette(bitmap);
+		for (SizeType i = 0; i < 256; ++i)
+		{
+			palette[i].rgbRed = (BYTE)i;
+			palette[i].rgbGreen = greyscale ? (BYTE)i : (BYTE)(255 - i);
+			palette[i].rgbBlue = greyscale ? (BYTE)i : (BYTE)(i * 7);
+		}
+	}
+
+	return bitmap;
+}
+
+// What the still loader used to do for every image without alpha
+void legacyAlphaFill(BYTE *bits, SizeType width, SizeType height)
+{
+	BYTE *pixel = bits;
+	for (SizeType y = 0; y < height; ++y)
+	{
+		for (SizeType x = 0; x < width; ++x)
+		{
+			pixel[FI_RGBA_ALPHA] = 255U;
+			pixel += 4;
+		}
+	}
+}
+
+void benchmarkLegacyConversion(const String &label, FIBITMAP *source)
+{
+	TimeSpan duration = measureFastest(NumRuns, [source]()
+	{
+		FIBITMAP *converted = FreeImage_ConvertTo32Bits(source);
+		legacyAlphaFill(FreeImage_GetBits(converted), ImageWidth, ImageHeight);
+		FreeImage_Unload(converted);
+	});
+	reportThroughput(label, duration, (BigSizeType)ImageWidth * ImageHeight);
+}
+
+template<class Function>
+void benchmarkKernelLevels(const char *operation, Function function)
+{
+	for (int32_t level = 0; level < image::PixelKernelLevel_NumLevels; ++level)
+	{
+		if (!image::isPixelKernelLevelSupported((image::PixelKernelLevel)level))
+			continue;
+
+		const image::PixelKernels &kernels = image::getPixelKernels((image::PixelKernelLevel)level);
+		TimeSpan duration = measureFastest(NumRuns, [&]() { function(kernels); });
+		reportThroughput(TS_FMT("%s (%s)", operation, kernels.name), duration, (BigSizeType)ImageWidth * ImageHeight);
+	}
+}
+
+}
+
+void pixelKernelBenchmark()
+{
+	image::FreeImageStaticInitializer::staticInitialize();
+
+	common::Log::write(TS_FMT("Image size %u x %u, fastest of %u runs. Dispatch selects %s.\n",
+		ImageWidth, ImageHeight, NumRuns, image::getPixelKernels().name));
+
+	const SizeType uploadPitch = ImageWidth * 4;
+	std::vector<BYTE> uploadBuffer((size_t)uploadPitch * ImageHeight);
+
+	// 24-bit, most JPEGs
+	{
+		FIBITMAP *source = makeNoiseBitmap(24, false);
+
+		benchmarkLegacyConversion("24 bpp: ConvertTo32Bits + alpha loop", source);
+		benchmarkKernelLevels("24 bpp: expandBGRToBGRA", [&](const image::PixelKernels &kernels)
+		{
+			for (SizeType y = 0; y < ImageHeight; ++y)
+				kernels.expandBGRToBGRA(FreeImage_GetScanLine(source, y), &uploadBuffer[(size_t)y * uploadPitch], ImageWidth);
+		});
+
+		FreeImage_Unload(source);
+	}
+
+	// 32-bit without alpha, converted in-place
+	{
+		FIBITMAP *source = makeNoiseBitmap(32, false);
+		BYTE *bits = FreeImage_GetBits(source);
+
+		TimeSpan duration = measureFastest(NumRuns, [&]() { legacyAlphaFill(bits, ImageWidth, ImageHeight); });
+		reportThroughput("32 bpp: alpha loop", duration, (BigSizeType)ImageWidth * ImageHeight);
+
+		benchmarkKernelLevels("32 bpp: copyBGRAOpaque", [&](const image::PixelKernels &kernels)
+		{
+			kernels.copyBGRAOpaque(bits, bits, ImageWidth * ImageHeight);
+		});
+
+		benchmarkKernelLevels("32 bpp: swizzleBGRAToRGBA", [&](const image::PixelKernels &kernels)
+		{
+			kernels.swizzleBGRAToRGBA(bits, &uploadBuffer[0], ImageWidth * ImageHeight);
+		});
+
+		// Animation frame compositing, pixels are opaque by now like most GIF frames are
+		benchmarkKernelLevels("32 bpp: blendBGRAOver", [&](const image::PixelKernels &kernels)
+		{
+			kernels.blendBGRAOver(bits, &uploadBuffer[0], ImageWidth * ImageHeight);
+		});
+
+		FreeImage_Unload(source);
+	}
+
+	// 8-bit greyscale
+	{
+		FIBITMAP *source = makeNoiseBitmap(8, true);
+
+		benchmarkLegacyConversion("8 bpp grey: ConvertTo32Bits + alpha loop", source);
+		benchmarkKernelLevels("8 bpp grey: expandGreyToBGRA", [&](const image::PixelKernels &kernels)
+		{
+			for (SizeType y = 0; y < ImageHeight; ++y)
+				kernels.expandGreyToBGRA(FreeImage_GetScanLine(source, y), &uploadBuffer[(size_t)y * uploadPitch], ImageWidth);
+		});
+
+		FreeImage_Unload(source);
+	}
+
+	// 8-bit palette
+	{
+		FIBITMAP *source = makeNoiseBitmap(8, false);
+
+		uint32_t lookup[256];
+		const RGBQUAD *palette = FreeImage_GetPalette(source);
+		for (SizeType i = 0; i < 256; ++i)
+		{
+			BYTE *entry = reinterpret_cast<BYTE*>(&lookup[i]);
+			entry[FI_RGBA_RED] = palette[i].rgbRed;
+			entry[FI_RGBA_GREEN] = palette[i].rgbGreen;
+			entry[FI_RGBA_BLUE] = palette[i].rgbBlue;
+			entry[FI_RGBA_ALPHA] = 255U;
+		}
+
+		benchmarkLegacyConversion("8 bpp palette: ConvertTo32Bits + alpha loop", source);
+		benchmarkKernelLevels("8 bpp palette: expandIndexedToBGRA", [&](const image::PixelKernels &kernels)
+		{
+			for (SizeType y = 0; y < ImageHeight; ++y)
+				kernels.expandIndexedToBGRA(FreeImage_GetScanLine(source, y), lookup, &uploadBuffer[(size_t)y * uploadPitch], ImageWidth);
+		});
+
+		FreeImage_Unload(source);
+	}
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,291 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/container/PriorityQueue.h"
+#include "ts/lang/time/SteadyTimer.h"
+
+#include <list>
+#include <random>
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+const SizeType QueueSizes[] = { 10, 1000, 100000 };
+const SizeType NumRuns = 3;
+// Sorting the list on every push makes large sizes slow, fewer operations keep it bearable
+const SizeType NumOperations = 1000;
+const SizeType NumOperationsLarge = 100;
+
+// Like a scheduler task, sorted by priority and then by id
+struct Entry
+{
+	uint32_t priority = 0;
+	uint32_t id = 0;
+};
+
+struct EntrySorter
+{
+	bool operator()(const Entry &lhs, const Entry &rhs) const
+	{
+		return lhs.priority < rhs.priority || (lhs.priority == rhs.priority && lhs.id < rhs.id);
+	}
+};
+
+// What the scheduler used before, a list sorted on every push
+class ListPriorityQueue
+{
+public:
+	void push(const Entry &value)
+	{
+		container.push_back(value);
+		container.sort(sorting);
+	}
+
+	// Sorts once after adding everything
+	void fill(const std::vector<Entry> &entries)
+	{
+		container.insert(container.end(), entries.begin(), entries.end());
+		container.sort(sorting);
+	}
+
+	const Entry &top() const { return container.front(); }
+	void pop() { container.pop_front(); }
+	bool empty() const { return container.empty(); }
+
+	bool eraseId(uint32_t id)
+	{
+		for (std::list<Entry>::iterator it = container.begin(); it != container.end(); ++it)
+		{
+			if (it->id == id)
+			{
+				container.erase(it);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool containsId(uint32_t id) const
+	{
+		for (const Entry &entry : container)
+		{
+			if (entry.id == id)
+				return true;
+		}
+		return false;
+	}
+
+private:
+	std::list<Entry> container;
+	EntrySorter sorting;
+};
+
+typedef util::PriorityQueue<Entry, EntrySorter> HeapPriorityQueue;
+
+struct Workload
+{
+	std::vector<Entry> initial;
+	std::vector<Entry> pushed;
+	// Indices to initial entries to cancel or look up
+	std::vector<SizeType> targets;
+};
+
+Workload makeWorkload(SizeType queueSize, SizeType numOperations)
+{
+	std::mt19937 random(1337);
+	Workload workload;
+
+	uint32_t nextId = 0;
+	for (SizeType i = 0; i < queueSize; ++i)
+		workload.initial.push_back(Entry{ (uint32_t)(random() % 5), nextId++ });
+	for (SizeType i = 0; i < numOperations; ++i)
+		workload.pushed.push_back(Entry{ (uint32_t)(random() % 5), nextId++ });
+
+	// Every target is distinct so each cancel finds its entry
+	std::vector<SizeType> indices(queueSize);
+	for (SizeType i = 0; i < queueSize; ++i)
+		indices[i] = i;
+	std::shuffle(indices.begin(), indices.end(), random);
+	workload.targets.assign(indices.begin(), indices.begin() + math::min(numOperations, queueSize));
+
+	return workload;
+}
+
+void report(const String &label, TimeSpan duration, SizeType numOperations)
+{
+	common::Log::write(TS_FMT("  %-40s %12.1f ns/op\n",
+		label.toUtf8(), duration.getMicroseconds() * 1000.0 / numOperations));
+}
+
+void benchmarkSize(SizeType queueSize)
+{
+	const SizeType numOperations = queueSize >= 100000 ? NumOperationsLarge : NumOperations;
+	const Workload workload = makeWorkload(queueSize, numOperations);
+
+	TimeSpan durationList[3];
+	TimeSpan durationHeap[3];
+
+	for (SizeType run = 0; run < NumRuns; ++run)
+	{
+		// Filling isn't timed, the list is sorted once at the end
+		ListPriorityQueue list;
+		list.fill(workload.initial);
+
+		HeapPriorityQueue heap;
+		std::vector<HeapPriorityQueue::Handle> handles;
+		for (const Entry &entry : workload.initial)
+			handles.push_back(heap.push(entry));
+
+		TimeSpan times[2][3];
+
+		// Push and pop, the queue stays the same size
+		{
+			SteadyTimer timer;
+			for (SizeType i = 0; i < numOperations; ++i)
+			{
+				list.push(workload.pushed[i]);
+				list.pop();
+			}
+			times[0][0] = timer.getElapsedTime();
+		}
+		{
+			SteadyTimer timer;
+			for (SizeType i = 0; i < numOperations; ++i)
+			{
+				heap.push(workload.pushed[i]);
+				heap.pop();
+			}
+			times[1][0] = timer.getElapsedTime();
+		}
+
+		// Contains, the scheduler's isTaskQueued
+		{
+			SteadyTimer timer;
+			SizeType found = 0;
+			for (SizeType target : workload.targets)
+				found += list.containsId(workload.initial[target].id) ? 1 : 0;
+			times[0][1] = timer.getElapsedTime();
+			TS_UNUSED_VARIABLE(found);
+		}
+		{
+			SteadyTimer timer;
+			SizeType found = 0;
+			for (SizeType target : workload.targets)
+				found += heap.contains(handles[target]) ? 1 : 0;
+			times[1][1] = timer.getElapsedTime();
+			TS_UNUSED_VARIABLE(found);
+		}
+
+		// Cancel, the scheduler's cancelTask
+		{
+			SteadyTimer timer;
+			for (SizeType target : workload.targets)
+				list.eraseId(workload.initial[target].id);
+			times[0][2] = timer.getElapsedTime();
+		}
+		{
+			SteadyTimer timer;
+			for (SizeType target : workload.targets)
+				heap.erase(handles[target]);
+			times[1][2] = timer.getElapsedTime();
+		}
+
+		for (SizeType i = 0; i < 3; ++i)
+		{
+			if (run == 0 || times[0][i] < durationList[i])
+				durationList[i] = times[0][i];
+			if (run == 0 || times[1][i] < durationHeap[i])
+				durationHeap[i] = times[1][i];
+		}
+	}
+
+	const char *operations[] = { "push + pop", "contains", "cancel" };
+	const SizeType numTargets = (SizeType)workload.targets.size();
+	for (SizeType i = 0; i < 3; ++i)
+	{
+		const SizeType count = i == 0 ? numOperations : numTargets;
+		report(TS_FMT("%u, list, %s", queueSize, operations[i]), durationList[i], count);
+		report(TS_FMT("%u, heap, %s", queueSize, operations[i]), durationHeap[i], count);
+	}
+}
+
+// Random pushes, cancels and priority changes have to come out in the same order as from the list
+bool verifyOrder()
+{
+	std::mt19937 random(4242);
+
+	ListPriorityQueue list;
+	HeapPriorityQueue heap;
+
+	std::vector<std::pair<Entry, HeapPriorityQueue::Handle>> live;
+	std::vector<HeapPriorityQueue::Handle> removedHandles;
+
+	uint32_t nextId = 0;
+	for (SizeType step = 0; step < 5000; ++step)
+	{
+		const uint32_t action = random() % 10;
+		if (action < 5 || live.empty())
+		{
+			const Entry entry{ (uint32_t)(random() % 8), nextId++ };
+			list.push(entry);
+			live.push_back(std::make_pair(entry, heap.push(entry)));
+		}
+		else if (action < 7)
+		{
+			const SizeType index = (SizeType)(random() % live.size());
+			list.eraseId(live[index].first.id);
+			if (!heap.erase(live[index].second))
+				return false;
+
+			removedHandles.push_back(live[index].second);
+			live.erase(live.begin() + index);
+		}
+		else
+		{
+			// Priority change, the list is sorted again by taking the entry out and putting it back
+			const SizeType index = (SizeType)(random() % live.size());
+			live[index].first.priority = (uint32_t)(random() % 8);
+			list.eraseId(live[index].first.id);
+			list.push(live[index].first);
+			if (!heap.update(live[index].second, live[index].first))
+				return false;
+		}
+	}
+
+	// Handles of removed entries don't match whatever was pushed after them
+	for (HeapPriorityQueue::Handle handle : removedHandles)
+	{
+		if (heap.contains(handle))
+			return false;
+	}
+
+	while (!list.empty())
+	{
+		if (heap.empty() || heap.top().id != list.top().id)
+			return false;
+
+		list.pop();
+		heap.pop();
+	}
+
+	return heap.empty();
+}
+
+}
+
+void priorityQueueBenchmark()
+{
+	common::Log::write(TS_FMT("Scheduler queue operations, fastest of %u runs. List is the old implementation, heap the current one.\n", NumRuns));
+
+	const bool success = verifyOrder();
+	common::Log::write(TS_FMT("  Heap order matches the list: %s\n", success ? "yes" : "NO"));
+	if (!success)
+		reportFailure("Priority queue order differs from the sorted list.");
+
+	for (SizeType queueSize : QueueSizes)
+		benchmarkSize(queueSize);
+}
+
+TS_END_PACKAGE2()
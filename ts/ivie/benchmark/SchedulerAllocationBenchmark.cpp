@@ -0,0 +1,224 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/thread/ThreadScheduler.h"
+#include "ts/thread/Thread.h"
+
+#include <array>
+#include <cstdlib>
+#include <future>
+#include <map>
+#include <new>
+
+#if TS_BENCHMARK_COUNT_ALLOCATIONS == TS_TRUE
+
+namespace
+{
+
+// Counts every heap allocation in the process while switched on, whichever thread makes it.
+// Off it costs a relaxed load per allocation.
+std::atomic_bool countingAllocations = false;
+std::atomic<ts::BigSizeType> numAllocations = 0;
+
+}
+
+/* The counting allocator. Only the plain forms are replaced, the nothrow ones call these and
+ * the over-aligned ones keep going to the standard allocator as a pair.
+ */
+void *operator new(std::size_t size)
+{
+	if (countingAllocations.load(std::memory_order_relaxed))
+		numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *pointer = std::malloc(size > 0 ? size : 1))
+		return pointer;
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+#endif
+
+TS_PACKAGE2(app, benchmark)
+
+#if TS_BENCHMARK_COUNT_ALLOCATIONS == TS_TRUE
+
+namespace
+{
+
+const SizeType NumTasks = 10000;
+
+// Runs the submissions twice, the first time fills the pools and grows the queues to their working size
+template<class Function>
+double measureAllocationsPerTask(const Function &submitAll)
+{
+	submitAll();
+
+	numAllocations = 0;
+	countingAllocations = true;
+	submitAll();
+	countingAllocations = false;
+
+	return (double)numAllocations / NumTasks;
+}
+
+void waitUntilDone(std::atomic<SizeType> &numDone, SizeType target)
+{
+	while (numDone < target)
+		Thread::sleep(TimeSpan::fromMilliseconds(1));
+}
+
+// What scheduleOnce did before the tasks were pooled, without the queues
+struct LegacyTask
+{
+	LegacyTask(std::function<bool()> &&task)
+		: task(std::move(task))
+	{
+		future = promise.get_future();
+	}
+
+	std::function<bool()> task;
+	std::promise<void> promise;
+	std::future<void> future;
+};
+
+double measureLegacySubmission()
+{
+	std::map<thread::SchedulerTaskId, SharedPointer<LegacyTask>> incompleteTasks;
+	thread::SchedulerTaskId nextTaskId = 0;
+
+	return measureAllocationsPerTask([&]()
+	{
+		for (SizeType i = 0; i < NumTasks; ++i)
+		{
+			std::function<void()> function = std::bind([]() {});
+			SharedPointer<std::packaged_task<void()>> packagedTask =
+				makeShared<std::packaged_task<void()>>(function);
+			std::future<void> future = packagedTask->get_future();
+
+			SharedPointer<LegacyTask> task = makeShared<LegacyTask>([packagedTask]()
+			{
+				std::invoke(*packagedTask);
+				return false;
+			});
+			incompleteTasks.insert(std::make_pair(nextTaskId++, task));
+		}
+
+		incompleteTasks.clear();
+	});
+}
+
+void benchmarkMode(thread::ThreadScheduler::ExecutionMode mode, const char *modeName)
+{
+	thread::ThreadScheduler scheduler(mode);
+	scheduler.initialize();
+
+	std::atomic<SizeType> numDone = 0;
+	SizeType numSubmitted = 0;
+
+	const double detached = measureAllocationsPerTask([&]()
+	{
+		for (SizeType i = 0; i < NumTasks; ++i)
+		{
+			scheduler.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, [&numDone]()
+			{
+				numDone++;
+			});
+		}
+		waitUntilDone(numDone, numSubmitted += NumTasks);
+	});
+
+	const double voidFuture = measureAllocationsPerTask([&]()
+	{
+		for (SizeType i = 0; i < NumTasks; ++i)
+		{
+			thread::ScheduledTaskFuture<void> future = scheduler.scheduleOnce(thread::Priority_Normal, TimeSpan::zero, [&numDone]()
+			{
+				numDone++;
+			});
+		}
+		waitUntilDone(numDone, numSubmitted += NumTasks);
+	});
+
+	const double resultFuture = measureAllocationsPerTask([&]()
+	{
+		for (SizeType i = 0; i < NumTasks; ++i)
+		{
+			thread::ScheduledTaskFuture<SizeType> future = scheduler.scheduleOnce(thread::Priority_Normal, TimeSpan::zero, [&numDone]()
+			{
+				return ++numDone;
+			});
+		}
+		waitUntilDone(numDone, numSubmitted += NumTasks);
+	});
+
+	// Captures more than fits in the task, the callable goes to the heap
+	const double largeCapture = measureAllocationsPerTask([&]()
+	{
+		std::array<Byte, thread::ScheduledTask::InlineFunctionSize> payload = {};
+		for (SizeType i = 0; i < NumTasks; ++i)
+		{
+			scheduler.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, [&numDone, payload]()
+			{
+				numDone += 1 + payload[0];
+			});
+		}
+		waitUntilDone(numDone, numSubmitted += NumTasks);
+	});
+
+	const SizeType numPooledTasks = scheduler.getStats().numPooledTasks;
+	scheduler.deinitialize();
+
+	common::Log::write(TS_FMT("  %s, %u tasks\n", modeName, NumTasks));
+	common::Log::write(TS_FMT("    scheduleDetached                   %6.2f allocations per task\n", detached));
+	common::Log::write(TS_FMT("    scheduleOnce, future without value %6.2f allocations per task\n", voidFuture));
+	common::Log::write(TS_FMT("    scheduleOnce, future with value    %6.2f allocations per task\n", resultFuture));
+	common::Log::write(TS_FMT("    scheduleDetached, large capture    %6.2f allocations per task\n", largeCapture));
+	common::Log::write(TS_FMT("    %u task records pooled\n", numPooledTasks));
+}
+
+}
+
+void schedulerAllocationBenchmark()
+{
+	common::Log::write("Heap allocations per scheduled task, counted after the pools have warmed up.\n");
+	common::Log::write(TS_FMT("  Before pooling, scheduleOnce        %6.2f allocations per task\n", measureLegacySubmission()));
+
+	benchmarkMode(thread::ThreadScheduler::Execution_SharedQueue, "Shared queue");
+	benchmarkMode(thread::ThreadScheduler::Execution_WorkStealing, "Work stealing");
+}
+
+#else
+
+void schedulerAllocationBenchmark()
+{
+	common::Log::write("Counting allocations is disabled, set TS_BENCHMARK_COUNT_ALLOCATIONS in GlobalConfig.h to build it.\n");
+}
+
+#endif
+
+TS_END_PACKAGE2()
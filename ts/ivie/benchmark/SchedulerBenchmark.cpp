@@ -0,0 +1,130 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/thread/ThreadScheduler.h"
+
+#include <algorithm>
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+const SizeType NumSingleRuns = 200;
+const SizeType NumBurstRuns = 50;
+// About what a directory change queues: a loader per prefetched image plus probes and thumbnails
+const SizeType BurstSize = 20;
+const SizeType NumDelayedRuns = 50;
+const TimeSpan TaskDelay = 2_ms;
+
+// Dispatch is event driven, anything in the milliseconds means a task sat in a queue polled on a timer
+const int64_t MaxMedianLatencyMicroseconds = 1000;
+const int64_t MaxBurstLatencyMicroseconds = 5000;
+
+struct LatencyStats
+{
+	int64_t median = 0;
+	int64_t worst = 0;
+};
+
+LatencyStats getStats(std::vector<int64_t> &latencies)
+{
+	LatencyStats stats;
+	if (latencies.empty())
+		return stats;
+
+	std::sort(latencies.begin(), latencies.end());
+	stats.median = latencies[latencies.size() / 2];
+	stats.worst = latencies.back();
+	return stats;
+}
+
+void report(const String &label, const LatencyStats &stats)
+{
+	common::Log::write(TS_FMT("  %-40s median %6lld us   worst %6lld us\n",
+		label.toUtf8(), (long long)stats.median, (long long)stats.worst));
+}
+
+// Time from submitting to the task starting on a worker, for tasks due at the given delay
+int64_t measureStartLatency(thread::ThreadScheduler &scheduler, TimeSpan delay)
+{
+	Time startTime;
+
+	const Time submitTime = Time::now();
+	thread::ScheduledTaskFuture<void> future = scheduler.scheduleOnce(thread::Priority_Normal, delay, [&startTime]()
+	{
+		startTime = Time::now();
+	});
+	future.wait();
+
+	return (startTime - submitTime - delay).getMicroseconds();
+}
+
+}
+
+void schedulerBenchmark()
+{
+	thread::ThreadScheduler scheduler;
+	scheduler.initialize();
+
+	common::Log::write(TS_FMT("Submit to start latency with %u workers.\n", scheduler.getNumWorkers()));
+
+	std::vector<int64_t> latencies;
+
+	// Workers are idle, a single task shows the cost of waking one up
+	for (SizeType i = 0; i < NumSingleRuns; ++i)
+		latencies.push_back(measureStartLatency(scheduler, TimeSpan::zero));
+	const LatencyStats singleStats = getStats(latencies);
+	report("Single task", singleStats);
+
+	// The last task of a burst shows how long queued tasks wait to reach the workers
+	latencies.clear();
+	for (SizeType run = 0; run < NumBurstRuns; ++run)
+	{
+		std::vector<Time> startTimes(BurstSize);
+		std::vector<thread::ScheduledTaskFuture<void>> futures;
+		futures.reserve(BurstSize);
+
+		const Time submitTime = Time::now();
+		for (SizeType i = 0; i < BurstSize; ++i)
+		{
+			futures.push_back(scheduler.scheduleOnce(thread::Priority_Normal, TimeSpan::zero, [&startTimes, i]()
+			{
+				startTimes[i] = Time::now();
+			}));
+		}
+
+		for (thread::ScheduledTaskFuture<void> &future : futures)
+			future.wait();
+
+		const Time lastStart = *std::max_element(startTimes.begin(), startTimes.end());
+		latencies.push_back((lastStart - submitTime).getMicroseconds());
+	}
+	const LatencyStats burstStats = getStats(latencies);
+	report(TS_FMT("Last of a burst of %u tasks", BurstSize), burstStats);
+
+	// Delayed tasks are measured from their deadline
+	latencies.clear();
+	for (SizeType i = 0; i < NumDelayedRuns; ++i)
+		latencies.push_back(measureStartLatency(scheduler, TaskDelay));
+	const LatencyStats delayedStats = getStats(latencies);
+	report(TS_FMT("Delayed task, past its %lld ms deadline", (long long)TaskDelay.getMilliseconds()), delayedStats);
+
+	scheduler.deinitialize();
+
+	const bool success =
+		singleStats.median <= MaxMedianLatencyMicroseconds &&
+		delayedStats.median <= MaxMedianLatencyMicroseconds &&
+		burstStats.median <= MaxBurstLatencyMicroseconds;
+
+	common::Log::write(TS_FMT("  Latency within %lld us (bursts %lld us): %s\n",
+		(long long)MaxMedianLatencyMicroseconds, (long long)MaxBurstLatencyMicroseconds, success ? "yes" : "NO"));
+
+	if (!success)
+	{
+		reportFailure(TS_FMT("Scheduler latency is over the limit, median %lld us, burst %lld us, delayed %lld us.",
+			(long long)singleStats.median, (long long)burstStats.median, (long long)delayedStats.median));
+	}
+}
+
+TS_END_PACKAGE2()
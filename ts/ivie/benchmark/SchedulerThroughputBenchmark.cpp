@@ -0,0 +1,161 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/thread/ThreadScheduler.h"
+#include "ts/lang/time/SteadyTimer.h"
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+const SizeType WorkerCounts[] = { 1, 2, 4, 8, 16, 32 };
+const SizeType NumRuns = 3;
+
+// Submitted from the main thread, every task goes through the shared queue or the injection queue
+const SizeType NumExternalTasks = 20000;
+// Roots scheduling children from the workers, the way tile and frame decoders split their work
+const SizeType NumRootTasks = 200;
+const SizeType NumChildTasks = 100;
+
+// A couple of microseconds of work, short enough that the scheduler overhead shows
+const SizeType TaskWorkIterations = 500;
+
+std::atomic<uint32_t> workSink = 0;
+
+void doTaskWork()
+{
+	uint32_t value = 2166136261U;
+	for (SizeType i = 0; i < TaskWorkIterations; ++i)
+		value = (value ^ (uint32_t)i) * 16777619U;
+	workSink.fetch_add(value, std::memory_order_relaxed);
+}
+
+// Lets the main thread sleep until the last task is done
+class Completion
+{
+public:
+	explicit Completion(SizeType numTasks)
+		: numRemaining(numTasks)
+	{
+	}
+
+	void finishOne()
+	{
+		if (--numRemaining == 0)
+		{
+			MutexGuard lock(mutex);
+			finished = true;
+			condition.notifyAll();
+		}
+	}
+
+	void wait()
+	{
+		MutexGuard lock(mutex);
+		condition.wait(lock, [this]()
+		{
+			return finished;
+		});
+	}
+
+private:
+	std::atomic<SizeType> numRemaining;
+	// Set under the mutex so the waiter can't return and destroy this while it's still being notified
+	bool finished = false;
+	Mutex mutex;
+	ConditionVariable condition;
+};
+
+TimeSpan runExternal(thread::ThreadScheduler &scheduler)
+{
+	Completion completion(NumExternalTasks);
+
+	SteadyTimer timer;
+	for (SizeType i = 0; i < NumExternalTasks; ++i)
+	{
+		scheduler.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, [&completion]()
+		{
+			doTaskWork();
+			completion.finishOne();
+		});
+	}
+	completion.wait();
+	return timer.getElapsedTime();
+}
+
+TimeSpan runFanOut(thread::ThreadScheduler &scheduler)
+{
+	Completion completion(NumRootTasks * (NumChildTasks + 1));
+
+	SteadyTimer timer;
+	for (SizeType root = 0; root < NumRootTasks; ++root)
+	{
+		scheduler.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, [&scheduler, &completion]()
+		{
+			for (SizeType child = 0; child < NumChildTasks; ++child)
+			{
+				scheduler.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, [&completion]()
+				{
+					doTaskWork();
+					completion.finishOne();
+				});
+			}
+			completion.finishOne();
+		});
+	}
+	completion.wait();
+	return timer.getElapsedTime();
+}
+
+double measureTasksPerSecond(thread::ThreadScheduler::ExecutionMode mode, SizeType numWorkers,
+	TimeSpan(*workload)(thread::ThreadScheduler &), SizeType numTasks)
+{
+	thread::ThreadScheduler scheduler(mode, numWorkers);
+	scheduler.initialize();
+
+	TimeSpan fastest = TimeSpan::zero;
+	for (SizeType run = 0; run < NumRuns; ++run)
+	{
+		const TimeSpan elapsed = workload(scheduler);
+		if (run == 0 || elapsed < fastest)
+			fastest = elapsed;
+	}
+
+	scheduler.deinitialize();
+
+	const double seconds = std::max(fastest.getMicroseconds(), (int64_t)1) / 1000000.0;
+	return numTasks / seconds;
+}
+
+void benchmarkWorkload(const char *name, TimeSpan(*workload)(thread::ThreadScheduler &), SizeType numTasks)
+{
+	common::Log::write(TS_FMT("  %s, %u tasks\n", name, numTasks));
+
+	const SizeType numHardware = math::max(thread::ThreadScheduler::numHardwareThreads(), 1U);
+	for (SizeType numWorkers : WorkerCounts)
+	{
+		// Oversubscribing only measures the operating system scheduler
+		if (numWorkers > 1 && numWorkers > numHardware)
+			break;
+
+		const double shared = measureTasksPerSecond(thread::ThreadScheduler::Execution_SharedQueue, numWorkers, workload, numTasks);
+		const double stealing = measureTasksPerSecond(thread::ThreadScheduler::Execution_WorkStealing, numWorkers, workload, numTasks);
+
+		common::Log::write(TS_FMT("    %2u workers   shared %10.0f tasks/s   stealing %10.0f tasks/s   %5.2fx\n",
+			numWorkers, shared, stealing, stealing / shared));
+	}
+}
+
+}
+
+void schedulerThroughputBenchmark()
+{
+	common::Log::write(TS_FMT("Scheduler throughput, fastest of %u runs, %u hardware threads.\n",
+		NumRuns, thread::ThreadScheduler::numHardwareThreads()));
+
+	benchmarkWorkload("Scheduled from the main thread", runExternal, NumExternalTasks);
+	benchmarkWorkload("Scheduled from the workers", runFanOut, NumRootTasks * (NumChildTasks + 1));
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,179 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/ivie/image/PixelKernels.h"
+#include "ts/ivie/image/ThumbnailScaler.h"
+#include "ts/thread/ThreadScheduler.h"
+
+#include <random>
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+// Roughly a 24 megapixel camera image
+const SizeType ImageWidth = 6000;
+const SizeType ImageHeight = 4000;
+const SizeType ThumbnailMaxSize = 300;
+const SizeType NumRuns = 5;
+// Workers of the scheduler the banded path is checked with
+const SizeType NumVerifyWorkers = 4;
+
+typedef std::vector<Byte> PixelBuffer;
+
+void scale(const PixelBuffer &source, const math::VC2U &sourceSize, PixelBuffer &destination,
+	const math::VC2U &destinationSize, const image::PixelKernels &kernels, thread::ThreadScheduler *scheduler = nullptr)
+{
+	destination.resize((size_t)destinationSize.x * destinationSize.y * 4);
+	image::scaleAreaAverage(&source[0], sourceSize.x * 4, sourceSize, true, &destination[0], destinationSize, kernels, scheduler);
+}
+
+bool compareToReference(const PixelBuffer &result, const PixelBuffer &expected, const String &name,
+	const math::VC2U &sourceSize, const math::VC2U &destinationSize)
+{
+	if (result == expected)
+		return true;
+
+	const size_t mismatch = std::mismatch(result.begin(), result.end(), expected.begin()).first - result.begin();
+	common::Log::write(TS_FMT("  MISMATCH %s: %u x %u -> %u x %u, first difference at byte %u\n",
+		name, sourceSize.x, sourceSize.y, destinationSize.x, destinationSize.y, (SizeType)mismatch));
+	return false;
+}
+
+/* Output of every kernel level must match the scalar kernels byte for byte,
+ * both on one thread and split into bands over the scheduler's workers.
+ */
+bool verifyLevels(const PixelBuffer &source, const math::VC2U &sourceSize, const math::VC2U &destinationSize,
+	thread::ThreadScheduler &scheduler)
+{
+	const image::PixelKernels &reference = image::getPixelKernels(image::PixelKernelLevel_Scalar);
+
+	PixelBuffer expected;
+	scale(source, sourceSize, expected, destinationSize, reference);
+
+	bool success = true;
+
+	for (int32_t level = 0; level < image::PixelKernelLevel_NumLevels; ++level)
+	{
+		if (!image::isPixelKernelLevelSupported((image::PixelKernelLevel)level))
+			continue;
+
+		const image::PixelKernels &kernels = image::getPixelKernels((image::PixelKernelLevel)level);
+
+		PixelBuffer result;
+		scale(source, sourceSize, result, destinationSize, kernels);
+		success = compareToReference(result, expected, kernels.name, sourceSize, destinationSize) && success;
+
+		scale(source, sourceSize, result, destinationSize, kernels, &scheduler);
+		success = compareToReference(result, expected, TS_FMT("%s, %u threads", kernels.name, NumVerifyWorkers),
+			sourceSize, destinationSize) && success;
+	}
+
+	return success;
+}
+
+// Known results the scalar reference has to produce
+bool verifyReference()
+{
+	const image::PixelKernels &reference = image::getPixelKernels(image::PixelKernelLevel_Scalar);
+
+	bool success = true;
+
+	// Solid color stays exactly the same at any ratio
+	{
+		const math::VC2U sourceSize(97, 61);
+		PixelBuffer source((size_t)sourceSize.x * sourceSize.y * 4);
+		for (size_t i = 0; i < source.size(); i += 4)
+		{
+			source[i + 0] = 12;
+			source[i + 1] = 34;
+			source[i + 2] = 200;
+			source[i + 3] = 255;
+		}
+
+		PixelBuffer result;
+		scale(source, sourceSize, result, math::VC2U(13, 7), reference);
+
+		for (size_t i = 0; i < result.size(); i += 4)
+		{
+			if (result[i + 0] != 12 || result[i + 1] != 34 || result[i + 2] != 200 || result[i + 3] != 255)
+			{
+				common::Log::write("  MISMATCH solid color\n");
+				success = false;
+				break;
+			}
+		}
+	}
+
+	// Halving averages 2 x 2 blocks, bottom-up source comes out top row first
+	{
+		const math::VC2U sourceSize(4, 2);
+		const Byte bottomRow[] = { 0, 0, 0, 0,  100, 100, 100, 100,  10, 20, 30, 40,  30, 40, 50, 60 };
+		const Byte topRow[] =    { 200, 200, 200, 200,  100, 100, 100, 100,  50, 60, 70, 80,  70, 80, 90, 100 };
+
+		PixelBuffer source(bottomRow, bottomRow + sizeof(bottomRow));
+		source.insert(source.end(), topRow, topRow + sizeof(topRow));
+
+		PixelBuffer result;
+		scale(source, sourceSize, result, math::VC2U(2, 1), reference);
+
+		const Byte expected[] = { 100, 100, 100, 100,  40, 50, 60, 70 };
+		if (result != PixelBuffer(expected, expected + sizeof(expected)))
+		{
+			common::Log::write("  MISMATCH 2 x 2 average\n");
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+}
+
+void thumbnailBenchmark()
+{
+	common::Log::write(TS_FMT("Image size %u x %u to %u pixels, fastest of %u runs on one thread. Dispatch selects %s.\n",
+		ImageWidth, ImageHeight, ThumbnailMaxSize, NumRuns, image::getPixelKernels().name));
+
+	const math::VC2U imageSize(ImageWidth, ImageHeight);
+	const math::VC2U thumbnailSize = image::getThumbnailSize(imageSize, ThumbnailMaxSize);
+
+	PixelBuffer source((size_t)ImageWidth * ImageHeight * 4);
+	std::mt19937 random(1337);
+	for (Byte &value : source)
+		value = (Byte)random();
+
+	bool success = verifyReference();
+
+	thread::ThreadScheduler scheduler(thread::ThreadScheduler::DefaultExecutionMode, NumVerifyWorkers);
+	scheduler.initialize();
+
+	// Ratios that don't divide evenly, odd widths exercise the vector tails
+	success = verifyLevels(source, imageSize, thumbnailSize, scheduler) && success;
+	success = verifyLevels(source, math::VC2U(1001, 777), math::VC2U(301, 233), scheduler) && success;
+	success = verifyLevels(source, math::VC2U(37, 5000), math::VC2U(3, 299), scheduler) && success;
+	success = verifyLevels(source, math::VC2U(640, 480), math::VC2U(640, 480), scheduler) && success;
+
+	scheduler.deinitialize();
+
+	common::Log::write(TS_FMT("  Output matches the scalar reference: %s\n", success ? "yes" : "NO"));
+	if (!success)
+		reportFailure("Thumbnail scaler output differs from the scalar reference.");
+
+	PixelBuffer destination;
+	for (int32_t level = 0; level < image::PixelKernelLevel_NumLevels; ++level)
+	{
+		if (!image::isPixelKernelLevelSupported((image::PixelKernelLevel)level))
+			continue;
+
+		const image::PixelKernels &kernels = image::getPixelKernels((image::PixelKernelLevel)level);
+		TimeSpan duration = measureFastest(NumRuns, [&]()
+		{
+			scale(source, imageSize, destination, thumbnailSize, kernels);
+		});
+		reportThroughput(TS_FMT("scaleAreaAverage (%s)", kernels.name), duration, (BigSizeType)ImageWidth * ImageHeight);
+	}
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,172 @@
+#include "Precompiled.h"
+
+#include "ts/ivie/benchmark/Benchmark.h"
+#include "ts/ivie/image/ImageBackgroundLoaderWebm.h"
+
+#include "vpx/vpx_image.h"
+
+#include <random>
+
+TS_PACKAGE2(app, benchmark)
+
+namespace
+{
+
+const SizeType FrameWidth = 1920;
+const SizeType FrameHeight = 1080;
+const SizeType NumFramesPerRun = 60;
+const SizeType NumRuns = 5;
+
+// Decoder planes are padded, mimic that to keep rows unaligned like the real thing
+const SizeType PlanePadding = 32;
+
+struct SyntheticFrame
+{
+	std::vector<Byte> planes[4];
+	vpx_image_t image;
+};
+
+void makeSyntheticFrame(SyntheticFrame &frame, bool withAlpha)
+{
+	memset(&frame.image, 0, sizeof(frame.image));
+	frame.image.fmt = VPX_IMG_FMT_I420;
+	frame.image.w = FrameWidth;
+	frame.image.h = FrameHeight;
+	frame.image.d_w = FrameWidth;
+	frame.image.d_h = FrameHeight;
+	frame.image.x_chroma_shift = 1;
+	frame.image.y_chroma_shift = 1;
+
+	if (withAlpha)
+		frame.image.fmt = (vpx_img_fmt_t)(frame.image.fmt | VPX_IMG_FMT_HAS_ALPHA);
+
+	std::mt19937 random(1337);
+
+	const SizeType chromaWidth = (FrameWidth + 1) / 2;
+	const SizeType chromaHeight = (FrameHeight + 1) / 2;
+	const SizeType strides[4] = {
+		FrameWidth + PlanePadding,
+		chromaWidth + PlanePadding,
+		chromaWidth + PlanePadding,
+		FrameWidth + PlanePadding,
+	};
+	const SizeType heights[4] = { FrameHeight, chromaHeight, chromaHeight, FrameHeight };
+
+	for (SizeType plane = 0; plane < 4; ++plane)
+	{
+		if (plane == VPX_PLANE_ALPHA && !withAlpha)
+			continue;
+
+		frame.planes[plane].resize((size_t)strides[plane] * heights[plane]);
+		for (Byte &value : frame.planes[plane])
+			value = (Byte)random();
+
+		frame.image.planes[plane] = &frame.planes[plane][0];
+		frame.image.stride[plane] = (int)strides[plane];
+	}
+}
+
+// What the WebM loader used to do for every frame
+void legacyRepack(const vpx_image_t *image, std::vector<Byte> &framedata)
+{
+	framedata.resize(image->d_w * image->d_h * 4, 255);
+
+	uint32_t i = 0;
+	for (uint32_t y = 0; y < image->d_h; ++y)
+	{
+		for (uint32_t x = 0; x < image->d_w; ++x)
+		{
+			framedata[i + 0] = image->planes[VPX_PLANE_Y][y       * image->stride[VPX_PLANE_Y] + x];
+
+			if ((image->fmt & VPX_IMG_FMT_UV_FLIP) == 0)
+			{
+				framedata[i + 1] = image->planes[VPX_PLANE_U][(y / 2) * image->stride[VPX_PLANE_U] + (x / 2)];
+				framedata[i + 2] = image->planes[VPX_PLANE_V][(y / 2) * image->stride[VPX_PLANE_V] + (x / 2)];
+			}
+			else
+			{
+				framedata[i + 1] = image->planes[VPX_PLANE_V][(y / 2) * image->stride[VPX_PLANE_V] + (x / 2)];
+				framedata[i + 2] = image->planes[VPX_PLANE_U][(y / 2) * image->stride[VPX_PLANE_U] + (x / 2)];
+			}
+
+			if ((image->fmt & VPX_IMG_FMT_HAS_ALPHA) > 0)
+				framedata[i + 3] = image->planes[VPX_PLANE_ALPHA][y * image->stride[VPX_PLANE_ALPHA] + x];
+
+			i += 4;
+		}
+	}
+}
+
+void reportFramerate(const String &label, TimeSpan duration)
+{
+	const BigSizeType numPixels = (BigSizeType)FrameWidth * FrameHeight * NumFramesPerRun;
+	reportThroughput(label, duration, numPixels);
+
+	const double seconds = std::max(duration.getMicroseconds(), (int64_t)1) / 1000000.0;
+	common::Log::write(TS_FMT("  %-40s %9.1f frames/s per core\n", "", NumFramesPerRun / seconds));
+}
+
+void benchmarkFrame(const char *description, const SyntheticFrame &frame)
+{
+	std::vector<Byte> framedata;
+
+	TimeSpan duration = measureFastest(NumRuns, [&]()
+	{
+		for (SizeType i = 0; i < NumFramesPerRun; ++i)
+		{
+			framedata.clear();
+			legacyRepack(&frame.image, framedata);
+		}
+	});
+	reportFramerate(TS_FMT("%s: per-pixel loop", description), duration);
+
+	framedata.resize((size_t)FrameWidth * FrameHeight * 4);
+
+	for (int32_t level = 0; level < image::PixelKernelLevel_NumLevels; ++level)
+	{
+		if (!image::isPixelKernelLevelSupported((image::PixelKernelLevel)level))
+			continue;
+
+		const image::PixelKernels &kernels = image::getPixelKernels((image::PixelKernelLevel)level);
+		duration = measureFastest(NumRuns, [&]()
+		{
+			for (SizeType i = 0; i < NumFramesPerRun; ++i)
+				image::ImageBackgroundLoaderWebm::interleaveFrame(&frame.image, &framedata[0], kernels);
+		});
+		reportFramerate(TS_FMT("%s: interleaveYUVA420 (%s)", description, kernels.name), duration);
+	}
+
+	// Planar frames skip interleaving altogether and upload less
+	typedef image::ImageBackgroundLoaderWebm Loader;
+	const bool hasAlpha = (frame.image.fmt & VPX_IMG_FMT_HAS_ALPHA) != 0;
+	const Loader::PlanarLayout layout = Loader::getPlanarLayout(math::VC2U(FrameWidth, FrameHeight), hasAlpha);
+
+	std::vector<Byte> planarData((size_t)layout.rowPitch * layout.textureSize.y);
+	duration = measureFastest(NumRuns, [&]()
+	{
+		for (SizeType i = 0; i < NumFramesPerRun; ++i)
+			Loader::packPlanarFrame(&frame.image, layout, &planarData[0]);
+	});
+	reportFramerate(TS_FMT("%s: packPlanarFrame", description), duration);
+
+	common::Log::write(TS_FMT("  Upload per frame: interleaved %.2f MB, planar %.2f MB\n",
+		framedata.size() / (1024.0 * 1024.0), planarData.size() / (1024.0 * 1024.0)));
+}
+
+}
+
+void yuvRepackBenchmark()
+{
+	common::Log::write(TS_FMT("Frame size %u x %u, %u frames per run, fastest of %u runs.\n",
+		FrameWidth, FrameHeight, NumFramesPerRun, NumRuns));
+
+	SyntheticFrame frame;
+
+	makeSyntheticFrame(frame, false);
+	benchmarkFrame("I420", frame);
+
+	makeSyntheticFrame(frame, true);
+	benchmarkFrame("I420 + alpha", frame);
+}
+
+TS_END_PACKAGE2()
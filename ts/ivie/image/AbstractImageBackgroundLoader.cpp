@@ -19,7 +19,7 @@ AbstractImageBackgroundLoader::~AbstractImageBackgroundLoader()
 {
 }
 
-void AbstractImageBackgroundLoader::start(bool suspendAfterBufferFullParam)
+void AbstractImageBackgroundLoader::start(bool suspendAfterBufferFullParam, thread::TaskPriority priorityParam)
 {
 	TS_ZONE();
 
@@ -28,15 +28,26 @@ void AbstractImageBackgroundLoader::start(bool suspendAfterBufferFullParam)
 		return;
 
 	suspendAfterBufferFull = suspendAfterBufferFullParam;
+	priority = priorityParam;
 
 	loaderState = Uninitialized;
-	taskId = threadScheduler.scheduleThreadEntry(this, thread::Priority_Normal);
+	taskId = threadScheduler.scheduleThreadEntry(this, priority);
 }
 
 void AbstractImageBackgroundLoader::stop()
 {
 	if (loaderState == Suspended)
 	{
+		{
+			MutexGuard lock(mutex);
+			// Continuation queued before the suspension would otherwise run on a deleted loader
+			if (continuing && threadScheduler.cancelTask(taskId, false))
+				continuing = false;
+		}
+
+		// Suspending doesn't wait for the worker, it may still be finishing a frame or about to run the continuation
+		threadScheduler.waitUntilTaskComplete(taskId);
+
 		deinitialize();
 		return;
 	}
@@ -44,8 +55,17 @@ void AbstractImageBackgroundLoader::stop()
 	{
 		MutexGuard lock(mutex);
 		loaderState = Finished;
+
+		// Nothing is running, finishes here instead of scheduling the loader only for it to stop
+		if (waitingForFrameRequest)
+		{
+			waitingForFrameRequest = false;
+			lock.unlock();
+
+			exitEntry(Aborted);
+			return;
+		}
 	}
-	condition.notifyAll();
 
 	threadScheduler.waitUntilTaskComplete(taskId);
 }
@@ -66,8 +86,14 @@ void AbstractImageBackgroundLoader::suspend(bool waitUntilBufferIsFull)
 		}
 
 		loaderState = Suspended;
+
+		if (!waitingForFrameRequest)
+			return;
+
+		waitingForFrameRequest = false;
 	}
-	condition.notifyAll();
+
+	exitEntry(Pending);
 
 // 	threadScheduler.waitUntilTaskComplete(taskId);
 }
@@ -82,7 +108,11 @@ void AbstractImageBackgroundLoader::resume()
 		MutexGuard lock(mutex);
 		suspendAfterBufferFull = false;
 		loaderState = Resuming;
-		taskId = threadScheduler.scheduleThreadEntry(this, thread::Priority_High);
+		// Resumed for the image being viewed, never behind the neighbours still loading
+		if (continuing)
+			threadScheduler.setTaskPriority(taskId, math::min(priority, thread::Priority_High));
+		else
+			taskId = threadScheduler.scheduleThreadEntry(this, math::min(priority, thread::Priority_High));
 	}
 }
 
@@ -92,6 +122,15 @@ void AbstractImageBackgroundLoader::cancelPendingSuspension()
 	suspendAfterBufferFull = false;
 }
 
+void AbstractImageBackgroundLoader::setPriority(thread::TaskPriority priorityParam)
+{
+	MutexGuard lock(mutex);
+	priority = priorityParam;
+
+	if (loaderState != Inactive)
+		threadScheduler.setTaskPriority(taskId, priority);
+}
+
 bool AbstractImageBackgroundLoader::isSuspended() const
 {
 	return loaderState == Suspended;
@@ -108,7 +147,16 @@ void AbstractImageBackgroundLoader::entry()
 
 	{
 		MutexGuard lock(mutex);
-		if (loaderState == Uninitialized)
+		if (continuing)
+		{
+			// Picks up where it left off, stop or suspend may have come in while it was queued
+			continuing = false;
+
+			// Suspended and resumed again before it got to run, nothing was suspended yet
+			if (loaderState == Resuming)
+				loaderState = Running;
+		}
+		else if (loaderState == Uninitialized)
 		{
 			if (initialize())
 			{
@@ -137,13 +185,6 @@ void AbstractImageBackgroundLoader::entry()
 		}
 	}
 
-	enum ProcessingState
-	{
-		Pending,
-		Complete,
-		Error,
-		Aborted,
-	};
 	ProcessingState processingState = Pending;
 
 	while (loaderState == Running)
@@ -158,36 +199,53 @@ void AbstractImageBackgroundLoader::entry()
 				break;
 			}
 
-			FrameStorage *storage = ownerImage->getNextBuffer();
-			if (storage != nullptr)
+			if (hasPartialFrame())
 			{
-				TS_ZONE_NAMED("loadNextFrame");
+				TS_ZONE_NAMED("continuePartialFrame");
 
-				bool success = loadNextFrame(*storage);
-				if (success)
+				if (!continuePartialFrame())
+				{
+					processingState = Error;
+				}
+				else if (wasLoadingCompleted())
 				{
-					ownerImage->swapBuffer();
+					ownerImage->finalizeBuffer();
+					processingState = Complete;
+				}
+			}
+			else
+			{
+				FrameStorage *storage = ownerImage->getNextBuffer();
+				if (storage != nullptr)
+				{
+					TS_ZONE_NAMED("loadNextFrame");
 
-					if (wasLoadingCompleted())
+					bool success = loadNextFrame(*storage);
+					if (success)
 					{
-						ownerImage->finalizeBuffer();
-						processingState = Complete;
+						ownerImage->swapBuffer();
+
+						if (wasLoadingCompleted())
+						{
+							ownerImage->finalizeBuffer();
+							processingState = Complete;
+						}
+					}
+					else
+					{
+						processingState = Error;
 					}
 				}
 				else
 				{
-					processingState = Error;
+					TS_WPRINTF("Storage was null : Task ID %u (owner %s / loader %s)\n",
+						taskId,
+						ownerImage->getStateString(ownerImage->loaderState),
+						getStateString(loaderState)
+					);
+					processingState = Aborted;
 				}
 			}
-			else
-			{
-				TS_WPRINTF("Storage was null : Task ID %u (owner %s / loader %s)\n",
-					taskId,
-					ownerImage->getStateString(ownerImage->loaderState),
-					getStateString(loaderState)
-				);
-				processingState = Aborted;
-			}
 
 			if (loaderState != Running)
 				break;
@@ -204,21 +262,31 @@ void AbstractImageBackgroundLoader::entry()
 			break;
 		}
 
+		MutexGuard lock(mutex);
 		if (loaderState != Running)
 			break;
 
-		Thread::sleep(TimeSpan::fromMilliseconds(4));
-
-		MutexGuard lock(mutex);
-		condition.wait(lock, [&]()
+		// Frame was requested while the buffer was being filled, there may be room again
+		if (nextFrameRequested)
 		{
-			return loaderState != Running || nextFrameRequested;
-		});
+			nextFrameRequested = false;
+			continue;
+		}
+
+		// Gives the worker back, a few animations waiting for their frames to be shown
+		// shouldn't keep the other images from loading
+		waitingForFrameRequest = true;
+		return;
 	}
 
 	if (loaderState != Suspended && processingState == Pending)
 		processingState = Aborted;
 
+	exitEntry(processingState);
+}
+
+void AbstractImageBackgroundLoader::exitEntry(ProcessingState processingState)
+{
 	switch (processingState)
 	{
 		case Aborted:
@@ -262,13 +330,43 @@ void AbstractImageBackgroundLoader::entry()
 	);
 }
 
-void AbstractImageBackgroundLoader::requestNextFrame()
+void AbstractImageBackgroundLoader::continueIfWaitingUnsafe()
 {
+	if (!waitingForFrameRequest)
+		return;
+
+	waitingForFrameRequest = false;
+	continuing = true;
+	taskId = threadScheduler.scheduleThreadEntry(this, priority);
+}
+
+SharedPointer<sf::Texture> AbstractImageBackgroundLoader::loadCachedFrame(SizeType frameIndex,
+	FrameCache::FrameInfo &outInfo, sf::Texture::PixelFormat pixelFormat)
+{
+	TS_ZONE();
+
+	FramePool &framePool = ownerImage->framePool;
+
+	std::vector<Byte> pixels = framePool.acquireBuffer(0);
+	if (!ownerImage->frameCache.loadFrame(frameIndex, outInfo, pixels))
 	{
-		MutexGuard lock(mutex);
-		nextFrameRequested = true;
+		framePool.releaseBuffer(std::move(pixels));
+		return nullptr;
 	}
-	condition.notifyOne();
+
+	SharedPointer<sf::Texture> texture = framePool.acquireTexture(outInfo.textureSize);
+	if (texture != nullptr)
+		texture->update(&pixels[0], pixelFormat);
+
+	framePool.releaseBuffer(std::move(pixels));
+	return texture;
+}
+
+void AbstractImageBackgroundLoader::requestNextFrame()
+{
+	MutexGuard lock(mutex);
+	nextFrameRequested = true;
+	continueIfWaitingUnsafe();
 }
 
 bool AbstractImageBackgroundLoader::restart(bool suspendAfterBufferFullParam)
@@ -283,12 +381,10 @@ bool AbstractImageBackgroundLoader::restart(bool suspendAfterBufferFullParam)
 	}
 	else if (status > 0)
 	{
-		{
-			MutexGuard lock(mutex);
-			nextFrameRequested = true;
-			suspendAfterBufferFull = suspendAfterBufferFullParam;
-		}
-		condition.notifyOne();
+		MutexGuard lock(mutex);
+		nextFrameRequested = true;
+		suspendAfterBufferFull = suspendAfterBufferFullParam;
+		continueIfWaitingUnsafe();
 		return true;
 	}
 
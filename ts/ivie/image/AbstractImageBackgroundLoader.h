@@ -16,7 +16,7 @@ public:
 	AbstractImageBackgroundLoader(Image *ownerImage, const String &filepath);
 	virtual ~AbstractImageBackgroundLoader();
 
-	void start(bool suspendAfterBufferFull = false);
+	void start(bool suspendAfterBufferFull = false, thread::TaskPriority priority = thread::Priority_Normal);
 	void stop();
 
 	void suspend(bool waitUntilBufferIsFull = false);
@@ -24,6 +24,9 @@ public:
 
 	void cancelPendingSuspension();
 
+	// Used for the loader task from now on, moves the task if it's still waiting in the queue
+	void setPriority(thread::TaskPriority priority);
+
 	bool isSuspended() const;
 	virtual bool isLoadingComplete() const;
 
@@ -64,7 +67,14 @@ public:
 
 	bool hasError() const { return !errorText.isEmpty(); }
 
+	// Loader specific counters for the image stats, empty if the loader has none
+	virtual String getStats() const { return String(); }
+
 protected:
+	/* Loads frames until the loader completes, is suspended or the frame buffer is full.
+	 * A full buffer returns the worker to the scheduler instead of waiting on it,
+	 * requestNextFrame schedules the loader again to continue from where it was.
+	 */
 	virtual void entry() override;
 
 	virtual bool initialize() = 0;
@@ -82,6 +92,19 @@ protected:
 	virtual bool loadNextFrame(FrameStorage &bufferStorage) = 0;
 	virtual bool wasLoadingCompleted() const = 0;
 
+	/* Frames can be published before they're fully uploaded, e.g. tiles of large images.
+	 * While hasPartialFrame returns true continuePartialFrame is called instead of loadNextFrame.
+	 * Returns false on failure.
+	 */
+	virtual bool hasPartialFrame() const { return false; }
+	virtual bool continuePartialFrame() { return true; }
+
+	/* Decompresses a frame from the owner image's frame cache and uploads it to a pooled texture.
+	 * Returns: the texture, null if the frame isn't cached or uploading failed.
+	 */
+	SharedPointer<sf::Texture> loadCachedFrame(SizeType frameIndex, FrameCache::FrameInfo &outInfo,
+		sf::Texture::PixelFormat pixelFormat);
+
 	std::atomic<BackgroundLoaderState> loaderState = Inactive;
 	bool suspendAfterBufferFull = false;
 
@@ -91,18 +114,35 @@ protected:
 	String filepath;
 
 	bool nextFrameRequested = false;
+	// Loader returned its worker with a full buffer, no task is scheduled until a frame is requested
+	bool waitingForFrameRequest = false;
+	// Loader task was scheduled to continue loading rather than to start or resume
+	bool continuing = false;
 
 	thread::Thread *thread = nullptr;
 
 	mutable Mutex mutex;
-	ConditionVariable condition;
 
 // 	thread::SchedulerTaskId getTaskId() const { return taskId; }
 	thread::SchedulerTaskId taskId;
+	thread::TaskPriority priority = thread::Priority_Normal;
 
-private:
 	thread::ThreadScheduler &threadScheduler;
 
+private:
+	enum ProcessingState
+	{
+		Pending,
+		Complete,
+		Error,
+		Aborted,
+	};
+
+	// Reports the outcome to the owner image and suspends or deinitializes the loader
+	void exitEntry(ProcessingState processingState);
+
+	// Schedules the loader again if it's waiting for a frame request. Must be called with the mutex held.
+	void continueIfWaitingUnsafe();
 };
 
 TS_END_PACKAGE2()
@@ -0,0 +1,564 @@
+#include "Precompiled.h"
+#include "DeepZoomImage.h"
+
+#include "ts/ivie/image/PixelKernels.h"
+
+#include "FreeImage.h"
+
+#include <algorithm>
+#include <cmath>
+
+TS_PACKAGE2(app, image)
+
+// Anything smaller is uploaded as a whole (or as a grid of full resolution tiles)
+static const BigSizeType DeepZoomMinimumPixels = 64 * 1024 * 1024;
+
+// Enough for a few screenfuls of tiles on small windows
+static const SizeType MinCachedTiles = 32;
+
+// Views drawn from this level or coarser are built from level one, the full resolution isn't needed
+static const uint32_t SourceReleaseLevel = 2;
+// Decoding the source again takes seconds, zooming out for a moment doesn't release it
+static const TimeSpan SourceReleaseDelay = TimeSpan::fromSeconds(5);
+
+static BigSizeType getTextureBytes(const sf::Texture &texture)
+{
+	const sf::Vector2u size = texture.getSize();
+	return (BigSizeType)size.x * size.y * 4;
+}
+
+DeepZoomImage::DeepZoomImage(FIBITMAP *bitmap, bool hasAlpha, SourceLoader sourceLoader)
+	: imageSize(FreeImage_GetWidth(bitmap), FreeImage_GetHeight(bitmap))
+	, hasAlpha(hasAlpha)
+	, sourceLoader(std::move(sourceLoader))
+	, hasSource(false)
+	, levelBytes(0)
+	, numLevelsBuilt(0)
+	, numSourceReloads(0)
+	, maxCachedTiles(MinCachedTiles)
+	, sourceLastNeeded(Time::now())
+	, stopping(false)
+	, threadScheduler(TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>())
+{
+	TS_ASSERT(bitmap != nullptr);
+	TS_ASSERT(FreeImage_GetBPP(bitmap) == 24 || FreeImage_GetBPP(bitmap) == 32);
+
+	// Each level halves the previous one until the whole image fits a single tile
+	math::VC2U size = imageSize;
+	while (true)
+	{
+		Level level;
+		level.size = size;
+		level.numTiles.x = (size.x + TileSize - 1) / TileSize;
+		level.numTiles.y = (size.y + TileSize - 1) / TileSize;
+		levels.push_back(level);
+
+		if (size.x <= TileSize && size.y <= TileSize)
+			break;
+
+		size.x = math::max(1U, size.x / 2);
+		size.y = math::max(1U, size.y / 2);
+	}
+
+	MutexGuard levelLock(levelMutex);
+	setLevelBitmap(0, bitmap);
+}
+
+DeepZoomImage::~DeepZoomImage()
+{
+	stopping = true;
+
+	thread::SchedulerTaskId taskId = thread::InvalidTaskId;
+	{
+		MutexGuard lock(mutex);
+		if (decodeTaskScheduled)
+			taskId = decodeTaskId;
+	}
+
+	if (taskId != thread::InvalidTaskId)
+	{
+		threadScheduler.cancelTask(taskId, false);
+		threadScheduler.waitUntilTaskComplete(taskId);
+	}
+
+	cachedTiles.clear();
+	lruTiles.clear();
+
+	MutexGuard levelLock(levelMutex);
+	for (uint32_t levelIndex = 0; levelIndex < levels.size(); ++levelIndex)
+		setLevelBitmap(levelIndex, nullptr);
+	levels.clear();
+}
+
+bool DeepZoomImage::shouldUseDeepZoom(const math::VC2U &imageSize)
+{
+	return (BigSizeType)imageSize.x * imageSize.y > DeepZoomMinimumPixels;
+}
+
+void DeepZoomImage::getTiles(float displayScale, const math::VC2 &visibleMin, const math::VC2 &visibleMax,
+	std::vector<DrawTile> &outTiles)
+{
+	TS_ZONE();
+
+	outTiles.clear();
+
+	const uint32_t coarsestLevel = (uint32_t)levels.size() - 1;
+
+	// Finest level that still has at least as many pixels as are displayed
+	uint32_t levelIndex = 0;
+	if (displayScale > 0.f && displayScale < 1.f)
+		levelIndex = math::min((uint32_t)std::floor(std::log2(1.f / displayScale)), coarsestLevel);
+
+	const Level &level = levels[levelIndex];
+	const math::VC2 levelScale(imageSize.x / (float)level.size.x, imageSize.y / (float)level.size.y);
+	const float tileSpanX = TileSize * levelScale.x;
+	const float tileSpanY = TileSize * levelScale.y;
+
+	if (visibleMax.x <= 0.f || visibleMax.y <= 0.f || visibleMin.x >= imageSize.x || visibleMin.y >= imageSize.y)
+		return;
+
+	const uint32_t firstX = (uint32_t)(math::max(0.f, visibleMin.x) / tileSpanX);
+	const uint32_t firstY = (uint32_t)(math::max(0.f, visibleMin.y) / tileSpanY);
+	const uint32_t lastX = math::min((uint32_t)(visibleMax.x / tileSpanX), level.numTiles.x - 1);
+	const uint32_t lastY = math::min((uint32_t)(visibleMax.y / tileSpanY), level.numTiles.y - 1);
+
+	const math::VC2 visibleCenter = (visibleMin + visibleMax) * 0.5f;
+
+	const Time now = Time::now();
+
+	MutexGuard lock(mutex);
+
+	if (levelIndex < SourceReleaseLevel)
+		sourceLastNeeded = now;
+
+	// Keep a couple of views' worth of tiles around, panning back and forth shouldn't decode again
+	const SizeType numVisibleTiles = (lastX - firstX + 1) * (lastY - firstY + 1);
+	maxCachedTiles = math::max(maxCachedTiles, numVisibleTiles * 2 + (SizeType)levels.size());
+
+	std::vector<TileKey> missingTiles;
+	std::map<TileKey, SharedPointer<sf::Texture>> fallbackTiles;
+	bool hasFallbackForAll = true;
+
+	for (uint32_t y = firstY; y <= lastY; ++y)
+	{
+		for (uint32_t x = firstX; x <= lastX; ++x)
+		{
+			const TileKey key = { levelIndex, x, y };
+
+			SharedPointer<sf::Texture> texture = findCachedTile(key);
+			if (texture != nullptr)
+			{
+				outTiles.push_back(makeDrawTile(key, texture));
+				continue;
+			}
+
+			if (failedTiles.count(key) == 0)
+				missingTiles.push_back(key);
+
+			// Cover the hole with the closest coarser tile there is
+			const math::VC2 tileCenter((x + 0.5f) * tileSpanX, (y + 0.5f) * tileSpanY);
+
+			bool foundFallback = false;
+			for (uint32_t coarserIndex = levelIndex + 1; coarserIndex <= coarsestLevel && !foundFallback; ++coarserIndex)
+			{
+				const Level &coarser = levels[coarserIndex];
+				const TileKey coarserKey = {
+					coarserIndex,
+					math::min((uint32_t)(tileCenter.x * coarser.size.x / imageSize.x) / TileSize, coarser.numTiles.x - 1),
+					math::min((uint32_t)(tileCenter.y * coarser.size.y / imageSize.y) / TileSize, coarser.numTiles.y - 1),
+				};
+
+				if (fallbackTiles.count(coarserKey) > 0)
+				{
+					foundFallback = true;
+					break;
+				}
+
+				SharedPointer<sf::Texture> coarserTexture = findCachedTile(coarserKey);
+				if (coarserTexture != nullptr)
+				{
+					fallbackTiles[coarserKey] = coarserTexture;
+					foundFallback = true;
+				}
+			}
+
+			hasFallbackForAll = hasFallbackForAll && foundFallback;
+		}
+	}
+
+	// Fallbacks are drawn first, coarsest at the bottom
+	if (!fallbackTiles.empty())
+	{
+		std::vector<DrawTile> drawTiles;
+		drawTiles.reserve(fallbackTiles.size() + outTiles.size());
+
+		for (auto it = fallbackTiles.rbegin(); it != fallbackTiles.rend(); ++it)
+			drawTiles.push_back(makeDrawTile(it->first, it->second));
+
+		drawTiles.insert(drawTiles.end(), outTiles.begin(), outTiles.end());
+		outTiles.swap(drawTiles);
+	}
+
+	// Middle of the view first
+	std::stable_sort(missingTiles.begin(), missingTiles.end(),
+		[&](const TileKey &a, const TileKey &b)
+		{
+			const math::VC2 deltaA = math::VC2((a.x + 0.5f) * tileSpanX, (a.y + 0.5f) * tileSpanY) - visibleCenter;
+			const math::VC2 deltaB = math::VC2((b.x + 0.5f) * tileSpanX, (b.y + 0.5f) * tileSpanY) - visibleCenter;
+			return deltaA.x * deltaA.x + deltaA.y * deltaA.y < deltaB.x * deltaB.x + deltaB.y * deltaB.y;
+		});
+
+	// The single coarsest tile is cheap once its level exists and covers everything
+	const TileKey coarsestKey = { coarsestLevel, 0, 0 };
+	if (!hasFallbackForAll && levelIndex != coarsestLevel && cachedTiles.count(coarsestKey) == 0)
+		missingTiles.insert(missingTiles.begin(), coarsestKey);
+
+	// Tiles that went out of view since the last call are no longer wanted
+	requestedTiles.swap(missingTiles);
+
+	// Worker releases the full resolution bitmap once it has nothing left to decode
+	const bool canReleaseSource = hasSource && sourceLoader != nullptr && !keepSource &&
+		now - sourceLastNeeded >= SourceReleaseDelay;
+
+	if ((!requestedTiles.empty() || canReleaseSource) && !decodeTaskScheduled)
+	{
+		decodeTaskId = threadScheduler.scheduleDetached(
+			thread::Priority_High, TimeSpan::zero,
+			&ThisClass::decodeRequestedTiles, this
+		);
+
+		decodeTaskScheduled = true;
+	}
+}
+
+bool DeepZoomImage::getCoarsestTile(DrawTile &outTile)
+{
+	TS_ZONE();
+
+	const TileKey key = { (uint32_t)levels.size() - 1, 0, 0 };
+
+	SharedPointer<sf::Texture> texture;
+	{
+		MutexGuard lock(mutex);
+		texture = findCachedTile(key);
+	}
+
+	if (texture == nullptr)
+	{
+		texture = decodeTile(key);
+		if (texture == nullptr)
+			return false;
+
+		MutexGuard lock(mutex);
+		insertCachedTile(key, texture);
+	}
+
+	outTile = makeDrawTile(key, texture);
+	return true;
+}
+
+DeepZoomImage::CacheStats DeepZoomImage::getStats() const
+{
+	CacheStats stats;
+	{
+		MutexGuard lock(mutex);
+		stats.numCachedTiles = (SizeType)cachedTiles.size();
+		stats.maxCachedTiles = maxCachedTiles;
+		stats.numTilesDecoded = numTilesDecoded;
+		stats.tileBytes = tileBytes;
+	}
+
+	// Levels take a while to build, counters are read without waiting for the level mutex
+	stats.numLevelsBuilt = numLevelsBuilt;
+	stats.numSourceReloads = numSourceReloads;
+	stats.levelBytes = levelBytes;
+
+	return stats;
+}
+
+FIBITMAP *DeepZoomImage::getLevelBitmap(uint32_t levelIndex, MutexGuard &levelLock)
+{
+	TS_ASSERT(levelIndex < levels.size());
+
+	Level &level = levels[levelIndex];
+	if (level.bitmap != nullptr)
+		return level.bitmap;
+
+	if (levelIndex == 0)
+	{
+		if (sourceLoader == nullptr || sourceReloadFailed)
+			return nullptr;
+
+		TS_ZONE_NAMED("Reload deep zoom source");
+
+		// Decoding the whole file takes a while, tiles of the other levels can be cut meanwhile
+		levelLock.unlock();
+		FIBITMAP *bitmap = sourceLoader();
+		levelLock.lock();
+
+		if (bitmap != nullptr && (FreeImage_GetWidth(bitmap) != level.size.x || FreeImage_GetHeight(bitmap) != level.size.y ||
+			(FreeImage_GetBPP(bitmap) != 24 && FreeImage_GetBPP(bitmap) != 32)))
+		{
+			FreeImage_Unload(bitmap);
+			bitmap = nullptr;
+		}
+
+		if (bitmap == nullptr)
+		{
+			TS_LOG_ERROR("Failed to decode the deep zoom source again (%u x %u).", level.size.x, level.size.y);
+			sourceReloadFailed = true;
+			return nullptr;
+		}
+
+		// Someone else reloaded it while the lock was released
+		if (level.bitmap != nullptr)
+		{
+			FreeImage_Unload(bitmap);
+			return level.bitmap;
+		}
+
+		setLevelBitmap(0, bitmap);
+		numSourceReloads++;
+		return bitmap;
+	}
+
+	// Closest finer level is the least work to downsample from, level one once the source is released
+	uint32_t sourceIndex = levelIndex - 1;
+	while (sourceIndex > 0 && levels[sourceIndex].bitmap == nullptr)
+		sourceIndex--;
+
+	FIBITMAP *source = getLevelBitmap(sourceIndex, levelLock);
+	if (source == nullptr)
+		return nullptr;
+
+	// Lock may have been released to reload the source
+	if (level.bitmap != nullptr)
+		return level.bitmap;
+
+	TS_ZONE_NAMED("Build pyramid level");
+
+	FIBITMAP *bitmap = FreeImage_Rescale(source, level.size.x, level.size.y, FILTER_BOX);
+	if (bitmap == nullptr)
+	{
+		TS_LOG_ERROR("Failed to build deep zoom level %u (%u x %u).", levelIndex, level.size.x, level.size.y);
+		return nullptr;
+	}
+
+	setLevelBitmap(levelIndex, bitmap);
+	return bitmap;
+}
+
+void DeepZoomImage::setLevelBitmap(uint32_t levelIndex, FIBITMAP *bitmap)
+{
+	Level &level = levels[levelIndex];
+
+	if (level.bitmap != nullptr)
+	{
+		levelBytes -= (BigSizeType)FreeImage_GetPitch(level.bitmap) * level.size.y;
+		numLevelsBuilt--;
+		FreeImage_Unload(level.bitmap);
+	}
+
+	level.bitmap = bitmap;
+
+	if (bitmap != nullptr)
+	{
+		levelBytes += (BigSizeType)FreeImage_GetPitch(bitmap) * level.size.y;
+		numLevelsBuilt++;
+	}
+
+	if (levelIndex == 0)
+		hasSource = bitmap != nullptr;
+}
+
+void DeepZoomImage::releaseSourceIfUnused()
+{
+	if (sourceLoader == nullptr || levels.size() <= SourceReleaseLevel)
+		return;
+
+	{
+		MutexGuard lock(mutex);
+		if (keepSource || Time::now() - sourceLastNeeded < SourceReleaseDelay)
+			return;
+	}
+
+	MutexGuard levelLock(levelMutex);
+	if (levels[0].bitmap == nullptr)
+		return;
+
+	TS_ZONE();
+
+	// The other levels are built from level one once the source is gone
+	if (getLevelBitmap(1, levelLock) == nullptr)
+	{
+		MutexGuard lock(mutex);
+		keepSource = true;
+		return;
+	}
+
+	setLevelBitmap(0, nullptr);
+}
+
+SharedPointer<sf::Texture> DeepZoomImage::decodeTile(const TileKey &key)
+{
+	TS_ZONE();
+
+	const Level &level = levels[key.level];
+
+	const uint32_t left = key.x * TileSize;
+	const uint32_t top = key.y * TileSize;
+	const uint32_t width = math::min(TileSize, level.size.x - left);
+	const uint32_t height = math::min(TileSize, level.size.y - top);
+
+	// Rows are kept in FreeImage order (bottom-up), the display shader flips them
+	const SizeType pitch = width * 4;
+	std::vector<Byte> pixels((size_t)pitch * height);
+
+	// Level stays locked while its pixels are copied, the source may be released otherwise
+	{
+		MutexGuard levelLock(levelMutex);
+
+		FIBITMAP *levelBitmap = getLevelBitmap(key.level, levelLock);
+		if (levelBitmap == nullptr)
+			return nullptr;
+
+		// View shares the pixels of the level, nothing is copied
+		FIBITMAP *view = FreeImage_CreateView(levelBitmap, left, top, left + width, top + height);
+		if (view == nullptr)
+		{
+			TS_LOG_ERROR("FreeImage_CreateView failed for deep zoom tile.");
+			return nullptr;
+		}
+
+		const PixelKernels &kernels = getPixelKernels();
+		const uint32_t bitdepth = FreeImage_GetBPP(view);
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const BYTE *source = FreeImage_GetScanLine(view, y);
+			Byte *destination = &pixels[(size_t)y * pitch];
+
+			if (bitdepth == 24)
+				kernels.expandBGRToBGRA(source, destination, width);
+			else if (!hasAlpha)
+				kernels.copyBGRAOpaque(source, destination, width);
+			else
+				memcpy(destination, source, pitch);
+		}
+
+		FreeImage_Unload(view);
+	}
+
+	SharedPointer<sf::Texture> texture = makeShared<sf::Texture>();
+	if (texture == nullptr || !texture->create(width, height))
+	{
+		TS_LOG_ERROR("Failed to create texture for deep zoom tile. Tile size: %u x %u", width, height);
+		return nullptr;
+	}
+
+	texture->update(&pixels[0], width, height, 0, 0, sf::Texture::BGRA);
+	texture->generateMipmap();
+	texture->setRepeated(false);
+
+	return texture;
+}
+
+SharedPointer<sf::Texture> DeepZoomImage::findCachedTile(const TileKey &key)
+{
+	auto it = cachedTiles.find(key);
+	if (it == cachedTiles.end())
+		return nullptr;
+
+	lruTiles.splice(lruTiles.begin(), lruTiles, it->second.lruPosition);
+	return it->second.texture;
+}
+
+void DeepZoomImage::insertCachedTile(const TileKey &key, SharedPointer<sf::Texture> texture)
+{
+	if (cachedTiles.count(key) > 0)
+		return;
+
+	lruTiles.push_front(key);
+
+	CacheEntry &entry = cachedTiles[key];
+	entry.texture = texture;
+	entry.lruPosition = lruTiles.begin();
+
+	numTilesDecoded++;
+	tileBytes += getTextureBytes(*texture);
+
+	while (cachedTiles.size() > maxCachedTiles)
+	{
+		auto it = cachedTiles.find(lruTiles.back());
+		tileBytes -= getTextureBytes(*it->second.texture);
+
+		cachedTiles.erase(it);
+		lruTiles.pop_back();
+	}
+}
+
+DeepZoomImage::DrawTile DeepZoomImage::makeDrawTile(const TileKey &key, SharedPointer<sf::Texture> texture) const
+{
+	const Level &level = levels[key.level];
+
+	DrawTile tile;
+	tile.texture = texture;
+	tile.scale = math::VC2(imageSize.x / (float)level.size.x, imageSize.y / (float)level.size.y);
+	tile.position = math::VC2(key.x * TileSize * tile.scale.x, key.y * TileSize * tile.scale.y);
+	tile.size.x = math::min(TileSize, level.size.x - key.x * TileSize);
+	tile.size.y = math::min(TileSize, level.size.y - key.y * TileSize);
+	return tile;
+}
+
+void DeepZoomImage::decodeRequestedTiles()
+{
+	TS_ZONE();
+
+	bool sourceChecked = false;
+
+	while (true)
+	{
+		TileKey key;
+		bool checkSource = false;
+		{
+			MutexGuard lock(mutex);
+			if (stopping || (requestedTiles.empty() && sourceChecked))
+			{
+				// Cleared in the same lock so requests made after this schedule a new task
+				decodeTaskScheduled = false;
+				return;
+			}
+
+			if (!requestedTiles.empty())
+			{
+				key = requestedTiles.front();
+				requestedTiles.erase(requestedTiles.begin());
+
+				if (cachedTiles.count(key) > 0 || failedTiles.count(key) > 0)
+					continue;
+			}
+			else
+			{
+				checkSource = true;
+				sourceChecked = true;
+			}
+		}
+
+		// Out of tiles, the view may not need the full resolution anymore
+		if (checkSource)
+		{
+			releaseSourceIfUnused();
+			continue;
+		}
+
+		SharedPointer<sf::Texture> texture = decodeTile(key);
+
+		MutexGuard lock(mutex);
+		if (texture != nullptr)
+			insertCachedTile(key, texture);
+		else
+			failedTiles.insert(key);
+	}
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "ts/thread/ThreadScheduler.h"
+
+#include <functional>
+#include <list>
+
+struct FIBITMAP;
+
+TS_PACKAGE2(app, image)
+
+/* Display source for very large images. Instead of uploading the whole image, the image is
+ * kept as a pyramid of downsampled levels and only the tiles the view needs at the current
+ * zoom are cut out and uploaded, on a worker thread. Uploaded tiles are kept in a cache of
+ * least recently used tiles, sized by the number of tiles that fit the view.
+ *
+ * FreeImage can't decode parts of a file, so the full resolution bitmap is kept while the view
+ * needs it. Downsampled levels are built from it the first time they are needed. Once the view
+ * has stayed zoomed out past level one for a while, level one is built and the full resolution
+ * bitmap is released, and decoded again with the source loader when the view zooms back in.
+ * Levels from one down take a third of the full resolution bitmap's memory.
+ */
+class DeepZoomImage : public lang::Noncopyable
+{
+	typedef DeepZoomImage ThisClass;
+
+public:
+	static const uint32_t TileSize = 512;
+
+	/* Decodes the full resolution bitmap again, the same size and format as the one given to the
+	 * constructor. Called on a worker thread. Returns: the bitmap, null on failure.
+	 */
+	typedef std::function<FIBITMAP *()> SourceLoader;
+
+	/* Takes ownership of the bitmap, which must be a 24 or 32-bit FIT_BITMAP.
+	 * Without a source loader the full resolution bitmap is never released.
+	 */
+	DeepZoomImage(FIBITMAP *bitmap, bool hasAlpha, SourceLoader sourceLoader = nullptr);
+	~DeepZoomImage();
+
+	/* Returns: true if the image is large enough to be better off displayed through the cache.
+	 */
+	static bool shouldUseDeepZoom(const math::VC2U &imageSize);
+
+	struct DrawTile
+	{
+		SharedPointer<sf::Texture> texture;
+		// Position of the tile in image pixels
+		math::VC2 position;
+		// Image pixels per tile texel
+		math::VC2 scale;
+		// Size of the tile in texels
+		math::VC2U size;
+	};
+
+	/* Collects tiles covering the visible area of the image (in image pixels) at the level of
+	 * detail matching the display scale. Tiles not uploaded yet are requested from a worker and
+	 * covered with coarser tiles in the meantime. Tiles are ordered coarsest first.
+	 */
+	void getTiles(float displayScale, const math::VC2 &visibleMin, const math::VC2 &visibleMax,
+		std::vector<DrawTile> &outTiles);
+
+	/* Uploads the single tile of the coarsest level right away, used for the thumbnail.
+	 * Returns: false if the tile couldn't be made.
+	 */
+	bool getCoarsestTile(DrawTile &outTile);
+
+	const math::VC2U &getImageSize() const { return imageSize; }
+	SizeType getNumLevels() const { return (SizeType)levels.size(); }
+
+	struct CacheStats
+	{
+		SizeType numCachedTiles = 0;
+		SizeType maxCachedTiles = 0;
+		SizeType numLevelsBuilt = 0;
+		SizeType numTilesDecoded = 0;
+		SizeType numSourceReloads = 0;
+		// Pixels of the levels in memory, and the uploaded tile textures
+		BigSizeType levelBytes = 0;
+		BigSizeType tileBytes = 0;
+	};
+	CacheStats getStats() const;
+
+private:
+	struct TileKey
+	{
+		uint32_t level;
+		uint32_t x;
+		uint32_t y;
+
+		bool operator<(const TileKey &other) const
+		{
+			if (level != other.level) return level < other.level;
+			if (y != other.y) return y < other.y;
+			return x < other.x;
+		}
+
+		bool operator==(const TileKey &other) const
+		{
+			return level == other.level && x == other.x && y == other.y;
+		}
+	};
+
+	struct Level
+	{
+		// Level zero is the source bitmap
+		FIBITMAP *bitmap = nullptr;
+		math::VC2U size;
+		math::VC2U numTiles;
+	};
+
+	struct CacheEntry
+	{
+		SharedPointer<sf::Texture> texture;
+		std::list<TileKey>::iterator lruPosition;
+	};
+
+	/* Returns: bitmap of the level, building it from a finer level if needed. Null on failure.
+	 * Level mutex must be locked, it's unlocked while the source is decoded again.
+	 */
+	FIBITMAP *getLevelBitmap(uint32_t level, MutexGuard &levelLock);
+	void setLevelBitmap(uint32_t level, FIBITMAP *bitmap);
+
+	// Releases the full resolution bitmap if the view is coarse enough to do without it
+	void releaseSourceIfUnused();
+
+	SharedPointer<sf::Texture> decodeTile(const TileKey &key);
+
+	// Returns: the cached texture of the tile and marks it as recently used, null if not cached
+	SharedPointer<sf::Texture> findCachedTile(const TileKey &key);
+	void insertCachedTile(const TileKey &key, SharedPointer<sf::Texture> texture);
+
+	DrawTile makeDrawTile(const TileKey &key, SharedPointer<sf::Texture> texture) const;
+
+	void decodeRequestedTiles();
+
+	const math::VC2U imageSize;
+	const bool hasAlpha;
+
+	std::vector<Level> levels;
+	mutable Mutex levelMutex;
+
+	SourceLoader sourceLoader;
+	// Not tried again, every tile of the full resolution would decode the whole file
+	bool sourceReloadFailed = false;
+	std::atomic_bool hasSource;
+	std::atomic<BigSizeType> levelBytes;
+	std::atomic<SizeType> numLevelsBuilt;
+	std::atomic<SizeType> numSourceReloads;
+
+	std::map<TileKey, CacheEntry> cachedTiles;
+	// Most recently used at the front
+	std::list<TileKey> lruTiles;
+	SizeType maxCachedTiles;
+	BigSizeType tileBytes = 0;
+	// Last time the view was drawn from the full resolution or level one
+	Time sourceLastNeeded;
+	// Level one couldn't be built, the source is kept from then on
+	bool keepSource = false;
+
+	// Tiles wanted by the latest getTiles call, decoded in order by the worker task
+	std::vector<TileKey> requestedTiles;
+	// Tiles that couldn't be made, not requested again
+	std::set<TileKey> failedTiles;
+	thread::SchedulerTaskId decodeTaskId = thread::InvalidTaskId;
+	bool decodeTaskScheduled = false;
+	std::atomic_bool stopping;
+
+	SizeType numTilesDecoded = 0;
+
+	mutable Mutex mutex;
+
+	thread::ThreadScheduler &threadScheduler;
+};
+
+TS_END_PACKAGE2()
@@ -0,0 +1,152 @@
+#include "Precompiled.h"
+#include "FrameCache.h"
+
+#include "lz4.h"
+
+TS_PACKAGE2(app, image)
+
+FrameCache::FrameCache(BigSizeType memoryBudget)
+	: memoryBudget(memoryBudget)
+{
+}
+
+FrameCache::~FrameCache()
+{
+	releaseFrames();
+}
+
+bool FrameCache::storeFrame(SizeType frameIndex, const FrameInfo &info, const Byte *pixels, BigSizeType size)
+{
+	TS_ZONE();
+
+	TS_ASSERT(pixels != nullptr && size > 0);
+
+	MutexGuard lock(mutex);
+
+	if (abandoned)
+		return false;
+
+	if (frameIndex < frames.size() && !frames[frameIndex].data.empty())
+		return true;
+
+	if (size > (BigSizeType)LZ4_MAX_INPUT_SIZE)
+	{
+		releaseFrames();
+		abandoned = true;
+		return false;
+	}
+
+	compressBuffer.resize((size_t)LZ4_compressBound((int32_t)size));
+
+	const int32_t compressedSize = LZ4_compress_default(
+		reinterpret_cast<const char*>(pixels), &compressBuffer[0], (int32_t)size, (int32_t)compressBuffer.size());
+
+	if (compressedSize <= 0)
+	{
+		TS_LOG_ERROR("Failed to compress frame %u for the frame cache.", frameIndex);
+		return false;
+	}
+
+	if (stats.compressedBytes + compressedSize > memoryBudget)
+	{
+		// Too large to keep, drop everything instead of holding on to a cache that won't be used
+		releaseFrames();
+		abandoned = true;
+
+		compressBuffer.clear();
+		compressBuffer.shrink_to_fit();
+		return false;
+	}
+
+	if (frameIndex >= frames.size())
+		frames.resize(frameIndex + 1);
+
+	CachedFrame &frame = frames[frameIndex];
+	frame.info = info;
+	frame.uncompressedSize = size;
+	frame.data.assign(compressBuffer.begin(), compressBuffer.begin() + compressedSize);
+
+	stats.numFrames++;
+	stats.compressedBytes += compressedSize;
+	stats.uncompressedBytes += size;
+
+	return true;
+}
+
+bool FrameCache::loadFrame(SizeType frameIndex, FrameInfo &outInfo, std::vector<Byte> &outPixels)
+{
+	TS_ZONE();
+
+	MutexGuard lock(mutex);
+
+	if (frameIndex >= frames.size() || frames[frameIndex].data.empty())
+		return false;
+
+	const CachedFrame &frame = frames[frameIndex];
+
+	outPixels.resize((size_t)frame.uncompressedSize);
+
+	const int32_t decompressedSize = LZ4_decompress_safe(
+		&frame.data[0], reinterpret_cast<char*>(&outPixels[0]), (int32_t)frame.data.size(), (int32_t)frame.uncompressedSize);
+
+	if (decompressedSize != (int32_t)frame.uncompressedSize)
+	{
+		TS_LOG_ERROR("Failed to decompress frame %u from the frame cache.", frameIndex);
+		return false;
+	}
+
+	outInfo = frame.info;
+	stats.numFramesLoaded++;
+
+	return true;
+}
+
+bool FrameCache::isComplete(SizeType numFramesTotal) const
+{
+	MutexGuard lock(mutex);
+	return !abandoned && numFramesTotal > 0 && stats.numFrames == numFramesTotal && frames.size() == numFramesTotal;
+}
+
+bool FrameCache::hasFrame(SizeType frameIndex) const
+{
+	MutexGuard lock(mutex);
+	return frameIndex < frames.size() && !frames[frameIndex].data.empty();
+}
+
+bool FrameCache::isAcceptingFrames() const
+{
+	MutexGuard lock(mutex);
+	return !abandoned;
+}
+
+void FrameCache::clear()
+{
+	MutexGuard lock(mutex);
+
+	releaseFrames();
+	abandoned = false;
+
+	compressBuffer.clear();
+	compressBuffer.shrink_to_fit();
+}
+
+FrameCache::CacheStats FrameCache::getStats() const
+{
+	MutexGuard lock(mutex);
+
+	CacheStats result = stats;
+	result.abandoned = abandoned;
+	return result;
+}
+
+void FrameCache::releaseFrames()
+{
+	frames.clear();
+	frames.shrink_to_fit();
+
+	stats.numFrames = 0;
+	stats.compressedBytes = 0;
+	stats.uncompressedBytes = 0;
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,87 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+enum FrameFormat : int32_t;
+
+/* Decoded frames of an animation, LZ4 compressed in memory. Animations longer than the frame
+ * buffer are otherwise decoded again on every loop. Frames are stored during the first loop
+ * and once all of them are in, the loader plays from the cache by decompressing and uploading
+ * instead of decoding. The cache outlives unloading so coming back to an animation is quick.
+ *
+ * Animations that don't fit the memory budget are not cached at all, a partial cache would
+ * still need the decoder to be brought to the right frame for the rest. The budget is per
+ * animation, the caches of all images are counted in Image::getMemoryUsage and ImageResidency
+ * evicts the least recently viewed images with their caches when the total is over.
+ */
+class FrameCache : public lang::Noncopyable
+{
+public:
+	// Per animation, compressed bytes
+	static const BigSizeType DefaultMemoryBudget = 256ULL * 1024 * 1024;
+
+	struct FrameInfo
+	{
+		math::VC2U textureSize;
+		FrameFormat format;
+		TimeSpan frameTime;
+	};
+
+	explicit FrameCache(BigSizeType memoryBudget = DefaultMemoryBudget);
+	~FrameCache();
+
+	/* Compresses and stores the pixels of the frame. Frames already cached are skipped.
+	 * If the budget runs out the cache is dropped and no longer accepts frames until cleared.
+	 * Returns: true if the frame is in the cache.
+	 */
+	bool storeFrame(SizeType frameIndex, const FrameInfo &info, const Byte *pixels, BigSizeType size);
+
+	/* Decompresses the frame to outPixels, resizing it to fit.
+	 * Returns: false if the frame isn't cached or is corrupted.
+	 */
+	bool loadFrame(SizeType frameIndex, FrameInfo &outInfo, std::vector<Byte> &outPixels);
+
+	/* Returns: true if every frame of an animation of the given length is cached.
+	 */
+	bool isComplete(SizeType numFramesTotal) const;
+
+	bool hasFrame(SizeType frameIndex) const;
+	bool isAcceptingFrames() const;
+
+	// Frees all frames and starts accepting frames again, e.g. when the file has changed.
+	void clear();
+
+	struct CacheStats
+	{
+		SizeType numFrames = 0;
+		BigSizeType compressedBytes = 0;
+		BigSizeType uncompressedBytes = 0;
+		SizeType numFramesLoaded = 0;
+		bool abandoned = false;
+	};
+	CacheStats getStats() const;
+
+private:
+	void releaseFrames();
+
+	struct CachedFrame
+	{
+		FrameInfo info;
+		BigSizeType uncompressedSize = 0;
+		std::vector<char> data;
+	};
+	// Indexed by frame index, frames not cached have no data
+	std::vector<CachedFrame> frames;
+
+	const BigSizeType memoryBudget;
+	bool abandoned = false;
+
+	CacheStats stats;
+
+	// Reused for compressing, frames are copied out at their compressed size
+	std::vector<char> compressBuffer;
+
+	mutable Mutex mutex;
+};
+
+TS_END_PACKAGE2()
@@ -0,0 +1,195 @@
+#include "Precompiled.h"
+#include "FrameCompositor.h"
+
+#include "ts/ivie/image/PixelKernels.h"
+
+TS_PACKAGE2(app, image)
+
+FrameCompositor::FrameCompositor()
+{
+}
+
+FrameCompositor::~FrameCompositor()
+{
+}
+
+void FrameCompositor::initialize(const math::VC2U &canvasSizeParam)
+{
+	canvasSize = canvasSizeParam;
+	pitch = canvasSize.x * 4;
+
+	canvas.assign((size_t)pitch * canvasSize.y, 0);
+	savedPixels.clear();
+
+	pendingDisposal = DisposalMethod_Unspecified;
+
+	invalidate();
+}
+
+void FrameCompositor::releaseMemory()
+{
+	canvas.clear();
+	canvas.shrink_to_fit();
+	savedPixels.clear();
+	savedPixels.shrink_to_fit();
+
+	canvasSize = math::VC2U(0, 0);
+	pitch = 0;
+	pendingDisposal = DisposalMethod_Unspecified;
+	dirty = false;
+}
+
+void FrameCompositor::restart()
+{
+	TS_ASSERT(!canvas.empty() && "Compositor has not been initialized.");
+
+	std::fill(canvas.begin(), canvas.end(), (Byte)0);
+	pendingDisposal = DisposalMethod_Unspecified;
+
+	invalidate();
+}
+
+void FrameCompositor::drawFrame(const Byte *pixels, SizeType framePitch, const math::VC2U &frameSize,
+	const math::VC2U &offset, DisposalMethod disposalMethod)
+{
+	TS_ZONE();
+
+	TS_ASSERT(pixels != nullptr);
+	TS_ASSERT(!canvas.empty() && "Compositor has not been initialized.");
+
+	disposePreviousFrame();
+
+	// Frames reaching past the canvas are clipped, the format doesn't forbid them
+	const uint32_t left = math::min(offset.x, canvasSize.x);
+	const uint32_t top = math::min(offset.y, canvasSize.y);
+
+	Region region;
+	region.size.x = math::min(frameSize.x, canvasSize.x - left);
+	region.size.y = math::min(frameSize.y, canvasSize.y - top);
+	region.position.x = left;
+	region.position.y = canvasSize.y - top - region.size.y;
+
+	pendingDisposal = disposalMethod;
+	pendingRegion = region;
+
+	if (region.size.x == 0 || region.size.y == 0)
+		return;
+
+	const SizeType rowBytes = region.size.x * 4;
+
+	if (disposalMethod == DisposalMethod_Previous)
+	{
+		savedPixels.resize((size_t)rowBytes * region.size.y);
+		for (SizeType y = 0; y < region.size.y; ++y)
+			memcpy(&savedPixels[(size_t)y * rowBytes], getRow(region.position.y + y) + region.position.x * 4, rowBytes);
+	}
+
+	// Bottom rows of a frame clipped at the bottom edge are below the canvas
+	const SizeType firstFrameRow = frameSize.y - region.size.y;
+
+	const PixelKernels &kernels = getPixelKernels();
+	for (SizeType y = 0; y < region.size.y; ++y)
+	{
+		const Byte *source = pixels + (size_t)(firstFrameRow + y) * framePitch;
+		Byte *destination = &canvas[(size_t)(region.position.y + y) * pitch + region.position.x * 4];
+		kernels.blendBGRAOver(source, destination, region.size.x);
+	}
+
+	markDirty(region);
+}
+
+void FrameCompositor::disposePreviousFrame()
+{
+	const Region &region = pendingRegion;
+
+	switch (pendingDisposal)
+	{
+		case DisposalMethod_Background:
+		{
+			// Background color is ignored by browsers too, the area is cleared to transparent
+			fillRegion(region, 0);
+			markDirty(region);
+		}
+		break;
+
+		case DisposalMethod_Previous:
+		{
+			const SizeType rowBytes = region.size.x * 4;
+			if (savedPixels.size() == (size_t)rowBytes * region.size.y)
+			{
+				for (SizeType y = 0; y < region.size.y; ++y)
+				{
+					Byte *destination = &canvas[(size_t)(region.position.y + y) * pitch + region.position.x * 4];
+					memcpy(destination, &savedPixels[(size_t)y * rowBytes], rowBytes);
+				}
+				markDirty(region);
+			}
+		}
+		break;
+
+		default: break;
+	}
+
+	pendingDisposal = DisposalMethod_Unspecified;
+}
+
+void FrameCompositor::fillRegion(const Region &region, uint32_t value)
+{
+	for (SizeType y = 0; y < region.size.y; ++y)
+	{
+		uint32_t *row = reinterpret_cast<uint32_t*>(&canvas[(size_t)(region.position.y + y) * pitch]) + region.position.x;
+		std::fill(row, row + region.size.x, value);
+	}
+}
+
+void FrameCompositor::markDirty(const Region &region)
+{
+	if (region.size.x == 0 || region.size.y == 0)
+		return;
+
+	if (!dirty)
+	{
+		dirtyRegion = region;
+		dirty = true;
+		return;
+	}
+
+	const math::VC2U minimum(
+		math::min(dirtyRegion.position.x, region.position.x),
+		math::min(dirtyRegion.position.y, region.position.y));
+	const math::VC2U maximum(
+		math::max(dirtyRegion.position.x + dirtyRegion.size.x, region.position.x + region.size.x),
+		math::max(dirtyRegion.position.y + dirtyRegion.size.y, region.position.y + region.size.y));
+
+	dirtyRegion.position = minimum;
+	dirtyRegion.size = maximum - minimum;
+}
+
+bool FrameCompositor::getDirtyRegion(Region &outRegion) const
+{
+	if (!dirty)
+		return false;
+
+	outRegion = dirtyRegion;
+	return true;
+}
+
+void FrameCompositor::clearDirtyRegion()
+{
+	dirty = false;
+}
+
+void FrameCompositor::invalidate()
+{
+	dirtyRegion.position = math::VC2U(0, 0);
+	dirtyRegion.size = canvasSize;
+	dirty = true;
+}
+
+const Byte *FrameCompositor::getRow(SizeType row) const
+{
+	TS_ASSERT(row < canvasSize.y);
+	return &canvas[(size_t)row * pitch];
+}
+
+TS_END_PACKAGE2()
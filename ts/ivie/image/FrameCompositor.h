@@ -0,0 +1,82 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+/* Composites frames of animated images (GIF and the other FreeImage multipage formats) on a
+ * persistent 32-bit canvas on the CPU. Each frame is drawn at its offset after the previous
+ * frame has been disposed of the way it asked for. The area changed since the canvas was last
+ * uploaded is tracked, so only that part needs to go to the GPU.
+ *
+ * Canvas rows are in FreeImage order (bottom row first), same as the frames drawn on it.
+ */
+class FrameCompositor : public lang::Noncopyable
+{
+public:
+	// Values as stored in the FIMD_ANIMATION "DisposalMethod" tag
+	enum DisposalMethod : uint8_t
+	{
+		DisposalMethod_Unspecified = 0,
+		DisposalMethod_Leave = 1,
+		DisposalMethod_Background = 2,
+		DisposalMethod_Previous = 3,
+	};
+
+	// Area of the canvas, position.y is the first canvas row (counted from the bottom)
+	struct Region
+	{
+		math::VC2U position;
+		math::VC2U size;
+	};
+
+	FrameCompositor();
+	~FrameCompositor();
+
+	/* Allocates a transparent canvas of the given size, dropping the previous one.
+	 */
+	void initialize(const math::VC2U &canvasSize);
+	void releaseMemory();
+
+	/* Clears the canvas for starting the animation over.
+	 */
+	void restart();
+
+	/* Disposes of the previous frame and draws the frame over the canvas.
+	 * pixels: 32-bit BGRA rows of the frame in FreeImage order, pitch bytes apart.
+	 * offset: top left corner of the frame on the canvas, as stored in the file.
+	 * disposalMethod: what to do with the area of the frame before the next frame is drawn.
+	 */
+	void drawFrame(const Byte *pixels, SizeType pitch, const math::VC2U &frameSize,
+		const math::VC2U &offset, DisposalMethod disposalMethod);
+
+	/* Returns: true if the canvas has changed since the last clearDirtyRegion call.
+	 */
+	bool getDirtyRegion(Region &outRegion) const;
+	void clearDirtyRegion();
+	// Marks the whole canvas changed, for when it has to be uploaded again from scratch
+	void invalidate();
+
+	const Byte *getRow(SizeType row) const;
+	SizeType getPitch() const { return pitch; }
+	const math::VC2U &getCanvasSize() const { return canvasSize; }
+
+private:
+	void disposePreviousFrame();
+	void fillRegion(const Region &region, uint32_t value);
+	void markDirty(const Region &region);
+
+	math::VC2U canvasSize;
+	SizeType pitch = 0;
+	std::vector<Byte> canvas;
+
+	// Disposal requested by the last frame drawn, applied before the next one
+	DisposalMethod pendingDisposal = DisposalMethod_Unspecified;
+	Region pendingRegion;
+
+	// Canvas under the last frame, only stored when it is disposed of by restoring
+	std::vector<Byte> savedPixels;
+
+	Region dirtyRegion;
+	bool dirty = false;
+};
+
+TS_END_PACKAGE2()
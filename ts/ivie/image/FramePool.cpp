@@ -0,0 +1,141 @@
+#include "Precompiled.h"
+#include "FramePool.h"
+
+TS_PACKAGE2(app, image)
+
+FramePool::FramePool(SizeType maxFreeTextures, SizeType maxFreeBuffers)
+	: maxFreeTextures(maxFreeTextures)
+	, maxFreeBuffers(maxFreeBuffers)
+{
+}
+
+FramePool::~FramePool()
+{
+	clear();
+}
+
+SharedPointer<sf::Texture> FramePool::acquireTexture(const math::VC2U &size)
+{
+	TS_ZONE();
+
+	{
+		MutexGuard lock(mutex);
+
+		for (auto it = freeTextures.begin(); it != freeTextures.end(); ++it)
+		{
+			// Someone may still be holding on to the texture, it can't be written to before they let go
+			if (!it->isUnique())
+				continue;
+
+			const sf::Vector2u textureSize = (*it)->getSize();
+			if (textureSize.x != size.x || textureSize.y != size.y)
+				continue;
+
+			SharedPointer<sf::Texture> texture = *it;
+			freeTextures.erase(it);
+
+			stats.textureHits++;
+			return texture;
+		}
+
+		stats.textureMisses++;
+	}
+
+	SharedPointer<sf::Texture> texture = makeShared<sf::Texture>();
+	if (texture == nullptr || !texture->create(size.x, size.y))
+		return nullptr;
+
+	return texture;
+}
+
+void FramePool::releaseTexture(SharedPointer<sf::Texture> &&texture)
+{
+	if (texture == nullptr)
+		return;
+
+	MutexGuard lock(mutex);
+
+	if (maxFreeTextures == 0)
+	{
+		texture.reset();
+		return;
+	}
+
+	// Oldest ones are the least likely to be needed again
+	if (freeTextures.size() >= maxFreeTextures)
+		freeTextures.erase(freeTextures.begin());
+
+	freeTextures.push_back(texture);
+	texture.reset();
+}
+
+std::vector<Byte> FramePool::acquireBuffer(BigSizeType size)
+{
+	TS_ZONE();
+
+	MutexGuard lock(mutex);
+
+	std::vector<Byte> buffer;
+
+	for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it)
+	{
+		if (it->capacity() >= size)
+		{
+			buffer = std::move(*it);
+			freeBuffers.erase(it);
+			stats.bufferHits++;
+			break;
+		}
+	}
+
+	if (buffer.capacity() < size)
+	{
+		// Grow the most recently released buffer rather than keeping it next to a new one
+		if (!freeBuffers.empty())
+		{
+			buffer = std::move(freeBuffers.back());
+			freeBuffers.pop_back();
+		}
+		stats.bufferMisses++;
+	}
+
+	buffer.resize((size_t)size);
+	return buffer;
+}
+
+void FramePool::releaseBuffer(std::vector<Byte> &&buffer)
+{
+	if (buffer.capacity() == 0)
+		return;
+
+	MutexGuard lock(mutex);
+
+	if (maxFreeBuffers == 0)
+	{
+		std::vector<Byte>().swap(buffer);
+		return;
+	}
+
+	if (freeBuffers.size() >= maxFreeBuffers)
+		freeBuffers.erase(freeBuffers.begin());
+
+	freeBuffers.push_back(std::move(buffer));
+}
+
+void FramePool::clear()
+{
+	MutexGuard lock(mutex);
+	freeTextures.clear();
+	freeBuffers.clear();
+}
+
+FramePool::PoolStats FramePool::getStats() const
+{
+	MutexGuard lock(mutex);
+	PoolStats result = stats;
+	result.numFreeTextures = (SizeType)freeTextures.size();
+	result.numFreeBuffers = (SizeType)freeBuffers.size();
+	return result;
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,54 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+/* Keeps textures and staging buffers of animated frames around for reuse, so frames cycling
+ * through the frame buffer don't create a new GL texture and pixel buffer every time.
+ * Textures are bucketed by size, a released texture is only handed out again once nothing
+ * else (display, thumbnail task) references it anymore.
+ */
+class FramePool
+{
+public:
+	FramePool(SizeType maxFreeTextures, SizeType maxFreeBuffers);
+	~FramePool();
+
+	/* Returns: a texture of the given size, null if creating a new one failed.
+	 * Contents of a reused texture are undefined.
+	 */
+	SharedPointer<sf::Texture> acquireTexture(const math::VC2U &size);
+	// The given pointer is reset, the texture is reused once other references are gone.
+	void releaseTexture(SharedPointer<sf::Texture> &&texture);
+
+	/* Returns: a buffer resized to the given size. Contents of a reused buffer are undefined.
+	 */
+	std::vector<Byte> acquireBuffer(BigSizeType size);
+	void releaseBuffer(std::vector<Byte> &&buffer);
+
+	// Frees everything held by the pool, counters are kept.
+	void clear();
+
+	struct PoolStats
+	{
+		SizeType textureHits = 0;
+		SizeType textureMisses = 0;
+		SizeType bufferHits = 0;
+		SizeType bufferMisses = 0;
+		SizeType numFreeTextures = 0;
+		SizeType numFreeBuffers = 0;
+	};
+	PoolStats getStats() const;
+
+private:
+	const SizeType maxFreeTextures;
+	const SizeType maxFreeBuffers;
+
+	std::vector<SharedPointer<sf::Texture>> freeTextures;
+	std::vector<std::vector<Byte>> freeBuffers;
+
+	PoolStats stats;
+
+	mutable Mutex mutex;
+};
+
+TS_END_PACKAGE2()
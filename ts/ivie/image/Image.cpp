@@ -8,6 +8,13 @@
 #include "ts/ivie/viewer/ViewerManager.h"
 #include "ts/ivie/image/ImageBackgroundLoaderFreeImage.h"
 #include "ts/ivie/image/ImageBackgroundLoaderWebm.h"
+#include "ts/ivie/image/WebmFrameIndex.h"
+#include "ts/ivie/image/ImageSource.h"
+#include "ts/ivie/image/DeepZoomImage.h"
+#include "ts/ivie/image/ThumbnailCache.h"
+#include "ts/ivie/image/ThumbnailScaler.h"
+
+#include <set>
 
 // #include "ts/profiling/ZoneProfiler.h"
 
@@ -15,8 +22,15 @@ TS_PACKAGE2(app, image)
 
 using viewer::ViewerManager;
 
+// Videos at least this long are resumed from the nearest keyframe instead of restarting
+static const TimeSpan ResumeMinimumDuration = 10_s;
+
+// Longest side of thumbnails in pixels
+static const SizeType ThumbnailMaxSize = 300;
+
 Image::Image(const String &filepath)
 	: filepath(filepath)
+	, framePool(4, 2)
 {
 	TS_ASSERT(!filepath.isEmpty());
 }
@@ -24,11 +38,25 @@ Image::Image(const String &filepath)
 Image::~Image()
 {
 	backgroundLoader.reset();
+
+	thread::ThreadScheduler &scheduler = TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>();
+	for (const thread::SchedulerTaskId taskId : { probeTaskId, cachedThumbnailTaskId, thumbnailTaskId })
+	{
+		if (taskId == thread::InvalidTaskId)
+			continue;
+
+		scheduler.cancelTask(taskId, false);
+		scheduler.waitUntilTaskComplete(taskId);
+	}
 }
 
 bool Image::reload()
 {
 	unload();
+
+	// File may have changed
+	frameCache.clear();
+
 	return startLoading(false);
 }
 
@@ -48,24 +76,60 @@ bool Image::startLoading(bool suspendAfterBufferFull)
 
 	errorText = "Unknown error.";
 
-	LoaderType type = sniffLoaderType();
+	// Opened once here, sniffing, probing and the loader all read from it
+	SharedPointer<ImageSource> source = makeShared<ImageSource>(filepath);
+
+	LoaderType type = LoaderUnknown;
+	if (source->open())
+	{
+		sourceFileSize = source->getSize();
+		type = sniffLoaderType(*source);
+	}
+	else if (!file::exists(filepath))
+	{
+		type = LoaderErrorFileMissing;
+	}
+
+	// Placeholder from an earlier session while the image is still loading
+	if (!cachedThumbnailRequested && thumbnail == nullptr)
+	{
+		cachedThumbnailTaskId = TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>().scheduleDetached(
+			thread::Priority_High, TimeSpan::zero,
+			&ThisClass::loadCachedThumbnail, this
+		);
+	}
+	cachedThumbnailRequested = true;
+
 	switch (type)
 	{
 		case LoaderFreeImage:
 		{
 			displayShader = vm.loadDisplayShader(ViewerManager::DisplayShader_FreeImage);
 
+			const math::VC2U displaySize = vm.getDisplaySize();
+			const uint32_t displaySizeHint = fullResolutionRequested ? 0 : math::max(displaySize.x, displaySize.y);
+
 			loaderState = Loading;
-			backgroundLoader.reset(new ImageBackgroundLoaderFreeImage(this, filepath));
+			backgroundLoader.reset(new ImageBackgroundLoaderFreeImage(this, filepath, source, displaySizeHint));
 		}
 		break;
 
 		case LoaderWebm:
 		{
 			displayShader = vm.loadDisplayShader(ViewerManager::DisplayShader_Webm);
+			planarDisplayShader = vm.loadDisplayShader(ViewerManager::DisplayShader_WebmPlanar);
+
+			// Partial index is enough as long as it got past the frame to resume from
+			SharedPointer<WebmFrameIndex> frameIndex = getWebmFrameIndex();
+
+			SizeType startFrameIndex = 0;
+			if (shouldResumeVideo() && resumeFrameIndex < frameIndex->numFrames)
+				startFrameIndex = resumeFrameIndex;
+
+			currentFrameIndex = startFrameIndex;
 
 			loaderState = Loading;
-			backgroundLoader.reset(new ImageBackgroundLoaderWebm(this, filepath));
+			backgroundLoader.reset(new ImageBackgroundLoaderWebm(this, filepath, source, frameIndex, startFrameIndex));
 		}
 		break;
 
@@ -94,8 +158,18 @@ bool Image::startLoading(bool suspendAfterBufferFull)
 
 	currentLoaderType = type;
 
+	// Queued ahead of the loader so the size is known well before the first frame is decoded.
+	// Probed once, the destructor only has the one task to wait for.
+	if (!imageDataIsSet && probeTaskId == thread::InvalidTaskId)
+	{
+		probeTaskId = TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>().scheduleDetached(
+			thread::Priority_Critical, TimeSpan::zero,
+			&ThisClass::probeImageData, this, type, source
+		);
+	}
+
 	TS_ASSERT(backgroundLoader);
-	backgroundLoader->start(suspendAfterBufferFull);
+	backgroundLoader->start(suspendAfterBufferFull, loadingPriority);
 
 	return true;
 }
@@ -119,6 +193,12 @@ void Image::unload()
 	backgroundLoader.reset();
 
 	frameBuffer.clear();
+	framePool.clear();
+
+	placeholderFrame = FrameStorage();
+	fullResolutionRequested = false;
+
+	resumeFrameIndex = shouldResumeVideo() ? currentFrameIndex : 0;
 
 	errorText.clear();
 
@@ -136,12 +216,12 @@ void Image::restart(bool suspend)
 
 	TS_ASSERT(backgroundLoader);
 
-	if (currentFrameIndex > 0)
+	if (currentFrameIndex > 0 && !shouldResumeVideo())
 	{
 		if (backgroundLoader->restart(true))
 		{
 			currentFrameIndex = 0;
-			frameBuffer.clear();
+			recycleFrameBuffer();
 		}
 	}
 // 	else if (loaderState == Loading)
@@ -171,6 +251,17 @@ void Image::setActive(bool activeParam)
 	}
 }
 
+void Image::setLoadingPriority(thread::TaskPriority priority)
+{
+	MutexGuard lock(mutex);
+	if (loadingPriority == priority)
+		return;
+
+	loadingPriority = priority;
+	if (backgroundLoader)
+		backgroundLoader->setPriority(priority);
+}
+
 bool Image::isUnloaded() const
 {
 	return loaderState == Unloaded;
@@ -202,7 +293,9 @@ bool Image::getImageData(ImageData &outData) const
 	TS_ZONE();
 
 	MutexGuard lock(mutex);
-	if (imageDataIsSet == true)
+
+	// Probed data is only good for as long as the image might still load
+	if (imageDataIsSet == true && !(imageData.probed && loaderState == Error))
 	{
 		outData = imageData;
 		TS_ASSERT(outData.size.x > 0 && outData.size.y > 0);
@@ -225,7 +318,16 @@ FrameStorage *Image::getCurrentFrameStorage()
 
 	MutexGuard lock(mutex);
 	if (!frameBuffer.isEmpty())
+	{
+		if (placeholderFrame.texture != nullptr)
+			placeholderFrame = FrameStorage();
+
 		return &frameBuffer.getReadPtr();
+	}
+
+	if (placeholderFrame.texture != nullptr)
+		return &placeholderFrame;
+
 	return nullptr;
 }
 
@@ -249,7 +351,8 @@ sf::Shader *Image::getDisplayShader(const DisplayShaderParams *params)
 			{
 // 				shader->setUniform("u_viewSize", params->viewSize);
 
-				shader->setUniform("u_apparentSize", static_cast<math::VC2>(imageData.size) * params->scale);
+				const math::VC2U drawnSize = params->regionSize.x > 0 ? params->regionSize : imageData.size;
+				shader->setUniform("u_apparentSize", static_cast<math::VC2>(drawnSize) * params->scale);
 				shader->setUniform("u_apparentScale", params->scale);
 // 				shader->setUniform("u_positionOffset", params->offset);
 			}
@@ -257,7 +360,12 @@ sf::Shader *Image::getDisplayShader(const DisplayShaderParams *params)
 
 			case LoaderWebm:
 			{
-				// Set something?
+				if (params->frameFormat != FrameFormat_Texels && planarDisplayShader)
+				{
+					shader = planarDisplayShader->getResource().get();
+					shader->setUniform("u_frameSize", static_cast<math::VC2>(imageData.size));
+					shader->setUniform("u_hasAlpha", params->frameFormat == FrameFormat_PlanarYUVA420);
+				}
 			}
 			break;
 
@@ -340,7 +448,43 @@ bool Image::isDisplayable() const
 		return false;
 
 	MutexGuard lock(mutex);
-	return displayableThresholdReached && !frameBuffer.isEmpty() && displayShader != nullptr;
+	const bool hasFrame = (displayableThresholdReached && !frameBuffer.isEmpty()) || placeholderFrame.texture != nullptr;
+	return hasFrame && displayShader != nullptr;
+}
+
+void Image::updateDisplayScale(float scale)
+{
+	TS_ZONE();
+
+	if (loaderState != Complete)
+		return;
+
+	{
+		MutexGuard lock(mutex);
+
+		if (imageData.decodedSize.x == 0 || fullResolutionRequested || frameBuffer.isEmpty())
+			return;
+
+		// Zoomed past 100% of the reduced image
+		if (imageData.size.x * scale <= imageData.decodedSize.x && imageData.size.y * scale <= imageData.decodedSize.y)
+			return;
+	}
+
+	FrameStorage reducedFrame = *getCurrentFrameStorage();
+
+	unload();
+
+	{
+		MutexGuard lock(mutex);
+		fullResolutionRequested = true;
+		placeholderFrame = reducedFrame;
+	}
+
+	if (!startLoading(false))
+	{
+		MutexGuard lock(mutex);
+		placeholderFrame = FrameStorage();
+	}
 }
 
 bool Image::hasError() const
@@ -369,6 +513,12 @@ SharedPointer<sf::Texture> Image::getThumbnail() const
 	return thumbnail;
 }
 
+math::VC2U Image::getThumbnailImageSize() const
+{
+	MutexGuard lock(mutex);
+	return thumbnailImageSize;
+}
+
 bool Image::rotate(RotateDirection directionParam, bool saveToDisk)
 {
 	TS_PRINTF("Can be rotated? %s\n", imageData.canBeRotated ? "yes" : "no");
@@ -412,17 +562,41 @@ void Image::setImageData(const ImageData &dataParam)
 	displayableBufferThreshold = math::clamp(imageData.numFramesTotal, 1U, 2U);
 }
 
-Image::LoaderType Image::sniffLoaderType()
+void Image::probeImageData(LoaderType type, SharedPointer<ImageSource> source)
 {
-	if (!file::exists(filepath))
-		return LoaderErrorFileMissing;
+	TS_ZONE();
+
+	ImageData probedData;
+
+	bool success = false;
+	switch (type)
+	{
+		case LoaderFreeImage: success = ImageBackgroundLoaderFreeImage::probeImageData(*source, probedData); break;
+		case LoaderWebm:      success = ImageBackgroundLoaderWebm::probeImageData(*source, probedData); break;
+		default: break;
+	}
+
+	if (!success || probedData.size.x == 0 || probedData.size.y == 0)
+		return;
+
+	probedData.probed = true;
+
+	MutexGuard lock(mutex);
+	if (imageDataIsSet)
+		return;
+
+	imageData = probedData;
+	imageDataIsSet = true;
+}
 
+Image::LoaderType Image::sniffLoaderType(const ImageSource &source)
+{
 	// Test FreeImage formats
-	if (ImageBackgroundLoaderFreeImage::isValidFreeImageFile(filepath))
+	if (ImageBackgroundLoaderFreeImage::isValidFreeImageFile(source))
 		return LoaderFreeImage;
 
 	// Test Nestegg format (webm)
-	if (ImageBackgroundLoaderWebm::isValidWebmFile(filepath))
+	if (ImageBackgroundLoaderWebm::isValidWebmFile(source))
 		return LoaderWebm;
 
 	return LoaderUnknown;
@@ -444,17 +618,102 @@ const String &Image::getFilepath() const
 String Image::getStats() const
 {
 	MutexGuard lock(mutex);
-	String str = TS_WFMT("%s (%u / %u [%u buffered]) Image: %s Loader: %s",
+	const FramePool::PoolStats poolStats = framePool.getStats();
+	String str = TS_WFMT("%s (%u / %u [%u buffered]) Image: %s Loader: %s Pool: tex %u/%u buf %u/%u (hit/miss)",
 		file::getBasename(filepath),
 		currentFrameIndex + 1,
 		math::max(1U, imageData.numFramesTotal),
 		frameBuffer.getBufferedAmount(),
 		getStateString(loaderState),
-		backgroundLoader ? backgroundLoader->getStateString(backgroundLoader->getState()) : L"null"
+		backgroundLoader ? backgroundLoader->getStateString(backgroundLoader->getState()) : L"null",
+		poolStats.textureHits, poolStats.textureMisses,
+		poolStats.bufferHits, poolStats.bufferMisses
 	);
+
+	if (backgroundLoader != nullptr)
+	{
+		const String loaderStats = backgroundLoader->getStats();
+		if (!loaderStats.isEmpty())
+			str.append(TS_WFMT(" %s", loaderStats));
+	}
+
+	const FrameCache::CacheStats cacheStats = frameCache.getStats();
+	if (cacheStats.numFrames > 0 || cacheStats.abandoned)
+	{
+		str.append(TS_WFMT(" Frame cache: %u frames %.1f / %.1f MB (%u loaded)%s",
+			cacheStats.numFrames,
+			cacheStats.compressedBytes / (1024.0 * 1024.0),
+			cacheStats.uncompressedBytes / (1024.0 * 1024.0),
+			cacheStats.numFramesLoaded,
+			cacheStats.abandoned ? " over budget" : ""));
+	}
+
+	if (!frameBuffer.isEmpty() && frameBuffer.getReadPtr().deepZoom != nullptr)
+	{
+		const DeepZoomImage::CacheStats zoomStats = frameBuffer.getReadPtr().deepZoom->getStats();
+		str.append(TS_WFMT(" Deep zoom: tiles %u/%u (%u decoded) levels %u/%u %.1f MB (%u reloads)",
+			zoomStats.numCachedTiles, zoomStats.maxCachedTiles, zoomStats.numTilesDecoded,
+			zoomStats.numLevelsBuilt, frameBuffer.getReadPtr().deepZoom->getNumLevels(),
+			zoomStats.levelBytes / (1024.0 * 1024.0), zoomStats.numSourceReloads));
+	}
+
 	return str;
 }
 
+bool Image::getMemoryUsage(MemoryUsage &outUsage) const
+{
+	TS_ZONE();
+
+	// Unloading holds the lock until the loader has stopped, don't wait for it
+	MutexGuard lock(mutex, thread::TryToLock);
+	if (!lock.isLocked())
+		return false;
+
+	MemoryUsage usage;
+
+	// Placeholder and thumbnail may share textures with the frames, count each once
+	std::set<const void*> counted;
+	auto addTexture = [&usage, &counted](const sf::Texture *texture)
+	{
+		if (texture == nullptr || !counted.insert(texture).second)
+			return;
+
+		const sf::Vector2u size = texture->getSize();
+		usage.gpuBytes += (BigSizeType)size.x * size.y * 4;
+	};
+
+	auto addFrame = [&](const FrameStorage &frame)
+	{
+		addTexture(frame.texture.get());
+
+		if (frame.tiledTexture != nullptr && counted.insert(frame.tiledTexture.get()).second)
+		{
+			const math::VC2U size = frame.tiledTexture->getImageSize();
+			const SizeType numTiles = math::max(frame.tiledTexture->getNumTiles(), 1U);
+			usage.gpuBytes += (BigSizeType)size.x * size.y * 4 * frame.tiledTexture->getNumTilesUploaded() / numTiles;
+		}
+
+		if (frame.deepZoom != nullptr && counted.insert(frame.deepZoom.get()).second)
+		{
+			const DeepZoomImage::CacheStats zoomStats = frame.deepZoom->getStats();
+			usage.cpuBytes += zoomStats.levelBytes;
+			usage.gpuBytes += zoomStats.tileBytes;
+		}
+	};
+
+	// Slots past the buffered frames still hold on to their textures until reused
+	for (uint64_t index = 0; index < frameBuffer.getSize(); ++index)
+		addFrame(frameBuffer[index]);
+
+	addFrame(placeholderFrame);
+	addTexture(thumbnail.get());
+
+	usage.cpuBytes += frameCache.getStats().compressedBytes;
+
+	outUsage = usage;
+	return true;
+}
+
 void Image::setState(ImageLoaderState state)
 {
 	loaderState = state;
@@ -477,7 +736,13 @@ FrameStorage *Image::getNextBuffer()
 	if (loaderState == Unloading)
 		return nullptr;
 
-	return &frameBuffer.getWritePtr();
+	// Slot still holds a frame from the previous time around, its texture can be reused
+	FrameStorage &storage = frameBuffer.getWritePtr();
+	framePool.releaseTexture(std::move(storage.texture));
+	storage.tiledTexture.reset();
+	storage.deepZoom.reset();
+
+	return &storage;
 }
 
 void Image::swapBuffer()
@@ -495,19 +760,7 @@ void Image::swapBuffer()
 			displayableThresholdReached = true;
 	}
 
-	if (makingThumbnail == false)
-	{
-		const FrameStorage &storage = frameBuffer.getReadPtr();
-		TS_ASSERT(storage.texture != nullptr);
-
-		thread::ThreadScheduler &ts = TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>();
-		ts.scheduleOnce(
-			thread::Priority_Normal, TimeSpan::zero,
-			&ThisClass::makeThumbnail, this,
-			storage.texture, 300);
-
-		makingThumbnail = true;
-	}
+	scheduleThumbnail();
 }
 
 void Image::finalizeBuffer()
@@ -517,18 +770,89 @@ void Image::finalizeBuffer()
 
 // 	MutexGuard lock(mutex);
 	frameBuffer.removeReadConstraint();
+
+	// Tiled frames are published before all of the tiles are uploaded
+	scheduleThumbnail();
+}
+
+void Image::scheduleThumbnail()
+{
+	if (makingThumbnail == true)
+		return;
+
+	const FrameStorage &storage = frameBuffer.getReadPtr();
+	TS_ASSERT(storage.texture != nullptr || storage.tiledTexture != nullptr || storage.deepZoom != nullptr);
+
+	if (storage.tiledTexture != nullptr && !storage.tiledTexture->isComplete())
+		return;
+
+	thread::ThreadScheduler &ts = TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>();
+	thumbnailTaskId = ts.scheduleDetached(
+		thread::Priority_Normal, TimeSpan::zero,
+		&ThisClass::makeThumbnail, this,
+		storage, ThumbnailMaxSize);
+
+	makingThumbnail = true;
 }
 
-bool Image::makeThumbnail(SharedPointer<sf::Texture> frameTexture, SizeType maxSize)
+void Image::setWebmFrameIndex(SharedPointer<WebmFrameIndex> index)
+{
+	MutexGuard lock(webmFrameIndexMutex);
+	webmFrameIndex = index;
+}
+
+SharedPointer<WebmFrameIndex> Image::getWebmFrameIndex() const
+{
+	MutexGuard lock(webmFrameIndexMutex);
+	return webmFrameIndex;
+}
+
+bool Image::shouldResumeVideo() const
+{
+	// Without cues the loader could only get to the frame by decoding from the beginning
+	SharedPointer<WebmFrameIndex> index = getWebmFrameIndex();
+	return index != nullptr && index->isSeekable && index->duration >= ResumeMinimumDuration;
+}
+
+void Image::recycleFrameBuffer()
+{
+	for (uint64_t index = 0; index < frameBuffer.getSize(); ++index)
+	{
+		framePool.releaseTexture(std::move(frameBuffer[index].texture));
+		frameBuffer[index].tiledTexture.reset();
+		frameBuffer[index].deepZoom.reset();
+	}
+
+	frameBuffer.clear();
+}
+
+bool Image::makeThumbnail(FrameStorage frame, SizeType maxSize)
 {
 	TS_ZONE();
 	
 	TS_ASSERT(maxSize > 0);
-	TS_ASSERT(frameTexture != nullptr);
-	if (frameTexture == nullptr)
+
+	{
+		// Same file as the cached thumbnail, nothing to redo
+		MutexGuard lock(mutex);
+		if (thumbnailFromCache)
+			return true;
+	}
+
+	TS_ASSERT(frame.texture != nullptr || frame.tiledTexture != nullptr || frame.deepZoom != nullptr);
+	if (frame.texture == nullptr && frame.tiledTexture == nullptr && frame.deepZoom == nullptr)
 		return false;
 
-	math::VC2U textureSize = frameTexture->getSize();
+	// Planar frames are packed to a smaller texture, the shader needs coordinates in image pixels
+	math::VC2U textureSize;
+	if (frame.deepZoom != nullptr)
+		textureSize = frame.deepZoom->getImageSize();
+	else if (frame.tiledTexture != nullptr)
+		textureSize = frame.tiledTexture->getImageSize();
+	else if (frame.format != FrameFormat_Texels)
+		textureSize = getSize();
+	else
+		textureSize = frame.texture->getSize();
 	TS_ASSERT(textureSize.x != 0 && textureSize.y != 0);
 	if (textureSize.x == 0 || textureSize.y == 0)
 		return false;
@@ -556,17 +880,64 @@ bool Image::makeThumbnail(SharedPointer<sf::Texture> frameTexture, SizeType maxS
 		if (!rt.create(scaledSize.x, scaledSize.y))
 			return false;
 
-		sf::RenderStates states;
-		states.texture = frameTexture.get();
+		rt.clear(sf::Color::White);
 
-		DisplayShaderParams params = {};
-		params.scale = scaleFactor;
-		states.shader = getDisplayShader(&params);
+		if (frame.deepZoom != nullptr)
+		{
+			// Coarsest level fits in one tile and is plenty for a thumbnail
+			DeepZoomImage::DrawTile tile;
+			if (!frame.deepZoom->getCoarsestTile(tile))
+				return false;
+
+			sf::RenderStates states;
+			states.texture = tile.texture.get();
+			states.transform.scale(scaleFactor * tile.scale.x, scaleFactor * tile.scale.y);
+
+			DisplayShaderParams params = {};
+			params.scale = scaleFactor * tile.scale.x;
+			params.frameFormat = frame.format;
+			params.regionSize = tile.size;
+			states.shader = getDisplayShader(&params);
+
+			rt.draw(util::makeQuadVertexArray(tile.size.x, tile.size.y), states);
+		}
+		else if (frame.tiledTexture != nullptr)
+		{
+			std::vector<TiledTexture::Tile> tiles;
+			frame.tiledTexture->getUploadedTiles(tiles);
+
+			for (const TiledTexture::Tile &tile : tiles)
+			{
+				sf::RenderStates states;
+				states.texture = tile.texture.get();
+				states.transform.scale(scaleFactor, scaleFactor);
+
+				DisplayShaderParams params = {};
+				params.scale = scaleFactor;
+				params.frameFormat = frame.format;
+				params.regionSize = tile.size;
+				states.shader = getDisplayShader(&params);
+
+				rt.draw(
+					util::makeQuadVertexArrayScaled(tile.size.x, tile.size.y, tile.size.x, tile.size.y, tile.position.x, tile.position.y),
+					states);
+			}
+		}
+		else
+		{
+			sf::RenderStates states;
+			states.texture = frame.texture.get();
+
+			DisplayShaderParams params = {};
+			params.scale = scaleFactor;
+			params.frameFormat = frame.format;
+			states.shader = getDisplayShader(&params);
+
+			rt.draw(
+				util::makeQuadVertexArrayScaled(scaledSize.x, scaledSize.y, textureSize.x, textureSize.y),
+				states);
+		}
 
-		rt.clear(sf::Color::White);
-		rt.draw(
-			util::makeQuadVertexArrayScaled(scaledSize.x, scaledSize.y, textureSize.x, textureSize.y),
-			states);
 		rt.display();
 	}
 
@@ -584,9 +955,117 @@ bool Image::makeThumbnail(SharedPointer<sf::Texture> frameTexture, SizeType maxS
 
 		MutexGuard lock(mutex);
 		thumbnail.reset(thumbnailTexture);
+		thumbnailImageSize = imageData.size;
+	}
+
+	{
+		const sf::Image thumbnailImage = rt.getTexture().copyToImage();
+		storeCachedThumbnail(scaledSize, getSize(), thumbnailImage.getPixelsPtr());
 	}
 
 	return thumbnail != nullptr;
 }
 
+bool Image::makeThumbnailFromPixels(const Byte *pixels, SizeType pitch, const math::VC2U &size, const math::VC2U &imageSize)
+{
+	TS_ZONE();
+
+	TS_ASSERT(pixels != nullptr && size.x > 0 && size.y > 0);
+	if (pixels == nullptr || size.x == 0 || size.y == 0)
+		return false;
+
+	{
+		MutexGuard lock(mutex);
+		if (makingThumbnail || thumbnailFromCache)
+			return true;
+	}
+
+	const math::VC2U scaledSize = getThumbnailSize(size, ThumbnailMaxSize);
+
+	std::vector<Byte> scaled((size_t)scaledSize.x * scaledSize.y * 4);
+	scaleAreaAverage(pixels, pitch, size, true, &scaled[0], scaledSize,
+		getPixelKernels(), &TS_GET_GIGATON().getGigaton<thread::ThreadScheduler>());
+
+	// BGRA to RGBA, transparent areas on white like the rendered thumbnails
+	for (size_t i = 0; i < scaled.size(); i += 4)
+	{
+		const uint32_t alpha = scaled[i + 3];
+		const uint32_t background = 255 * (255 - alpha) + 127;
+		const Byte blue = scaled[i + 0];
+		scaled[i + 0] = (Byte)((scaled[i + 2] * alpha + background) / 255);
+		scaled[i + 1] = (Byte)((scaled[i + 1] * alpha + background) / 255);
+		scaled[i + 2] = (Byte)((blue * alpha + background) / 255);
+		scaled[i + 3] = 255;
+	}
+
+	SharedPointer<sf::Texture> texture = makeShared<sf::Texture>();
+	if (texture == nullptr || !texture->create(scaledSize.x, scaledSize.y))
+		return false;
+
+	texture->update(&scaled[0], scaledSize.x, scaledSize.y, 0, 0);
+	texture->setSmooth(true);
+
+	{
+		MutexGuard lock(mutex);
+		thumbnail = texture;
+		thumbnailImageSize = imageSize;
+		makingThumbnail = true;
+	}
+
+	storeCachedThumbnail(scaledSize, imageSize, &scaled[0]);
+
+	return true;
+}
+
+void Image::storeCachedThumbnail(const math::VC2U &size, const math::VC2U &imageSize, const Byte *pixels)
+{
+	if (pixels == nullptr)
+		return;
+
+	ThumbnailCache *thumbnailCache = TS_GET_GIGATON().getGigaton<ViewerManager>().getThumbnailCache();
+	ThumbnailCache::Key key;
+	if (thumbnailCache == nullptr || !ThumbnailCache::makeKey(filepath, sourceFileSize, key))
+		return;
+
+	TS_ZONE_NAMED("Store cached thumbnail");
+
+	ThumbnailCache::Thumbnail cached;
+	cached.size = size;
+	cached.imageSize = imageSize;
+	cached.pixels.assign(pixels, pixels + (size_t)size.x * size.y * 4);
+	thumbnailCache->store(key, cached);
+}
+
+void Image::loadCachedThumbnail()
+{
+	TS_ZONE();
+
+	ThumbnailCache *thumbnailCache = TS_GET_GIGATON().getGigaton<ViewerManager>().getThumbnailCache();
+	if (thumbnailCache == nullptr)
+		return;
+
+	ThumbnailCache::Key key;
+	if (!ThumbnailCache::makeKey(filepath, sourceFileSize, key))
+		return;
+
+	ThumbnailCache::Thumbnail cached;
+	if (!thumbnailCache->load(key, cached))
+		return;
+
+	SharedPointer<sf::Texture> texture = makeShared<sf::Texture>();
+	if (texture == nullptr || !texture->create(cached.size.x, cached.size.y))
+		return;
+
+	texture->update(&cached.pixels[0], cached.size.x, cached.size.y, 0, 0);
+	texture->setSmooth(true);
+
+	MutexGuard lock(mutex);
+	if (thumbnail == nullptr)
+	{
+		thumbnail = texture;
+		thumbnailImageSize = cached.imageSize;
+		thumbnailFromCache = true;
+	}
+}
+
 TS_END_PACKAGE2()
@@ -1,23 +1,49 @@
 #pragma once
 
 #include "ts/container/RingBuffer.h"
+#include "ts/thread/ThreadScheduler.h"
+#include "ts/ivie/image/FramePool.h"
+#include "ts/ivie/image/TiledTexture.h"
+#include "ts/ivie/image/FrameCache.h"
 
 TS_DECLARE2(app, image, AbstractImageBackgroundLoader);
+TS_DECLARE2(app, image, WebmFrameIndex);
+TS_DECLARE2(app, image, DeepZoomImage);
+TS_DECLARE2(app, image, ImageSource);
 
 TS_PACKAGE2(app, image)
 
+enum FrameFormat : int32_t
+{
+	// One texel per pixel
+	FrameFormat_Texels,
+	// 8-bit 4:2:0 planes packed four samples per texel, requires the planar display shader
+	FrameFormat_PlanarYUV420,
+	// Same as above with a full resolution alpha plane
+	FrameFormat_PlanarYUVA420,
+};
+
 struct FrameStorage
 {
 	SharedPointer<sf::Texture> texture;
+	// Set instead of the texture for images larger than the maximum texture size
+	SharedPointer<TiledTexture> tiledTexture;
+	// Set instead of the texture for huge images, tiles are uploaded as the view needs them
+	SharedPointer<DeepZoomImage> deepZoom;
 	TimeSpan frameTime;
+	FrameFormat format = FrameFormat_Texels;
 };
 
 struct ImageData
 {
 	math::VC2U size;
+	// Size of the decoded frames when decoded at reduced resolution, zero otherwise
+	math::VC2U decodedSize;
 	bool hasAlpha = false;
 	uint32_t numFramesTotal = 0;
 	bool canBeRotated = false;
+	// Read from the file header before decoding, replaced by the loader with the full data
+	bool probed = false;
 };
 
 struct DisplayShaderParams
@@ -25,6 +51,9 @@ struct DisplayShaderParams
 	math::VC2 viewSize;
 	float scale;
 	math::VC2 offset;
+	FrameFormat frameFormat;
+	// Size of the drawn texture in image pixels when drawing tiles, zero for the whole image
+	math::VC2U regionSize;
 };
 
 class Image
@@ -49,6 +78,9 @@ public:
 
 	void setActive(bool active);
 
+	// Scheduler priority of the loader, set by distance from the current image. Already queued loader tasks are moved.
+	void setLoadingPriority(thread::TaskPriority priority);
+
 	bool isUnloaded() const;
 	bool isUnloading() const;
 	bool isSuspended() const;
@@ -72,11 +104,20 @@ public:
 
 	bool isDisplayable() const;
 
+	/* Called with the current display scale. Images decoded at reduced resolution are reloaded
+	 * at full resolution once shown larger than the reduced decode, the reduced frame stays
+	 * on display until the full resolution frame is ready.
+	 */
+	void updateDisplayScale(float scale);
+
 	bool hasError() const;
 	const String &getErrorText() const;
 
 	bool hasThumbnail() const;
 	SharedPointer<sf::Texture> getThumbnail() const;
+	// Size of the image the thumbnail was made from. Thumbnails read from the thumbnail cache
+	// are available before the image data, this is the only size known at that point.
+	math::VC2U getThumbnailImageSize() const;
 
 	enum RotateDirection
 	{
@@ -116,16 +157,52 @@ public:
 
 	String getStats() const;
 
+	struct MemoryUsage
+	{
+		// Frame cache and pixels of huge images kept in memory
+		BigSizeType cpuBytes = 0;
+		// Buffered frames, tiles and the thumbnail
+		BigSizeType gpuBytes = 0;
+	};
+	/* Bytes held by the image, including what is kept over unloading.
+	 * Returns: false if the image is busy (e.g. being unloaded), outUsage is left untouched.
+	 */
+	bool getMemoryUsage(MemoryUsage &outUsage) const;
+
 private:
 	bool getIsBufferFull() const;
 	FrameStorage *getNextBuffer();
 	void swapBuffer();
 	void finalizeBuffer();
 
-	bool makeThumbnail(SharedPointer<sf::Texture> frameTexture, SizeType maxSize);
+	// Returns textures of all buffered frames to the frame pool and clears the frame buffer.
+	void recycleFrameBuffer();
+
+	// Schedules thumbnail creation from the current frame if it's fully uploaded
+	void scheduleThumbnail();
+	bool makeThumbnail(FrameStorage frame, SizeType maxSize);
+	/* Makes the thumbnail on the CPU from decoded pixels, called by the loader while it still has them.
+	 * Frames scheduleThumbnail would have rendered are skipped afterwards.
+	 * pixels: BGRA, bottom row first (FreeImage order).
+	 * imageSize: size of the image, larger than size for reduced decodes.
+	 */
+	bool makeThumbnailFromPixels(const Byte *pixels, SizeType pitch, const math::VC2U &size, const math::VC2U &imageSize);
+	// pixels: RGBA, top row first
+	void storeCachedThumbnail(const math::VC2U &size, const math::VC2U &imageSize, const Byte *pixels);
+	// Reads the thumbnail from the thumbnail cache, requested once on the first load
+	void loadCachedThumbnail();
+	// Size of the file as it was opened for loading, keys the thumbnail cache without opening it again
+	std::atomic<PosType> sourceFileSize = -1;
+
+	// Set by the WebM loader once it has gone through the whole stream or when it is unloaded before that
+	void setWebmFrameIndex(SharedPointer<WebmFrameIndex> index);
+	SharedPointer<WebmFrameIndex> getWebmFrameIndex() const;
+	// Long videos with cues continue from where they were instead of starting over
+	bool shouldResumeVideo() const;
 
 	String filepath;
 	bool active = false;
+	thread::TaskPriority loadingPriority = thread::Priority_Normal;
 
 	void setImageData(const ImageData &imageData);
 	ImageData imageData;
@@ -139,9 +216,15 @@ private:
 
 		LoaderErrorFileMissing,
 	};
-	LoaderType sniffLoaderType();
+	LoaderType sniffLoaderType(const ImageSource &source);
 	LoaderType currentLoaderType = LoaderUnknown;
 
+	/* Reads the image data from the file header without decoding, so the layout is known
+	 * before the first frame is. Scheduled when loading starts, ignored if the loader got there first.
+	 */
+	void probeImageData(LoaderType type, SharedPointer<ImageSource> source);
+	thread::SchedulerTaskId probeTaskId = thread::InvalidTaskId;
+
 	void setState(ImageLoaderState state);
 	std::atomic<ImageLoaderState> loaderState = Unloaded;
 
@@ -157,9 +240,32 @@ private:
 	typedef util::RingBuffer<FrameStorage, MaxFrameBufferCapacity> FrameRingBuffer;
 	FrameRingBuffer frameBuffer;
 
+	// Textures and staging buffers recycled between frames of animated images
+	FramePool framePool;
+
+	// Kept over unloading so animations play from it instead of decoding once cached
+	FrameCache frameCache;
+
+	// Kept over unloading so videos can be restarted and resumed by seeking
+	SharedPointer<WebmFrameIndex> webmFrameIndex;
+	// Not the image mutex, the loader hands the index over while unload holds that waiting for it
+	mutable Mutex webmFrameIndexMutex;
+	SizeType resumeFrameIndex = 0;
+
+	// Full resolution reload of a reduced decode, reset when unloaded
+	bool fullResolutionRequested = false;
+	FrameStorage placeholderFrame;
+
 	bool makingThumbnail = false;
+	bool cachedThumbnailRequested = false;
+	bool thumbnailFromCache = false;
 	SharedPointer<sf::Texture> thumbnail;
+	math::VC2U thumbnailImageSize;
+	// Thumbnail tasks refer to the image, waited on when destroyed
+	thread::SchedulerTaskId thumbnailTaskId = thread::InvalidTaskId;
+	thread::SchedulerTaskId cachedThumbnailTaskId = thread::InvalidTaskId;
 	SharedPointer<resource::ShaderResource> displayShader;
+	SharedPointer<resource::ShaderResource> planarDisplayShader;
 
 	ScopedPointer<AbstractImageBackgroundLoader> backgroundLoader;
 	
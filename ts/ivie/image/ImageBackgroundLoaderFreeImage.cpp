@@ -1,11 +1,11 @@
 #include "Precompiled.h"
 #include "ImageBackgroundLoaderFreeImage.h"
 
-#include "ts/thread/Thread.h"
 #include "ts/file/FileUtils.h"
 #include "ts/profiling/ZoneProfiler.h"
 #include "ts/ivie/image/Image.h"
-#include "ts/ivie/util/RenderUtil.h"
+#include "ts/ivie/image/DeepZoomImage.h"
+#include "ts/ivie/image/PixelKernels.h"
 
 #include <set>
 
@@ -53,8 +53,36 @@ static const std::map<FREE_IMAGE_FORMAT, bool> FormatAlphaSupport
 	{ FIF_XPM, true, },
 };
 
-ImageBackgroundLoaderFreeImage::ImageBackgroundLoaderFreeImage(Image *ownerImage, const String &filepath)
+// FreeImage takes the requested JPEG size in the upper 16 bits of the load flags
+static const uint32_t MaxJpegSizeHint = 0x7FFF;
+
+/* Converts the bitmap to the 24 or 32-bit FIT_BITMAP deep zoom images are made of.
+ * Takes ownership of the bitmap. Returns: the converted bitmap, null on failure.
+ */
+static FIBITMAP *convertForDeepZoom(FIBITMAP *bitmap, bool hasAlpha)
+{
+	const uint32_t bitdepth = FreeImage_GetBPP(bitmap);
+	if (FreeImage_GetImageType(bitmap) == FIT_BITMAP && (bitdepth == 24 || bitdepth == 32))
+		return bitmap;
+
+	// Alpha is the only reason to spend the extra byte per pixel on an image this big
+	FIBITMAP *converted = hasAlpha
+		? FreeImage_ConvertTo32Bits(bitmap)
+		: FreeImage_ConvertTo24Bits(bitmap);
+
+	FreeImage_Unload(bitmap);
+
+	if (converted == nullptr)
+		TS_LOG_ERROR("Converting bitmap for deep zoom failed.");
+
+	return converted;
+}
+
+ImageBackgroundLoaderFreeImage::ImageBackgroundLoaderFreeImage(Image *ownerImage, const String &filepath,
+		SharedPointer<ImageSource> source, uint32_t displaySizeHint)
 	: AbstractImageBackgroundLoader(ownerImage, filepath)
+	, initialSource(source)
+	, displaySizeHint(math::min(displaySizeHint, MaxJpegSizeHint))
 {
 	TS_ZONE();
 }
@@ -64,8 +92,6 @@ ImageBackgroundLoaderFreeImage::~ImageBackgroundLoaderFreeImage()
 // 	TS_WPRINTF("~ImageBackgroundLoaderFreeImage()  : Task ID %u [%s]\n", taskId, filepath);
 
 	TS_ASSERTF(loaderIsPrepared == false, "Cleanup is incomplete. Task ID %u", taskId);
-	TS_ASSERT(stackingRenderTextureThreadId == -1 && "It should've been already freed.");
-	TS_ASSERT(stackingRenderTexture == nullptr && "Render texture must be freed by the thread that created it.");
 }
 
 bool ImageBackgroundLoaderFreeImage::initialize()
@@ -81,31 +107,40 @@ void ImageBackgroundLoaderFreeImage::deinitialize()
 
 void ImageBackgroundLoaderFreeImage::onResume()
 {
-	if (stackingRenderTexture == nullptr && savedRenderTexture != nullptr)
-	{
-		stackingRenderTexture = makeUnique<sf::RenderTexture>();
-		stackingRenderTexture->create(imageSize.x, imageSize.y);
-		stackingRenderTexture->draw(imageVertexArray, savedRenderTexture.get());
-		savedRenderTexture.reset();
-
-		stackingRenderTextureThreadId = (int32_t)Thread::getCurrentThread().getThreadId();
-	}
+	
 }
 
 void ImageBackgroundLoaderFreeImage::onSuspend()
 {
-	if (stackingRenderTexture != nullptr)
+	// Compositing holds no GL resources tied to the thread, nothing to save
+}
+
+bool ImageBackgroundLoaderFreeImage::readFromSource(ImageSource &source)
+{
+	TS_ZONE();
+
+	file::InputFile fileHandle = source.takeFile();
+	if (!fileHandle.isOpen())
 	{
-		int32_t threadId = (int32_t)Thread::getCurrentThread().getThreadId();
-		TS_ASSERTF(stackingRenderTextureThreadId == threadId,
-			"Thread ID mismatch. Got: %d  Expected: %d", threadId, stackingRenderTextureThreadId);
+		errorText = "Failed to open file. File doesn't exist?";
+		return false;
+	}
+
+	// Start of the file was read for sniffing, only the rest is read here
+	const SizeType sniffSize = source.getSniffSize();
+	const PosType remaining = source.getSize() - sniffSize;
 
-		// Store render texture before suspension since its GL context requires that the 
-		// creation and deletion happen in the same thread. Gotta deinit before suspending.
-		savedRenderTexture = makeShared<sf::Texture>(stackingRenderTexture->getTexture());
-		stackingRenderTexture.reset();
-		stackingRenderTextureThreadId = -1;
+	state.memoryBuffer.resize((size_t)source.getSize());
+	memcpy(&state.memoryBuffer[0], source.getSniffData(), sniffSize);
+
+	if (remaining > 0 && fileHandle.read(&state.memoryBuffer[sniffSize], (uint32_t)remaining) != remaining)
+	{
+		TS_WLOG_ERROR("Failed to read file. File: %s\n", filepath);
+		errorText = "Failed to read file.";
+		return false;
 	}
+
+	return true;
 }
 
 bool ImageBackgroundLoaderFreeImage::prepareForLoading()
@@ -114,22 +149,60 @@ bool ImageBackgroundLoaderFreeImage::prepareForLoading()
 
 	TS_ASSERT(loaderIsPrepared == false && "Loader is already prepared.");
 
-	file::InputFile fileHandle;
-	if (!fileHandle.open(filepath, file::InputFileMode_ReadBinary))
+	BYTE *data = nullptr;
+	PosType filesize = -1;
+
+	// File opened for sniffing is read from its mapping or taken over with the bytes already read
+	SharedPointer<ImageSource> source = std::move(initialSource);
+	if (source != nullptr && source->getMappedData() != nullptr)
+	{
+		// FreeImage memory streams opened for reading never write to the buffer.
+		data = const_cast<BYTE*>(source->getMappedData());
+		filesize = source->getSize();
+		state.source = source;
+	}
+	else if (source != nullptr && !readFromSource(*source))
 	{
-		TS_WLOG_ERROR("Failed to open file. File: %s\n", filepath);
-		errorText = "Failed to open file. File doesn't exist?";
 		return false;
 	}
+	else if (source != nullptr)
+	{
+		data = &state.memoryBuffer[0];
+		filesize = (PosType)state.memoryBuffer.size();
+	}
+	// Map the file directly for FreeImage to read from, avoids copying the whole file.
+	else if (state.mappedFile.open(filepath, file::MappedFileAccess_Sequential))
+	{
+		data = const_cast<BYTE*>(state.mappedFile.getData());
+		filesize = state.mappedFile.getSize();
+	}
+	else
+	{
+		// Mapping isn't possible on all filesystems, fall back to reading the file to a buffer.
+		file::InputFile fileHandle;
+		if (!fileHandle.open(filepath, file::InputFileMode_ReadBinary))
+		{
+			TS_WLOG_ERROR("Failed to open file. File: %s\n", filepath);
+			errorText = "Failed to open file. File doesn't exist?";
+			return false;
+		}
 
-	PosType filesize = fileHandle.getSize();
-	TS_ASSERT(filesize > 0);
+		filesize = fileHandle.getSize();
+		TS_ASSERT(filesize > 0);
+		if (filesize <= 0)
+		{
+			errorText = "File is empty.";
+			return false;
+		}
 
-	state.memoryBuffer.resize(filesize);
-	fileHandle.read(&state.memoryBuffer[0], (SizeType)filesize);
-	fileHandle.close();
+		state.memoryBuffer.resize(filesize);
+		fileHandle.read(&state.memoryBuffer[0], (SizeType)filesize);
+		fileHandle.close();
+
+		data = &state.memoryBuffer[0];
+	}
 
-	state.memory = FreeImage_OpenMemory(&state.memoryBuffer[0], (DWORD)filesize);
+	state.memory = FreeImage_OpenMemory(data, (DWORD)filesize);
 	if (state.memory == nullptr)
 	{
 		TS_WLOG_ERROR("FreeImage_OpenMemory failed. File: %s\n", filepath);
@@ -141,7 +214,8 @@ bool ImageBackgroundLoaderFreeImage::prepareForLoading()
 
 	imageData.canBeRotated = isValidRotateFormat(state.format);
 
-	int32_t flags = 0;
+	int32_t &flags = state.loadFlags;
+	flags = 0;
 
 	switch (state.format)
 	{
@@ -183,6 +257,10 @@ bool ImageBackgroundLoaderFreeImage::prepareForLoading()
 				case FIF_JPEG:
 				{
 					flags |= JPEG_EXIFROTATE | JPEG_ACCURATE;
+
+					// Decoded in DCT domain at a reduced scale, much faster for fit to screen viewing
+					if (displaySizeHint > 0)
+						flags |= (int32_t)(displaySizeHint << 16);
 				}
 				break;
 				
@@ -205,6 +283,30 @@ bool ImageBackgroundLoaderFreeImage::prepareForLoading()
 	return true;
 }
 
+math::VC2U ImageBackgroundLoaderFreeImage::getOriginalJpegSize(const math::VC2U &decodedSize) const
+{
+	if (state.format != FIF_JPEG || displaySizeHint == 0)
+		return decodedSize;
+
+	math::VC2U originalSize;
+
+	FITAG *tag = nullptr;
+	if (FreeImage_GetMetadata(FIMD_COMMENTS, state.bitmap, "OriginalJPEGWidth", &tag))
+		originalSize.x = (uint32_t)atoi((const char*)FreeImage_GetTagValue(tag));
+
+	if (FreeImage_GetMetadata(FIMD_COMMENTS, state.bitmap, "OriginalJPEGHeight", &tag))
+		originalSize.y = (uint32_t)atoi((const char*)FreeImage_GetTagValue(tag));
+
+	if (originalSize.x <= decodedSize.x || originalSize.y == 0)
+		return decodedSize;
+
+	// Original size is from the JPEG header, before EXIF rotation was applied
+	if ((originalSize.x > originalSize.y) != (decodedSize.x > decodedSize.y))
+		std::swap(originalSize.x, originalSize.y);
+
+	return originalSize;
+}
+
 void ImageBackgroundLoaderFreeImage::cleanup(bool soft)
 {
 // 	TS_WPRINTF("ImageBackgroundLoaderFreeImage::cleanup()  : Task ID %u [%s]\n", taskId, filepath);
@@ -242,19 +344,19 @@ void ImageBackgroundLoaderFreeImage::cleanup(bool soft)
 		state.memory = nullptr;
 	}
 	state.memoryBuffer.clear();
+	state.mappedFile.close();
+	state.source.reset();
 
-	previousFrame.reset();
+	uploadBuffer.clear();
+	uploadBuffer.shrink_to_fit();
 
-	if (stackingRenderTexture)
-	{
-		int32_t threadId = (int32_t)Thread::getCurrentThread().getThreadId();
-		TS_ASSERTF(stackingRenderTextureThreadId == threadId,
-			"Thread ID mismatch. Got: %d  Expected: %d", threadId, stackingRenderTextureThreadId);
+	tiledTexture.reset();
+	tilePixels = nullptr;
 
-		stackingRenderTexture.reset();
-		savedRenderTexture.reset();
-		stackingRenderTextureThreadId = -1;
-	}
+	compositor.releaseMemory();
+	canvasTexture.reset();
+	dirtyPixels.clear();
+	dirtyPixels.shrink_to_fit();
 
 	if (soft == false)
 	{
@@ -265,41 +367,36 @@ void ImageBackgroundLoaderFreeImage::cleanup(bool soft)
 // 	TS_PRINTF("Cleanup complete.\n");
 }
 
-bool ImageBackgroundLoaderFreeImage::processNextStill(FrameStorage &bufferStorage)
+const BYTE *ImageBackgroundLoaderFreeImage::convertStillForUpload(FREE_IMAGE_COLOR_TYPE colorType, bool hasAlpha)
 {
-	TS_ASSERT(state.bitmap != nullptr);
+	TS_ZONE();
 
-	imageSize.x = FreeImage_GetWidth(state.bitmap);
-	imageSize.y = FreeImage_GetHeight(state.bitmap);
+	const PixelKernels &kernels = getPixelKernels();
 
-// 	FIICCPROFILE *icc = FreeImage_GetICCProfile(state.bitmap);
-// 	if (icc->size > 0)
-// 	{
-// 		TS_WPRINTF("%s has some profile? %u bytes\n", filepath, icc->size);
-// 	}
-// 	else
-// 	{
-// 		TS_WPRINTF("%s does not have profile?\n", filepath);
-// 	}
+	const SizeType width = imageSize.x;
+	const SizeType height = imageSize.y;
 
-	uint32_t maxSize = sf::Texture::getMaximumSize();
-	if (imageSize.x > maxSize || imageSize.y > maxSize)
-	{
-		TS_LOG_ERROR("Image is too large.");
-		errorText = "Image is too large.";
-		return false;
-	}
+	uint32_t bitdepth = FreeImage_GetBPP(state.bitmap);
 
-	FREE_IMAGE_COLOR_TYPE originalColorType = FreeImage_GetColorType(state.bitmap);
+	// Common formats are converted straight to the upload buffer in one pass,
+	// anything more exotic goes through FreeImage conversion first.
+	const bool hasDirectConversion = FreeImage_GetImageType(state.bitmap) == FIT_BITMAP &&
+		(bitdepth == 32 || bitdepth == 24 || bitdepth == 8);
 
-	uint32_t bitdepth = FreeImage_GetBPP(state.bitmap);
-	if (bitdepth != 32)
+	if (!hasDirectConversion)
 	{
 		FIBITMAP *temp = FreeImage_ConvertTo32Bits(state.bitmap);
+		if (temp == nullptr)
+		{
+			TS_LOG_ERROR("FreeImage_ConvertTo32Bits failed.");
+			errorText = "Image conversion failed.";
+			return nullptr;
+		}
 
 		// Unload previous image and replace it with the new one
 		FreeImage_Unload(state.bitmap);
 		state.bitmap = temp;
+		bitdepth = 32;
 	}
 
 	BYTE *bits = FreeImage_GetBits(state.bitmap);
@@ -307,10 +404,81 @@ bool ImageBackgroundLoaderFreeImage::processNextStill(FrameStorage &bufferStorag
 	{
 		TS_LOG_ERROR("FreeImage_GetBits returned null.");
 		errorText = "FreeImage_GetBits failed.";
-		return false;
+		return nullptr;
+	}
+
+	// 32-bit scanlines have no padding so the bitmap can be uploaded as it is,
+	// only the alpha needs to be made opaque in-place for images without alpha.
+	if (bitdepth == 32)
+	{
+		if (!hasAlpha)
+			kernels.copyBGRAOpaque(bits, bits, width * height);
+
+		return bits;
 	}
 
-	imageData.size = imageSize;
+	// Rows are kept in FreeImage order (bottom-up), same as uploading the bits directly.
+	const SizeType uploadPitch = width * 4;
+	uploadBuffer.resize((size_t)uploadPitch * height);
+
+	if (bitdepth == 24)
+	{
+		for (SizeType y = 0; y < height; ++y)
+			kernels.expandBGRToBGRA(FreeImage_GetScanLine(state.bitmap, y), &uploadBuffer[(size_t)y * uploadPitch], width);
+	}
+	else if (colorType == FIC_MINISBLACK && !hasAlpha && FreeImage_GetColorsUsed(state.bitmap) == 256)
+	{
+		// Linear greyscale palette, index is the luminance
+		for (SizeType y = 0; y < height; ++y)
+			kernels.expandGreyToBGRA(FreeImage_GetScanLine(state.bitmap, y), &uploadBuffer[(size_t)y * uploadPitch], width);
+	}
+	else
+	{
+		const RGBQUAD *palette = FreeImage_GetPalette(state.bitmap);
+		const SizeType numColors = std::min(FreeImage_GetColorsUsed(state.bitmap), 256U);
+
+		const BYTE *transparency = hasAlpha ? FreeImage_GetTransparencyTable(state.bitmap) : nullptr;
+		const SizeType numTransparent = transparency != nullptr ? FreeImage_GetTransparencyCount(state.bitmap) : 0;
+
+		// Indices outside of the palette end up opaque black
+		uint32_t lookup[256];
+		for (SizeType i = 0; i < 256; ++i)
+		{
+			BYTE *entry = reinterpret_cast<BYTE*>(&lookup[i]);
+			entry[FI_RGBA_RED]   = (palette != nullptr && i < numColors) ? palette[i].rgbRed : 0;
+			entry[FI_RGBA_GREEN] = (palette != nullptr && i < numColors) ? palette[i].rgbGreen : 0;
+			entry[FI_RGBA_BLUE]  = (palette != nullptr && i < numColors) ? palette[i].rgbBlue : 0;
+			entry[FI_RGBA_ALPHA] = i < numTransparent ? transparency[i] : 255U;
+		}
+
+		for (SizeType y = 0; y < height; ++y)
+			kernels.expandIndexedToBGRA(FreeImage_GetScanLine(state.bitmap, y), lookup, &uploadBuffer[(size_t)y * uploadPitch], width);
+	}
+
+	return &uploadBuffer[0];
+}
+
+bool ImageBackgroundLoaderFreeImage::processNextStill(FrameStorage &bufferStorage)
+{
+	TS_ASSERT(state.bitmap != nullptr);
+
+	imageSize.x = FreeImage_GetWidth(state.bitmap);
+	imageSize.y = FreeImage_GetHeight(state.bitmap);
+
+// 	FIICCPROFILE *icc = FreeImage_GetICCProfile(state.bitmap);
+// 	if (icc->size > 0)
+// 	{
+// 		TS_WPRINTF("%s has some profile? %u bytes\n", filepath, icc->size);
+// 	}
+// 	else
+// 	{
+// 		TS_WPRINTF("%s does not have profile?\n", filepath);
+// 	}
+
+	FREE_IMAGE_COLOR_TYPE originalColorType = FreeImage_GetColorType(state.bitmap);
+
+	imageData.size = getOriginalJpegSize(imageSize);
+	imageData.decodedSize = (imageData.size.x != imageSize.x) ? imageSize : math::VC2U();
 	
 	if (originalColorType != FIC_RGBALPHA)
 	{
@@ -327,26 +495,35 @@ bool ImageBackgroundLoaderFreeImage::processNextStill(FrameStorage &bufferStorag
 
 	imageData.numFramesTotal = 1;
 
+	if (DeepZoomImage::shouldUseDeepZoom(imageSize))
+		return processDeepZoomStill(bufferStorage);
+
+	const BYTE *pixels = convertStillForUpload(originalColorType, imageData.hasAlpha);
+	if (pixels == nullptr)
+		return false;
+
+	// Made here while the pixels are at hand instead of rendering the uploaded texture later
+	ownerImage->makeThumbnailFromPixels(pixels, imageSize.x * 4, imageSize, imageData.size);
+
+	if (TiledTexture::needsTiling(imageSize))
+	{
+		tiledTexture = makeShared<TiledTexture>(imageSize, TiledTexture::getDefaultTileSize());
+		tilePixels = pixels;
+
+		// FreeImage only decodes whole bitmaps and has no per-row callback, so tiles can't be
+		// uploaded while decoding. Frame is published with the first tile, the rest follow
+		// in continuePartialFrame, nearest to the center first
+		bufferStorage.tiledTexture = tiledTexture;
+		return continuePartialFrame();
+	}
+
 	bool success = false;
 
 	bufferStorage.texture = makeShared<sf::Texture>();
 
 	if (bufferStorage.texture != nullptr && bufferStorage.texture->create(imageSize.x, imageSize.y))
 	{
-		if (!imageData.hasAlpha)
-		{
-			BYTE *pixel = bits;
-			for (SizeType y = 0; y < imageSize.y; ++y)
-			{
-				for (SizeType x = 0; x < imageSize.x; ++x)
-				{
-					pixel[FI_RGBA_ALPHA] = 255U;
-					pixel += 4;
-				}
-			}
-		}
-
-		bufferStorage.texture->update(bits, imageSize.x, imageSize.y, 0, 0, sf::Texture::BGRA);
+		bufferStorage.texture->update(pixels, imageSize.x, imageSize.y, 0, 0, sf::Texture::BGRA);
 
 		bufferStorage.texture->generateMipmap();
 
@@ -362,10 +539,66 @@ bool ImageBackgroundLoaderFreeImage::processNextStill(FrameStorage &bufferStorag
 	return success;
 }
 
+bool ImageBackgroundLoaderFreeImage::processDeepZoomStill(FrameStorage &bufferStorage)
+{
+	TS_ZONE();
+
+	state.bitmap = convertForDeepZoom(state.bitmap, imageData.hasAlpha);
+	if (state.bitmap == nullptr)
+	{
+		errorText = "Image conversion failed.";
+		return false;
+	}
+
+	// Full resolution is decoded again from the file when the view zooms back in after it was released.
+	// Same flags give the same size, the loader itself may be gone by then.
+	const String path = filepath;
+	const FREE_IMAGE_FORMAT format = state.format;
+	const int32_t flags = state.loadFlags;
+	const bool hasAlpha = imageData.hasAlpha;
+
+	DeepZoomImage::SourceLoader sourceLoader = [path, format, flags, hasAlpha]() -> FIBITMAP*
+	{
+#if TS_PLATFORM == TS_WINDOWS
+		FIBITMAP *bitmap = FreeImage_LoadU(format, path.toWideString().c_str(), flags);
+#else
+		FIBITMAP *bitmap = FreeImage_Load(format, path.toUtf8().c_str(), flags);
+#endif
+		return bitmap != nullptr ? convertForDeepZoom(bitmap, hasAlpha) : nullptr;
+	};
+
+	bufferStorage.deepZoom = makeShared<DeepZoomImage>(state.bitmap, imageData.hasAlpha, std::move(sourceLoader));
+
+	// Bitmap is owned by the deep zoom image now
+	state.bitmap = nullptr;
+
+	loaderIsComplete = true;
+	cleanup(true);
+
+	return true;
+}
+
 bool ImageBackgroundLoaderFreeImage::processNextMultiBitmap(FrameStorage &bufferStorage)
 {
 	TS_ASSERT(state.multibitmap != nullptr);
 
+	// Animations that fit the frame buffer are only decoded once anyway
+	const bool useFrameCache = numPagesTotal > ownerImage->frameBuffer.getMaxSize();
+	if (useFrameCache && ownerImage->frameCache.isComplete(numPagesTotal))
+	{
+		// Image data is kept over unloading and only ever set by the loader (animations aren't probed),
+		// no locking needed. The owner's mutex can't be taken here since unloading holds it while stopping the loader.
+		if (!multibitmapInitialized && ownerImage->imageDataIsSet)
+		{
+			imageData = ownerImage->imageData;
+			imageSize = imageData.size;
+			multibitmapInitialized = true;
+		}
+
+		if (multibitmapInitialized)
+			return processCachedFrame(bufferStorage);
+	}
+
 	FIBITMAP *lockedPage = FreeImage_LockPage(state.multibitmap, currentPage);
 	if (lockedPage == nullptr)
 	{
@@ -389,18 +622,13 @@ bool ImageBackgroundLoaderFreeImage::processNextMultiBitmap(FrameStorage &buffer
 			imageData.hasAlpha = (FreeImage_IsTransparent(lockedPage) == 1);
 			imageData.numFramesTotal = numPagesTotal;
 
-			stackingRenderTexture = makeUnique<sf::RenderTexture>();
-			stackingRenderTexture->create(imageSize.x, imageSize.y);
-			stackingRenderTextureThreadId = (int32_t)Thread::getCurrentThread().getThreadId();
-
-			imageVertexArray = util::makeQuadVertexArray(imageSize.x, imageSize.y);
-
 			multibitmapInitialized = true;
 		}
 
-		stackingRenderTexture->clear(sf::Color::Transparent);
-		lastDisposalMethod = DisposalMethod_NotSet;
-		previousFrame.reset();
+		if (compositor.getCanvasSize() != imageSize)
+			compositor.initialize(imageSize);
+		else
+			compositor.restart();
 	}
 
 	FITAG *tag = nullptr;
@@ -423,9 +651,9 @@ bool ImageBackgroundLoaderFreeImage::processNextMultiBitmap(FrameStorage &buffer
 	if (FreeImage_GetMetadata(FIMD_ANIMATION, lockedPage, "FrameTop", &tag))
 		offset.y = *(uint16_t*)FreeImage_GetTagValue(tag);
 
-	DisposalMethod disposalMethod = DisposalMethod_Leave;
+	FrameCompositor::DisposalMethod disposalMethod = FrameCompositor::DisposalMethod_Leave;
 	if (FreeImage_GetMetadata(FIMD_ANIMATION, lockedPage, "DisposalMethod", &tag))
-		disposalMethod = *(DisposalMethod*)FreeImage_GetTagValue(tag);
+		disposalMethod = *(FrameCompositor::DisposalMethod*)FreeImage_GetTagValue(tag);
 
 	FIBITMAP *bitmap32bpp = lockedPage;
 
@@ -434,61 +662,136 @@ bool ImageBackgroundLoaderFreeImage::processNextMultiBitmap(FrameStorage &buffer
 
 	TS_ASSERT(bitmap32bpp != nullptr);
 
-	BYTE *bits = FreeImage_GetBits(bitmap32bpp);
-	if (bits == nullptr)
+	bool success = false;
+
+	const BYTE *bits = bitmap32bpp != nullptr ? FreeImage_GetBits(bitmap32bpp) : nullptr;
+	if (bits != nullptr)
+	{
+		compositor.drawFrame(bits, FreeImage_GetPitch(bitmap32bpp), frameSize, offset, disposalMethod);
+
+		if (currentPage == 0)
+			ownerImage->makeThumbnailFromPixels(compositor.getRow(0), compositor.getPitch(), imageSize, imageData.size);
+
+		if (useFrameCache && ownerImage->frameCache.isAcceptingFrames())
+			storeCompositedFrame(bufferStorage.frameTime);
+
+		if (uploadCompositedFrame())
+		{
+			// Copied on the GPU into a recycled texture instead of constructing a new one from it
+			bufferStorage.texture = ownerImage->framePool.acquireTexture(imageSize);
+			if (bufferStorage.texture != nullptr)
+			{
+				bufferStorage.texture->update(*canvasTexture);
+				bufferStorage.texture->setSmooth(true);
+
+				if (currentPage + 1 == numPagesTotal && numPagesTotal < ownerImage->frameBuffer.getMaxSize())
+					loaderIsComplete = true;
+
+				success = true;
+			}
+		}
+	}
+	else
 	{
 		TS_LOG_ERROR("FreeImage_GetBits returned null.");
 		errorText = "FreeImage_GetBits failed.";
+	}
+
+	if (bitmap32bpp != lockedPage && bitmap32bpp != nullptr)
+		FreeImage_Unload(bitmap32bpp);
+
+	FreeImage_UnlockPage(state.multibitmap, lockedPage, FALSE);
+
+	currentPage = (currentPage + 1) % numPagesTotal;
+
+	return success;
+}
+
+bool ImageBackgroundLoaderFreeImage::processCachedFrame(FrameStorage &bufferStorage)
+{
+	TS_ZONE();
+
+	FrameCache::FrameInfo info;
+	bufferStorage.texture = loadCachedFrame(currentPage, info, sf::Texture::BGRA);
+	if (bufferStorage.texture == nullptr)
+	{
+		errorText = "Failed to load frame from the frame cache.";
 		return false;
 	}
 
-	bool success = false;
+	bufferStorage.texture->setSmooth(true);
+	bufferStorage.frameTime = info.frameTime;
+	bufferStorage.format = info.format;
 
-	sf::Texture currentFrame;
-	if (currentFrame.create(frameSize.x, frameSize.y))
+	currentPage = (currentPage + 1) % numPagesTotal;
+
+	// Nothing is composited anymore
+	if (canvasTexture != nullptr)
 	{
-		currentFrame.update(bits, sf::Texture::BGRA);
+		compositor.releaseMemory();
+		canvasTexture.reset();
+	}
 
-		if (disposalMethod == DisposalMethod_Previous && previousFrame != nullptr)
-		{
-			stackingRenderTexture->draw(imageVertexArray, previousFrame.get());
-		}
-		else if (disposalMethod == DisposalMethod_Background)
-		{
-			stackingRenderTexture->clear(sf::Color::Transparent);
-		}
+	return true;
+}
 
-		const math::VC2U sizeDiff = imageSize - frameSize;
-		stackingRenderTexture->draw(
-			util::makeQuadVertexArray(frameSize.x, frameSize.y, offset.x, sizeDiff.y - offset.y),
-			&currentFrame);
-		stackingRenderTexture->display();
+void ImageBackgroundLoaderFreeImage::storeCompositedFrame(TimeSpan frameTime)
+{
+	TS_ZONE();
 
-		const sf::Texture &stackedTexture = stackingRenderTexture->getTexture();
+	FrameCache &frameCache = ownerImage->frameCache;
+	if (frameCache.hasFrame(currentPage))
+		return;
 
-		bufferStorage.texture = makeShared<sf::Texture>(stackedTexture);
-		if (bufferStorage.texture != nullptr)
-		{
-			if (disposalMethod != DisposalMethod_Previous)
-				previousFrame = bufferStorage.texture;
+	FrameCache::FrameInfo info;
+	info.textureSize = imageSize;
+	info.format = FrameFormat_Texels;
+	info.frameTime = frameTime;
 
-			bufferStorage.texture->setSmooth(true);
+	// Canvas rows are contiguous, the whole canvas is stored as is
+	const BigSizeType size = (BigSizeType)compositor.getPitch() * imageSize.y;
+	frameCache.storeFrame(currentPage, info, compositor.getRow(0), size);
+}
 
-			if (currentPage + 1 == numPagesTotal && numPagesTotal < ownerImage->frameBuffer.getMaxSize())
-				loaderIsComplete = true;
+bool ImageBackgroundLoaderFreeImage::uploadCompositedFrame()
+{
+	TS_ZONE();
 
-			success = true;
+	if (canvasTexture == nullptr || math::VC2U(canvasTexture->getSize()) != imageSize)
+	{
+		canvasTexture = makeShared<sf::Texture>();
+		if (canvasTexture == nullptr || !canvasTexture->create(imageSize.x, imageSize.y))
+		{
+			TS_LOG_ERROR("Failed to create animation canvas texture. Size: %u x %u", imageSize.x, imageSize.y);
+			errorText = "Failed to create canvas texture.";
+			canvasTexture.reset();
+			return false;
 		}
+
+		// Fresh texture needs the whole canvas
+		compositor.invalidate();
 	}
 
-	if (bitmap32bpp != lockedPage)
-		FreeImage_Unload(bitmap32bpp);
+	FrameCompositor::Region region;
+	if (!compositor.getDirtyRegion(region))
+		return true;
 
-	FreeImage_UnlockPage(state.multibitmap, lockedPage, FALSE);
+	const SizeType rowBytes = region.size.x * 4;
+	const Byte *pixels = compositor.getRow(region.position.y) + region.position.x * 4;
 
-	currentPage = (currentPage + 1) % numPagesTotal;
+	// Full width rows are contiguous on the canvas, narrower areas are gathered first
+	if (region.size.x != imageSize.x)
+	{
+		dirtyPixels.resize((size_t)rowBytes * region.size.y);
+		for (SizeType y = 0; y < region.size.y; ++y)
+			memcpy(&dirtyPixels[(size_t)y * rowBytes], compositor.getRow(region.position.y + y) + region.position.x * 4, rowBytes);
+		pixels = &dirtyPixels[0];
+	}
 
-	return success;
+	canvasTexture->update(pixels, region.size.x, region.size.y, region.position.x, region.position.y, sf::Texture::BGRA);
+	compositor.clearDirtyRegion();
+
+	return true;
 }
 
 bool ImageBackgroundLoaderFreeImage::isLoadingComplete() const
@@ -506,12 +809,93 @@ static FREE_IMAGE_FORMAT getFreeImageFormatForFile(const String &filepath)
 	return format;
 }
 
-bool ImageBackgroundLoaderFreeImage::isValidFreeImageFile(const String &filepath)
+static FREE_IMAGE_FORMAT getFreeImageFormatForSource(const ImageSource &source)
 {
-	FREE_IMAGE_FORMAT format = getFreeImageFormatForFile(filepath);
+	// Some validators look past the start of the file, e.g. for the TGA footer, so the mapping is used when there is one
+	const bool isMapped = source.getMappedData() != nullptr;
+	const Byte *data = isMapped ? source.getMappedData() : source.getSniffData();
+	const SizeType size = isMapped ? (SizeType)source.getSize() : source.getSniffSize();
+
+	FIMEMORY *memory = FreeImage_OpenMemory(const_cast<BYTE*>(data), (DWORD)size);
+	if (memory == nullptr)
+		return FIF_UNKNOWN;
+
+	FREE_IMAGE_FORMAT format = FreeImage_GetFileTypeFromMemory(memory, (int)size);
+	FreeImage_CloseMemory(memory);
+
+	// Start of the file wasn't enough, lets FreeImage read the rest of it
+	if (format == FIF_UNKNOWN && !isMapped && source.getSize() > (PosType)source.getSniffSize())
+		format = getFreeImageFormatForFile(source.getFilepath());
+
+	return format;
+}
+
+bool ImageBackgroundLoaderFreeImage::isValidFreeImageFile(const ImageSource &source)
+{
+	FREE_IMAGE_FORMAT format = getFreeImageFormatForSource(source);
 	return FreeImage_FIFSupportsReading(format) == 1;
 }
 
+bool ImageBackgroundLoaderFreeImage::probeImageData(const ImageSource &source, ImageData &outData)
+{
+	TS_ZONE();
+
+	const FREE_IMAGE_FORMAT format = getFreeImageFormatForSource(source);
+
+	// Animations get their size from the first frame, those are left to the loader
+	if (format == FIF_UNKNOWN || format == FIF_GIF || format == FIF_MNG || !FreeImage_FIFSupportsNoPixels(format))
+		return false;
+
+	// Headers are read from the mapping, the file itself may already belong to the loader
+	FIBITMAP *header = nullptr;
+	if (source.getMappedData() != nullptr)
+	{
+		FIMEMORY *memory = FreeImage_OpenMemory(const_cast<BYTE*>(source.getMappedData()), (DWORD)source.getSize());
+		if (memory == nullptr)
+			return false;
+
+		header = FreeImage_LoadFromMemory(format, memory, FIF_LOAD_NOPIXELS);
+		FreeImage_CloseMemory(memory);
+	}
+	else
+	{
+#if TS_PLATFORM == TS_WINDOWS
+		header = FreeImage_LoadU(format, source.getFilepath().toWideString().c_str(), FIF_LOAD_NOPIXELS);
+#else
+		header = FreeImage_Load(format, source.getFilepath().toUtf8().c_str(), FIF_LOAD_NOPIXELS);
+#endif
+	}
+
+	if (header == nullptr)
+		return false;
+
+	outData.size = math::VC2U(FreeImage_GetWidth(header), FreeImage_GetHeight(header));
+
+	// JPEGs are loaded with JPEG_EXIFROTATE, orientations 5 to 8 swap width and height
+	FITAG *tag = nullptr;
+	if (format == FIF_JPEG && FreeImage_GetMetadata(FIMD_EXIF_MAIN, header, "Orientation", &tag) && FreeImage_GetTagValue(tag) != nullptr)
+	{
+		const uint16_t orientation = *(const uint16_t*)FreeImage_GetTagValue(tag);
+		if (orientation >= 5 && orientation <= 8)
+			std::swap(outData.size.x, outData.size.y);
+	}
+
+	// Same rules as the loader, without pixels fully opaque 32-bit images can't be told apart
+	if (FreeImage_GetColorType(header) != FIC_RGBALPHA)
+		outData.hasAlpha = false;
+	else if (FormatAlphaSupport.count(format) > 0)
+		outData.hasAlpha = FormatAlphaSupport.at(format);
+	else
+		outData.hasAlpha = true;
+
+	outData.numFramesTotal = 1;
+	outData.canBeRotated = isValidRotateFormat(format);
+
+	FreeImage_Unload(header);
+
+	return outData.size.x > 0 && outData.size.y > 0;
+}
+
 bool ImageBackgroundLoaderFreeImage::canImageBeRotated(const String &filepath)
 {
 	FREE_IMAGE_FORMAT format = getFreeImageFormatForFile(filepath);
@@ -649,5 +1033,30 @@ bool ImageBackgroundLoaderFreeImage::wasLoadingCompleted() const
 	return loaderIsComplete;
 }
 
+bool ImageBackgroundLoaderFreeImage::hasPartialFrame() const
+{
+	return tiledTexture != nullptr && !loaderIsComplete;
+}
+
+bool ImageBackgroundLoaderFreeImage::continuePartialFrame()
+{
+	TS_ASSERT(tiledTexture != nullptr && tilePixels != nullptr);
+
+	if (!tiledTexture->uploadNextTile(tilePixels, imageSize.x * 4))
+	{
+		errorText = "Failed to upload image tile.";
+		cleanup(true);
+		return false;
+	}
+
+	if (tiledTexture->isComplete())
+	{
+		loaderIsComplete = true;
+		cleanup(true);
+	}
+
+	return true;
+}
+
 TS_END_PACKAGE2()
 
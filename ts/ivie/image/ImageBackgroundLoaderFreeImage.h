@@ -1,8 +1,11 @@
 #pragma once
 
 #include "ts/ivie/image/AbstractImageBackgroundLoader.h"
+#include "ts/ivie/image/FrameCompositor.h"
+#include "ts/ivie/image/ImageSource.h"
 
 #include "ts/file/InputFile.h"
+#include "ts/file/MappedFile.h"
 
 #include "SFML/Graphics.hpp"
 #include "FreeImage.h"
@@ -17,12 +20,23 @@ class ImageBackgroundLoaderFreeImage : public AbstractImageBackgroundLoader
 	typedef AbstractImageBackgroundLoader BaseClass;
 
 public:
-	ImageBackgroundLoaderFreeImage(Image *ownerImage, const String &filepath);
+	/* displaySizeHint is the larger dimension of the display area. If set, JPEGs much larger
+	 * than it are decoded at 1/2, 1/4 or 1/8 scale, whichever still covers the hint.
+	 * source is the file already opened for sniffing, used for the first load. May be null,
+	 * the file is opened from the path then.
+	 */
+	ImageBackgroundLoaderFreeImage(Image *ownerImage, const String &filepath,
+		SharedPointer<ImageSource> source = nullptr, uint32_t displaySizeHint = 0);
 	virtual ~ImageBackgroundLoaderFreeImage();
 
 	virtual bool isLoadingComplete() const override;
 
-	static bool isValidFreeImageFile(const String &filepath);
+	static bool isValidFreeImageFile(const ImageSource &source);
+
+	/* Reads size and alpha of a still image from the file header without decoding the pixels.
+	 * Returns: false for animations and formats that can't be read without pixels.
+	 */
+	static bool probeImageData(const ImageSource &source, ImageData &outData);
 
 	static bool canImageBeRotated(const String &filepath);
 	static bool rotate(const String &filepath, int32_t direction);
@@ -39,22 +53,51 @@ protected:
 	virtual bool loadNextFrame(FrameStorage &bufferStorage) override;
 	virtual bool wasLoadingCompleted() const override;
 
+	virtual bool hasPartialFrame() const override;
+	virtual bool continuePartialFrame() override;
+
 private:
 	static bool isValidRotateFormat(FREE_IMAGE_FORMAT format);
 
+	// Reads the whole file to the memory buffer from a source that couldn't be mapped
+	bool readFromSource(ImageSource &source);
 	bool prepareForLoading();
+
+	// Returns: full size of the JPEG if it was decoded at a reduced scale, otherwise the decoded size.
+	math::VC2U getOriginalJpegSize(const math::VC2U &decodedSize) const;
 	void cleanup(bool soft = false);
 
+	/* Converts the loaded still bitmap to 32-bit BGRA ready for texture upload.
+	 * Returns: pointer to the converted pixels or nullptr on failure.
+	 */
+	const BYTE *convertStillForUpload(FREE_IMAGE_COLOR_TYPE colorType, bool hasAlpha);
+
 	bool processNextStill(FrameStorage &bufferStorage);
+	// Hands the bitmap over to a deep zoom image instead of uploading it
+	bool processDeepZoomStill(FrameStorage &bufferStorage);
 	bool processNextMultiBitmap(FrameStorage &bufferStorage);
+	// Uploads the area of the canvas changed since the last frame to the canvas texture
+	bool uploadCompositedFrame();
+	// Once the whole animation is in the frame cache frames are taken from there instead
+	bool processCachedFrame(FrameStorage &bufferStorage);
+	void storeCompositedFrame(TimeSpan frameTime);
 
 	bool loaderIsPrepared = false;
 	bool loaderIsComplete = false;
 
+	// Handed over on the first prepare, later ones open the file again
+	SharedPointer<ImageSource> initialSource;
+
 	struct FreeImageState
 	{
 		FREE_IMAGE_FORMAT format = FIF_UNKNOWN;
+		// Flags the still image was loaded with
+		int32_t loadFlags = 0;
 
+		// File is either mapped or, if mapping failed, read to the memory buffer.
+		// Mapping is the source's when loading from one.
+		SharedPointer<ImageSource> source;
+		file::MappedFile mappedFile;
 		std::vector<BYTE> memoryBuffer;
 		FIMEMORY *memory = nullptr;
 
@@ -66,16 +109,23 @@ private:
 	};
 	FreeImageState state;
 
-	sf::VertexArray imageVertexArray;
-	SharedPointer<sf::Texture> previousFrame;
-	UniquePointer<sf::RenderTexture> stackingRenderTexture;
-	int32_t stackingRenderTextureThreadId = -1;
+	// Converted pixels for images that can't be uploaded straight from the bitmap
+	std::vector<BYTE> uploadBuffer;
+
+	// Images too large for a single texture are uploaded tile by tile from these pixels
+	SharedPointer<TiledTexture> tiledTexture;
+	const BYTE *tilePixels = nullptr;
 
-	// Storage for render texture before suspension since its GL context requires that the 
-	// creation and deletion happen in the same thread. Gotta deinit before suspending.
-	SharedPointer<sf::Texture> savedRenderTexture;
+	// Animation frames are composited on the CPU, only the changed area of the canvas is
+	// uploaded to the canvas texture which is then copied to the frame on the GPU.
+	FrameCompositor compositor;
+	SharedPointer<sf::Texture> canvasTexture;
+	std::vector<Byte> dirtyPixels;
 
+	// Size of the decoded bitmap, smaller than imageData.size for reduced JPEG decodes
 	math::VC2U imageSize;
+	uint32_t displaySizeHint = 0;
+
 	SizeType currentPage = 0;
 	SizeType numPagesTotal = 0;
 
@@ -91,17 +141,6 @@ private:
 		MultiBitmapFormat,
 	};
 	FormatType loaderFormat = Unspecified;
-
-	enum DisposalMethod : uint8_t
-	{
-		DisposalMethod_Unspecified = 0,
-		DisposalMethod_Leave = 1,
-		DisposalMethod_Background = 2,
-		DisposalMethod_Previous = 3,
-
-		DisposalMethod_NotSet = 255,
-	};
-	DisposalMethod lastDisposalMethod = DisposalMethod_NotSet;
 };
 
 TS_END_PACKAGE2()
@@ -20,17 +20,20 @@ TS_PACKAGE2(app, image)
 
 static int io_read(void *buffer, size_t size, void *userdata)
 {
-	file::InputFile &handle = *(file::InputFile*)userdata;
+	file::BufferedInputFile &handle = *(file::BufferedInputFile*)userdata;
 	if (handle.isEOF())
 		return 0;
 
-	PosType bytesRead = (int)handle.read(reinterpret_cast<char*>(buffer), (SizeType)size);
-	return bytesRead > 0 ? 1 : (handle.isEOF() ? 0 : -1); // 1 on success, 0 on eof, -1 on failure
+	PosType bytesRead = handle.read(buffer, (BigSizeType)size);
+	if (bytesRead < 0)
+		return -1;
+
+	return bytesRead == (PosType)size ? 1 : 0; // 1 on success, 0 on eof, -1 on failure
 }
 
 static int io_seek(int64_t position, int whence, void *userdata)
 {
-	file::InputFile &handle = *(file::InputFile*)userdata;
+	file::BufferedInputFile &handle = *(file::BufferedInputFile*)userdata;
 
 	file::InputFile::SeekOrigin origin;
 	switch (whence)
@@ -41,10 +44,9 @@ static int io_seek(int64_t position, int whence, void *userdata)
 		default: TS_ASSERT(!"Unexpected seek origin."); return -1;
 	}
 
-	handle.seek(position, origin);
-	if (handle.isBad())
+	if (handle.seek(position, origin) == -1)
 	{
-		TS_ASSERT(!"The baddening");
+		TS_ASSERT(handle.isBad() == false && "The baddening");
 		return -1;
 	}
 	return 0;
@@ -52,7 +54,7 @@ static int io_seek(int64_t position, int whence, void *userdata)
 
 static int64_t io_tell(void* userdata)
 {
-	file::InputFile &handle = *(file::InputFile*)userdata;
+	file::BufferedInputFile &handle = *(file::BufferedInputFile*)userdata;
 	return handle.tell();
 }
 
@@ -93,8 +95,15 @@ static void nestegg_log_callback(nestegg *context, unsigned int severity, char c
 	}
 }
 
-ImageBackgroundLoaderWebm::ImageBackgroundLoaderWebm(Image *ownerImage, const String &filepath)
+ImageBackgroundLoaderWebm::DecoderConfig ImageBackgroundLoaderWebm::decoderConfig;
+Mutex ImageBackgroundLoaderWebm::decoderConfigMutex;
+
+ImageBackgroundLoaderWebm::ImageBackgroundLoaderWebm(Image *ownerImage, const String &filepath, SharedPointer<ImageSource> source,
+		SharedPointer<WebmFrameIndex> frameIndex, uint32_t startFrameIndex)
 	: AbstractImageBackgroundLoader(ownerImage, filepath)
+	, initialSource(source)
+	, frameIndex(frameIndex)
+	, startFrameIndex(startFrameIndex)
 {
 	TS_ZONE();
 }
@@ -130,7 +139,29 @@ bool ImageBackgroundLoaderWebm::prepareForLoading()
 
 	TS_ASSERT(loaderIsPrepared == false && "Loader is already prepared.");
 
-	if (!fileHandle.open(filepath, file::InputFileMode_ReadBinary))
+	const DecoderConfig config = getDecoderConfig();
+
+	const file::BufferedInputFile::BackingMode backingMode = config.memoryMapFile ?
+		file::BufferedInputFile::Backing_PreferMapping : file::BufferedInputFile::Backing_Read;
+
+	// File opened for sniffing is read from its mapping or taken over with the bytes already read
+	SharedPointer<ImageSource> source = std::move(initialSource);
+	if (source != nullptr)
+	{
+		if (config.memoryMapFile && source->getMappedData() != nullptr)
+		{
+			if (fileHandle.openMemory(source->getMappedData(), source->getSize()))
+				mappedSource = source;
+		}
+		else
+		{
+			file::InputFile sourceFile = source->takeFile();
+			if (sourceFile.isOpen())
+				fileHandle.open(std::move(sourceFile), config.readBlockSize, source->getSniffData(), source->getSniffSize());
+		}
+	}
+
+	if (!fileHandle.isOpen() && !fileHandle.open(filepath, config.readBlockSize, backingMode))
 	{
 		TS_WLOG_ERROR("Failed to open file. File: %s\n", filepath);
 		errorText = "Failed to open file. File doesn't exist?";
@@ -217,7 +248,8 @@ bool ImageBackgroundLoaderWebm::prepareForLoading()
 				frameTime = TimeSpan::fromNanoseconds((uint64_t)defaultDuration);
 			}
 			
-			numTotalFrames = (uint32_t)(totalDuration / frameTime);
+			// Estimate until the stream has been gone through once
+			numTotalFrames = (frameIndex != nullptr && frameIndex->isComplete) ? frameIndex->numFrames : (uint32_t)(totalDuration / frameTime);
 
 // 			TS_PRINTF("Video has about %u frames\n", numTotalFrames);
 
@@ -247,6 +279,29 @@ bool ImageBackgroundLoaderWebm::prepareForLoading()
 	imageData.size = imageSize;
 	imageData.numFramesTotal = numTotalFrames;
 
+	if (!initializeDecoder())
+		return false;
+
+	startFrameIndexBuilder();
+
+	if (startFrameIndex > 0)
+	{
+		// Cached frames play without the decoder, nothing to seek
+		if (isPlayingFromCache())
+			numFrames = startFrameIndex;
+		else if (!seekToFrame(startFrameIndex))
+			return false;
+	}
+
+	loaderIsPrepared = true;
+
+	return true;
+}
+
+bool ImageBackgroundLoaderWebm::initializeDecoder()
+{
+	const DecoderConfig config = getDecoderConfig();
+
 	state.codec = new vpx_codec_ctx_t;
 	if (state.codec == nullptr)
 	{
@@ -254,12 +309,27 @@ bool ImageBackgroundLoaderWebm::prepareForLoading()
 		return false;
 	}
 
-// 	vpx_codec_dec_cfg_t cfg;
-// 	memset(&cfg, 0, sizeof(cfg));
-// 	cfg.threads = 4;
+	// The loader's worker thread is always one of the decoder threads, the rest are borrowed
+	const SizeType numUsefulThreads = math::clamp(imageSize.x / math::max(config.minWidthPerThread, 1U), 1U, math::max(config.maxThreads, 1U));
+	if (numUsefulThreads > 1)
+		state.numHelperThreads = threadScheduler.reserveHelperThreads(numUsefulThreads - 1);
+
+	vpx_codec_dec_cfg_t cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.threads = 1 + state.numHelperThreads;
+	cfg.w = imageSize.x;
+	cfg.h = imageSize.y;
+
+	const bool isVP9 = (state.interface == &vpx_codec_vp9_dx_algo);
+
+	vpx_codec_flags_t flags = 0;
+	if (isVP9 && config.frameParallel && cfg.threads > 1 &&
+		(vpx_codec_get_caps(state.interface) & VPX_CODEC_CAP_FRAME_THREADING) != 0)
+	{
+		flags |= VPX_CODEC_USE_FRAME_THREADING;
+	}
 
-	int32_t flags = 0;
-	vpx_codec_err_t error = vpx_codec_dec_init(state.codec, state.interface, nullptr, flags);
+	vpx_codec_err_t error = vpx_codec_dec_init(state.codec, state.interface, &cfg, flags);
 	if (error != VPX_CODEC_OK)
 	{
 		errorText = "Failed to initialize codec.";
@@ -267,13 +337,116 @@ bool ImageBackgroundLoaderWebm::prepareForLoading()
 		return false;
 	}
 
-	loaderIsPrepared = true;
+	if (isVP9 && config.rowMultithreading && cfg.threads > 1)
+	{
+		// Older decoders don't know the control, they simply run without it
+		error = vpx_codec_control(state.codec, VP9D_SET_ROW_MT, 1);
+		if (error != VPX_CODEC_OK)
+			TS_LOG_WARNING("VP9 row multi-threading is not supported by the decoder. error: %s", vpx_codec_err_to_string(error));
+	}
 
 	return true;
 }
 
+bool ImageBackgroundLoaderWebm::seekToFrame(uint32_t targetFrameIndex)
+{
+	TS_ZONE();
+
+	const WebmFrameIndex::Keyframe *keyframe = nullptr;
+	if (frameIndex != nullptr && frameIndex->isSeekable)
+		keyframe = frameIndex->findKeyframe(targetFrameIndex);
+
+	if (keyframe != nullptr && keyframe->frameIndex > 0 &&
+		nestegg_track_seek(state.context, state.trackIndex, keyframe->timestamp) == 0)
+	{
+		// Cue may point to a cluster starting before the keyframe, anything before it is dropped
+		numFrames = keyframe->frameIndex;
+		skipUntilTimestamp = keyframe->timestamp;
+	}
+	else
+	{
+		// No usable keyframe, frames are skipped from the beginning instead
+		if (nestegg_track_seek(state.context, state.trackIndex, 0) == -1)
+		{
+			errorText = "Track seek error.";
+			return false;
+		}
+
+		numFrames = 0;
+		skipUntilTimestamp = 0;
+	}
+
+	skipUntilFrame = targetFrameIndex;
+	return true;
+}
+
+void ImageBackgroundLoaderWebm::startFrameIndexBuilder()
+{
+	if (frameIndex != nullptr && frameIndex->isComplete)
+		return;
+
+	// Frames are numbered exactly from any indexed keyframe, so a partial index is continued
+	frameIndexBuilder = (frameIndex != nullptr) ? makeShared<WebmFrameIndex>(*frameIndex) : makeShared<WebmFrameIndex>();
+}
+
+void ImageBackgroundLoaderWebm::publishPartialFrameIndex()
+{
+	if (frameIndexBuilder == nullptr || state.context == nullptr)
+		return;
+
+	// Seeking back may have left the decoder behind the frames already indexed
+	if (frameIndex != nullptr && frameIndex->numFrames >= numFrames)
+		return;
+
+	frameIndexBuilder->numFrames = numFrames;
+	frameIndexBuilder->duration = totalDuration;
+	frameIndexBuilder->isSeekable = (nestegg_has_cues(state.context) == 1);
+
+	// Copy, the builder keeps going if the loader is restarted
+	frameIndex = makeShared<WebmFrameIndex>(*frameIndexBuilder);
+	ownerImage->setWebmFrameIndex(frameIndex);
+}
+
+void ImageBackgroundLoaderWebm::finishFrameIndex()
+{
+	TS_ASSERT(frameIndexBuilder != nullptr);
+
+	frameIndexBuilder->numFrames = numFrames;
+	frameIndexBuilder->duration = totalDuration;
+	frameIndexBuilder->isSeekable = (nestegg_has_cues(state.context) == 1);
+	frameIndexBuilder->isComplete = true;
+
+	frameIndex = frameIndexBuilder;
+	frameIndexBuilder.reset();
+	ownerImage->setWebmFrameIndex(frameIndex);
+
+	// Estimated frame count can now be replaced by the exact one
+	if (numFrames > 0 && numTotalFrames != numFrames)
+	{
+		numTotalFrames = numFrames;
+		imageData.numFramesTotal = numFrames;
+		if (imageDataUpdated)
+			ownerImage->setImageData(imageData);
+	}
+}
+
+void ImageBackgroundLoaderWebm::setDecoderConfig(const DecoderConfig &config)
+{
+	MutexGuard lock(decoderConfigMutex);
+	decoderConfig = config;
+}
+
+ImageBackgroundLoaderWebm::DecoderConfig ImageBackgroundLoaderWebm::getDecoderConfig()
+{
+	MutexGuard lock(decoderConfigMutex);
+	return decoderConfig;
+}
+
 void ImageBackgroundLoaderWebm::cleanup()
 {
+	// Unloaded before the end of the stream, the keyframes so far are enough to resume from
+	publishPartialFrameIndex();
+
 	if (state.codec != nullptr)
 	{
 		vpx_codec_destroy(state.codec);
@@ -281,13 +454,23 @@ void ImageBackgroundLoaderWebm::cleanup()
 		state.codec = nullptr;
 	}
 
+	if (state.numHelperThreads > 0)
+	{
+		threadScheduler.releaseHelperThreads(state.numHelperThreads);
+		state.numHelperThreads = 0;
+	}
+
 	if (state.context != nullptr)
 	{
 		nestegg_destroy(state.context);
 		state.context = nullptr;
 	}
 
+	if (fileHandle.isOpen())
+		updateReadStats();
+
 	fileHandle.close();
+	mappedSource.reset();
 
 	loaderIsPrepared = false;
 	loaderIsComplete = false;
@@ -295,6 +478,57 @@ void ImageBackgroundLoaderWebm::cleanup()
 	TS_PRINTF("Cleanup complete.\n");
 }
 
+void ImageBackgroundLoaderWebm::updateReadStats()
+{
+	MutexGuard lock(readStatsMutex);
+	readStats = fileHandle.getStats();
+	readIsMapped = fileHandle.isMapped();
+}
+
+String ImageBackgroundLoaderWebm::getStats() const
+{
+	MutexGuard lock(readStatsMutex);
+	if (readStats.numReads == 0)
+		return String();
+
+	return TS_FMT("Demuxer: %.1f MB in %llu reads, %llu file reads (%.1f MB) %llu block misses%s",
+		readStats.numBytesRead / (1024.0 * 1024.0), readStats.numReads,
+		readStats.numFileReads, readStats.numFileBytesRead / (1024.0 * 1024.0),
+		readStats.numBlockMisses, readIsMapped ? " mapped" : "");
+}
+
+bool ImageBackgroundLoaderWebm::isPlayingFromCache() const
+{
+	// Frame count is only exact once the index has been built
+	return frameIndex != nullptr && frameIndex->isComplete && ownerImage->frameCache.isComplete(frameIndex->numFrames);
+}
+
+bool ImageBackgroundLoaderWebm::processCachedFrame(FrameStorage &bufferStorage)
+{
+	TS_ZONE();
+
+	TS_ASSERT(frameIndex != nullptr && frameIndex->isComplete);
+	if (numFrames >= frameIndex->numFrames)
+		numFrames = 0;
+
+	FrameCache::FrameInfo info;
+	bufferStorage.texture = loadCachedFrame(numFrames, info, sf::Texture::RGBA);
+	if (bufferStorage.texture == nullptr)
+	{
+		errorText = "Failed to load frame from the frame cache.";
+		return false;
+	}
+
+	bufferStorage.texture->setRepeated(true);
+	bufferStorage.texture->setSmooth(true);
+	bufferStorage.frameTime = info.frameTime;
+	bufferStorage.format = info.format;
+
+	numFrames++;
+
+	return true;
+}
+
 bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 {
 	int32_t result = 0;
@@ -335,6 +569,12 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 		// If result is 0, the stream has reached eof, can just seek back to the beginning.
 		if (result == 0)
 		{
+			if (frameIndexBuilder != nullptr)
+				finishFrameIndex();
+
+			skipUntilFrame = 0;
+			skipUntilTimestamp = 0;
+
 			result = nestegg_track_seek(state.context, state.trackIndex, 0);
 			if (result == -1)
 			{
@@ -368,6 +608,12 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 
 		TS_ASSERT(nestegg_track_type(state.context, trackIndex) == NESTEGG_TRACK_VIDEO);
 
+		uint64_t timestamp = 0;
+		nestegg_packet_tstamp(packet, &timestamp);
+
+		if (timestamp < skipUntilTimestamp)
+			continue;
+
 		if (nestegg_track_type(state.context, trackIndex) == NESTEGG_TRACK_VIDEO)
 		{
 // 			if (numFrames == 0)
@@ -421,6 +667,9 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 // 					break;
 				}
 
+				if (frameIndexBuilder != nullptr && streamInfo.is_kf)
+					frameIndexBuilder->addKeyframe(numFrames, timestamp);
+
 				// Decode the frame
 				error = vpx_codec_decode(state.codec, data, (uint32_t)length, nullptr, 0);
 				if (error != VPX_CODEC_OK)
@@ -434,56 +683,64 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 				vpx_codec_iter_t iter = nullptr;
 				while (vpx_image_t *image = vpx_codec_get_frame(state.codec, &iter))
 				{
-// 					TS_PRINTF("  numFrames %u / %u\n", ++numFrames, numTotalFrames);
+// 					TS_PRINTF("  numFrames %u / %u\n", numFrames, numTotalFrames);
 
+					if (numFrames++ < skipUntilFrame)
+						continue;
+
+					BufferedFrame frame;
+
+					math::VC2U textureSize;
 					std::vector<Byte> framedata;
-					framedata.resize(image->d_w * image->d_h * 4, 255);
 
-					uint32_t i = 0;
-					for (uint32_t y = 0; y < image->d_h; ++y)
+					if (canPackPlanar(image))
 					{
-						for (uint32_t x = 0; x < image->d_w; ++x)
-						{
-							framedata[i + 0] = image->planes[VPX_PLANE_Y][y       * image->stride[VPX_PLANE_Y] + x];
-
-							if ((image->fmt & VPX_IMG_FMT_UV_FLIP) == 0)
-							{
-								framedata[i + 1] = image->planes[VPX_PLANE_U][(y / 2) * image->stride[VPX_PLANE_U] + (x / 2)];
-								framedata[i + 2] = image->planes[VPX_PLANE_V][(y / 2) * image->stride[VPX_PLANE_V] + (x / 2)];
-							}
-							else
-							{
-								framedata[i + 1] = image->planes[VPX_PLANE_V][(y / 2) * image->stride[VPX_PLANE_V] + (x / 2)];
-								framedata[i + 2] = image->planes[VPX_PLANE_U][(y / 2) * image->stride[VPX_PLANE_U] + (x / 2)];
-							}
-
-							if ((image->fmt & VPX_IMG_FMT_HAS_ALPHA) > 0)
-								framedata[i + 3] = image->planes[VPX_PLANE_ALPHA][y * image->stride[VPX_PLANE_ALPHA] + x];
-// 							else
-// 								framedata[i + 3] = 255;
-
-							i += 4;
-						}
+						const bool frameHasAlpha = (image->fmt & VPX_IMG_FMT_HAS_ALPHA) != 0;
+						const PlanarLayout layout = getPlanarLayout(math::VC2U(image->d_w, image->d_h), frameHasAlpha);
+
+						framedata = ownerImage->framePool.acquireBuffer((BigSizeType)layout.rowPitch * layout.textureSize.y);
+						packPlanarFrame(image, layout, &framedata[0]);
+
+						textureSize = layout.textureSize;
+						frame.format = frameHasAlpha ? FrameFormat_PlanarYUVA420 : FrameFormat_PlanarYUV420;
 					}
+					else
+					{
+						framedata = ownerImage->framePool.acquireBuffer((BigSizeType)image->d_w * image->d_h * 4);
+						interleaveFrame(image, &framedata[0], getPixelKernels());
 
-					BufferedFrame frame;
+						textureSize = math::VC2U(image->d_w, image->d_h);
+						frame.format = FrameFormat_Texels;
+					}
 
-					frame.texture = makeShared<sf::Texture>();
+					frame.texture = ownerImage->framePool.acquireTexture(textureSize);
 					if (frame.texture == nullptr)
 					{
+						ownerImage->framePool.releaseBuffer(std::move(framedata));
 						processingResult = Error;
 						errorText = "Failed to create texture.";
 						break;
 					}
 
-					frame.texture->create(image->d_w, image->d_h);
 					frame.texture->update(&framedata[0]);
+
+					frame.frameTime = frameTime;
+
+					FrameCache &frameCache = ownerImage->frameCache;
+					if (frameCache.isAcceptingFrames())
+					{
+						FrameCache::FrameInfo info;
+						info.textureSize = textureSize;
+						info.format = frame.format;
+						info.frameTime = frame.frameTime;
+						frameCache.storeFrame(numFrames - 1, info, &framedata[0], (BigSizeType)framedata.size());
+					}
+
+					ownerImage->framePool.releaseBuffer(std::move(framedata));
 					
 					frame.texture->setRepeated(true);
 					frame.texture->setSmooth(true);
 
-					frame.frameTime = frameTime;
-
 					bufferedFrames.push_back(std::move(frame));
 				}
 
@@ -491,6 +748,10 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 					break;
 			}
 
+			// Everything decoded so far was skipped over, keep reading
+			if (processingResult == Undefined && bufferedFrames.empty() && numFrames <= skipUntilFrame)
+				processingResult = Skipping;
+
 			if (processingResult == Skipping)
 				continue;
 
@@ -515,6 +776,7 @@ bool ImageBackgroundLoaderWebm::processNextFrame(FrameStorage &bufferStorage)
 		BufferedFrame &top = bufferedFrames.front();
 		bufferStorage.texture = std::move(top.texture);
 		bufferStorage.frameTime = top.frameTime;
+		bufferStorage.format = top.format;
 		bufferedFrames.pop_front();
 		return true;
 	}
@@ -529,20 +791,154 @@ bool ImageBackgroundLoaderWebm::isLoadingComplete() const
 	return BaseClass::isLoadingComplete() && loaderIsComplete;
 }
 
-bool ImageBackgroundLoaderWebm::isValidWebmFile(const String &filepath)
+bool ImageBackgroundLoaderWebm::isValidWebmFile(const ImageSource &source)
+{
+	// Sniff data is zero padded like the full sized read used to be
+	const SizeType nesteggSniffBytesAmount = 512;
+
+	Byte buffer[nesteggSniffBytesAmount] = { 0 };
+	memcpy(buffer, source.getSniffData(), math::min(source.getSniffSize(), nesteggSniffBytesAmount));
+
+	return nestegg_sniff(&buffer[0], nesteggSniffBytesAmount) == 1;
+}
+
+bool ImageBackgroundLoaderWebm::probeImageData(const ImageSource &source, ImageData &outData)
 {
-	const BigSizeType nesteggSniffBytesAmount = 512;
+	TS_ZONE();
 
-	file::InputFile file(filepath, file::InputFileMode_ReadBinary);
+	// Headers are at the start of the file, no need for the loader's large blocks
+	const SizeType probeBlockSize = 64 * 1024;
 
-	if (!file)
+	// The loader may have taken the opened file already, the mapping can be shared
+	file::BufferedInputFile handle;
+	if (source.getMappedData() != nullptr)
+		handle.openMemory(source.getMappedData(), source.getSize());
+	else if (!handle.open(source.getFilepath(), probeBlockSize, file::BufferedInputFile::Backing_Read))
 		return false;
 
-	Byte buffer[nesteggSniffBytesAmount] = { 0 };
-	file.read(&buffer[0], nesteggSniffBytesAmount);
-	file.close();
+	nestegg_io ne_io;
+	ne_io.read = &io_read;
+	ne_io.seek = &io_seek;
+	ne_io.tell = &io_tell;
+	ne_io.userdata = (void *)&handle;
 
-	return nestegg_sniff(&buffer[0], nesteggSniffBytesAmount) == 1;
+	nestegg *context = nullptr;
+	if (nestegg_init(&context, ne_io, &nestegg_log_callback, -1) == -1)
+		return false;
+
+	bool success = false;
+
+	uint32_t numTracks = 0;
+	if (nestegg_track_count(context, &numTracks) == 0)
+	{
+		for (uint32_t track = 0; track < numTracks; ++track)
+		{
+			if (nestegg_track_type(context, track) != NESTEGG_TRACK_VIDEO)
+				continue;
+
+			nestegg_video_params vparams;
+			memset(&vparams, 0, sizeof(vparams));
+			if (nestegg_track_video_params(context, track, &vparams) == -1)
+				break;
+
+			// Same estimate the loader starts with
+			uint64_t streamTotalDuration = 0;
+			uint64_t defaultDuration = 0;
+			const TimeSpan totalDuration = nestegg_duration(context, &streamTotalDuration) == 0 ?
+				TimeSpan::fromNanoseconds(streamTotalDuration) : TimeSpan::zero;
+			const TimeSpan frameTime = nestegg_track_default_duration(context, track, &defaultDuration) == 0 && defaultDuration > 0 ?
+				TimeSpan::fromNanoseconds(defaultDuration) : 33_ms;
+
+			outData.size = math::VC2U(vparams.display_width, vparams.display_height);
+			outData.hasAlpha = (vparams.alpha_mode == 1);
+			outData.numFramesTotal = (uint32_t)(totalDuration / frameTime);
+
+			success = outData.size.x > 0 && outData.size.y > 0;
+			break;
+		}
+	}
+
+	nestegg_destroy(context);
+
+	return success;
+}
+
+void ImageBackgroundLoaderWebm::interleaveFrame(const vpx_image_t *image, Byte *destination, const PixelKernels &kernels)
+{
+	TS_ZONE();
+
+	// Plane order and alpha are the same for the whole frame
+	const bool flipChroma = (image->fmt & VPX_IMG_FMT_UV_FLIP) != 0;
+	const bool hasAlpha = (image->fmt & VPX_IMG_FMT_HAS_ALPHA) != 0;
+
+	const int32_t planeU = flipChroma ? VPX_PLANE_V : VPX_PLANE_U;
+	const int32_t planeV = flipChroma ? VPX_PLANE_U : VPX_PLANE_V;
+
+	const SizeType rowPitch = image->d_w * 4;
+
+	for (SizeType y = 0; y < image->d_h; ++y)
+	{
+		const Byte *alphaRow = hasAlpha ? image->planes[VPX_PLANE_ALPHA] + (size_t)y * image->stride[VPX_PLANE_ALPHA] : nullptr;
+
+		kernels.interleaveYUVA420(
+			image->planes[VPX_PLANE_Y] + (size_t)y * image->stride[VPX_PLANE_Y],
+			image->planes[planeU] + (size_t)(y / 2) * image->stride[planeU],
+			image->planes[planeV] + (size_t)(y / 2) * image->stride[planeV],
+			alphaRow,
+			destination + (size_t)y * rowPitch,
+			image->d_w
+		);
+	}
+}
+
+ImageBackgroundLoaderWebm::PlanarLayout ImageBackgroundLoaderWebm::getPlanarLayout(const math::VC2U &frameSize, bool hasAlpha)
+{
+	// Aligning to 8 keeps every plane column starting at a texel boundary
+	const SizeType alignedWidth = (frameSize.x + 7) & ~7U;
+
+	PlanarLayout layout;
+	layout.chromaSize = math::VC2U((frameSize.x + 1) / 2, (frameSize.y + 1) / 2);
+	layout.chromaOffset = alignedWidth;
+	layout.alphaOffset = alignedWidth + alignedWidth / 2;
+	layout.rowPitch = layout.alphaOffset + (hasAlpha ? alignedWidth : 0);
+	layout.textureSize = math::VC2U(layout.rowPitch / 4, layout.chromaSize.y * 2);
+	return layout;
+}
+
+bool ImageBackgroundLoaderWebm::canPackPlanar(const vpx_image_t *image)
+{
+	return image->x_chroma_shift == 1 && image->y_chroma_shift == 1 &&
+		(image->fmt & VPX_IMG_FMT_HIGHBITDEPTH) == 0;
+}
+
+void ImageBackgroundLoaderWebm::packPlanarFrame(const vpx_image_t *image, const PlanarLayout &layout, Byte *destination)
+{
+	TS_ZONE();
+
+	const bool flipChroma = (image->fmt & VPX_IMG_FMT_UV_FLIP) != 0;
+	const bool hasAlpha = (image->fmt & VPX_IMG_FMT_HAS_ALPHA) != 0;
+
+	const int32_t planeU = flipChroma ? VPX_PLANE_V : VPX_PLANE_U;
+	const int32_t planeV = flipChroma ? VPX_PLANE_U : VPX_PLANE_V;
+
+	for (SizeType y = 0; y < image->d_h; ++y)
+	{
+		Byte *row = destination + (size_t)y * layout.rowPitch;
+
+		memcpy(row, image->planes[VPX_PLANE_Y] + (size_t)y * image->stride[VPX_PLANE_Y], image->d_w);
+
+		if (hasAlpha)
+			memcpy(row + layout.alphaOffset, image->planes[VPX_PLANE_ALPHA] + (size_t)y * image->stride[VPX_PLANE_ALPHA], image->d_w);
+	}
+
+	for (SizeType y = 0; y < layout.chromaSize.y; ++y)
+	{
+		Byte *rowU = destination + (size_t)y * layout.rowPitch + layout.chromaOffset;
+		Byte *rowV = destination + (size_t)(y + layout.chromaSize.y) * layout.rowPitch + layout.chromaOffset;
+
+		memcpy(rowU, image->planes[planeU] + (size_t)y * image->stride[planeU], layout.chromaSize.x);
+		memcpy(rowV, image->planes[planeV] + (size_t)y * image->stride[planeV], layout.chromaSize.x);
+	}
 }
 
 int32_t ImageBackgroundLoaderWebm::restartImpl()
@@ -553,7 +949,12 @@ int32_t ImageBackgroundLoaderWebm::restartImpl()
 		return -1;
 	}
 
+	// Frames are numbered from the beginning again, keyframes already indexed are skipped
+	startFrameIndexBuilder();
+
 	numFrames = 0;
+	skipUntilFrame = 0;
+	skipUntilTimestamp = 0;
 	return 1;
 }
 
@@ -573,13 +974,19 @@ bool ImageBackgroundLoaderWebm::loadNextFrame(FrameStorage &bufferStorage)
 		}
 	}
 
-	bool success = processNextFrame(bufferStorage);
+	// Frames already decoded from the current packet are used up first
+	const bool fromCache = bufferedFrames.empty() && isPlayingFromCache();
+
+	bool success = fromCache ? processCachedFrame(bufferStorage) : processNextFrame(bufferStorage);
 	if (!success)
 	{
 		cleanup();
 		return false;
 	}
 
+	if (!fromCache)
+		updateReadStats();
+
 	if (!ownerImage->active)
 	{
 		Thread::sleep(100_ms);
@@ -2,7 +2,11 @@
 
 #include "ts/ivie/image/AbstractImageBackgroundLoader.h"
 
-#include "ts/file/InputFile.h"
+#include "ts/ivie/image/PixelKernels.h"
+#include "ts/ivie/image/WebmFrameIndex.h"
+#include "ts/ivie/image/ImageSource.h"
+
+#include "ts/file/BufferedInputFile.h"
 
 #include <deque>
 
@@ -14,6 +18,9 @@ typedef const struct vpx_codec_iface vpx_codec_iface_t;
 struct vpx_codec_ctx;
 typedef vpx_codec_ctx vpx_codec_ctx_t;
 
+struct vpx_image;
+typedef struct vpx_image vpx_image_t;
+
 TS_DECLARE2(app, image, Image);
 
 TS_PACKAGE2(app, image)
@@ -24,12 +31,79 @@ class ImageBackgroundLoaderWebm : public AbstractImageBackgroundLoader
 	typedef AbstractImageBackgroundLoader BaseClass;
 
 public:
-	ImageBackgroundLoaderWebm(Image *ownerImage, const String &filepath);
+	/* source is the file already opened for sniffing, may be null.
+	 * Frame index is the one cached on the image from an earlier pass, may be null.
+	 * Loading begins from the given frame, seeking to the nearest keyframe before it if possible.
+	 */
+	ImageBackgroundLoaderWebm(Image *ownerImage, const String &filepath, SharedPointer<ImageSource> source = nullptr,
+		SharedPointer<WebmFrameIndex> frameIndex = nullptr, uint32_t startFrameIndex = 0);
 	virtual ~ImageBackgroundLoaderWebm();
 
 	virtual bool isLoadingComplete() const override;
 
-	static bool isValidWebmFile(const String &filepath);
+	virtual String getStats() const override;
+
+	static bool isValidWebmFile(const ImageSource &source);
+
+	/* Reads the video track parameters without initializing the decoder.
+	 * Frame count is estimated from the duration until the stream has been gone through.
+	 */
+	static bool probeImageData(const ImageSource &source, ImageData &outData);
+
+	/* Interleaves decoded 4:2:0 planes to 32-bit YUVA rows for texture upload.
+	 * Destination must have room for d_w * d_h * 4 bytes.
+	 */
+	static void interleaveFrame(const vpx_image_t *image, Byte *destination, const PixelKernels &kernels);
+
+	/* Planar frames keep the 8-bit planes as they are and pack them four samples per
+	 * RGBA texel, 1.5 bytes per pixel instead of 4 (2.5 with alpha). Layout in bytes:
+	 *   Y rows at column 0, U rows at chromaOffset with V rows right below them,
+	 *   and alpha rows at alphaOffset. The planar display shader mirrors this layout.
+	 */
+	struct PlanarLayout
+	{
+		math::VC2U textureSize;
+		math::VC2U chromaSize;
+		SizeType rowPitch = 0;
+		SizeType chromaOffset = 0;
+		SizeType alphaOffset = 0;
+	};
+	static PlanarLayout getPlanarLayout(const math::VC2U &frameSize, bool hasAlpha);
+
+	/* Returns: true if the decoded image can be displayed as a planar frame.
+	 */
+	static bool canPackPlanar(const vpx_image_t *image);
+
+	/* Copies the planes to the destination with the given layout.
+	 * Destination must have room for textureSize.x * textureSize.y * 4 bytes.
+	 */
+	static void packPlanarFrame(const vpx_image_t *image, const PlanarLayout &layout, Byte *destination);
+
+	/* Decoder threading options. Extra decoder threads are reserved from the thread scheduler's
+	 * helper threads, so with all of them taken videos decode on the loader's worker alone.
+	 */
+	struct DecoderConfig
+	{
+		// Upper limit of threads for a single decoder, including the loader's own worker.
+		SizeType maxThreads = 8;
+
+		// Minimum frame width per decoder thread, narrow videos gain nothing from more threads.
+		SizeType minWidthPerThread = 256;
+
+		// VP9 row based multi-threading, lets threads split work within a tile column.
+		bool rowMultithreading = true;
+
+		// VP9 frame parallel decoding, only used if the decoder advertises support for it.
+		bool frameParallel = false;
+
+		// Demuxer reads the file in blocks of this size instead of one read per element.
+		SizeType readBlockSize = file::BufferedInputFile::DefaultBlockSize;
+
+		// Memory map the file instead of reading it, useful for local files.
+		bool memoryMapFile = false;
+	};
+	static void setDecoderConfig(const DecoderConfig &config);
+	static DecoderConfig getDecoderConfig();
 
 protected:
 	virtual bool initialize() override;
@@ -45,14 +119,37 @@ protected:
 
 private:
 	bool prepareForLoading();
+	bool initializeDecoder();
+
+	// Frames before the given one are decoded but not uploaded, only the reference frames matter
+	bool seekToFrame(uint32_t targetFrameIndex);
+	// Continues a partial index from the image, nothing to build if it is complete
+	void startFrameIndexBuilder();
+	// Hands the keyframes indexed so far to the image when unloaded before the end of the stream
+	void publishPartialFrameIndex();
+	void finishFrameIndex();
 	void cleanup();
+	// Copies the demuxer's read counters where getStats can read them
+	void updateReadStats();
 
 	bool processNextFrame(FrameStorage &bufferStorage);
 
+	// Once every frame is in the image's frame cache the decoder is no longer used
+	bool isPlayingFromCache() const;
+	bool processCachedFrame(FrameStorage &bufferStorage);
+
 	bool loaderIsPrepared = false;
 	bool loaderIsComplete = false;
 
-	file::InputFile fileHandle;
+	file::BufferedInputFile fileHandle;
+	// Copy of the file handle's counters, getStats is called from other threads
+	file::BufferedInputFile::ReadStats readStats;
+	bool readIsMapped = false;
+	mutable Mutex readStatsMutex;
+	// Handed over on the first prepare, later ones open the file again
+	SharedPointer<ImageSource> initialSource;
+	// Keeps the mapping alive while the file handle reads from it
+	SharedPointer<ImageSource> mappedSource;
 
 	struct DecoderState
 	{
@@ -60,12 +157,22 @@ private:
 		vpx_codec_iface_t *interface = nullptr;
 		vpx_codec_ctx_t *codec = nullptr;
 		uint32_t trackIndex = 0;
+		SizeType numHelperThreads = 0;
 	};
 	DecoderState state;
 
+	// Index of the next frame coming out of the decoder
 	uint32_t numFrames = 0;
 	uint32_t numTotalFrames = 0;
 
+	SharedPointer<WebmFrameIndex> frameIndex;
+	// Built during the first pass from the beginning of the stream if there's no index yet
+	SharedPointer<WebmFrameIndex> frameIndexBuilder;
+
+	uint32_t startFrameIndex = 0;
+	uint32_t skipUntilFrame = 0;
+	uint64_t skipUntilTimestamp = 0;
+
 	TimeSpan frameTime;
 	TimeSpan totalDuration;
 
@@ -73,6 +180,7 @@ private:
 	{
 		SharedPointer<sf::Texture> texture;
 		TimeSpan frameTime;
+		FrameFormat format = FrameFormat_Texels;
 	};
 	std::deque<BufferedFrame> bufferedFrames;
 
@@ -81,6 +189,9 @@ private:
 	bool imageDataUpdated = false;
 	ImageData imageData;
 
+	static DecoderConfig decoderConfig;
+	static Mutex decoderConfigMutex;
+
 };
 
 TS_END_PACKAGE2()
@@ -0,0 +1,81 @@
+#include "Precompiled.h"
+#include "ImageSource.h"
+
+TS_PACKAGE2(app, image)
+
+ImageSource::ImageSource(const String &filepath)
+	: filepath(filepath)
+{
+	TS_ASSERT(!filepath.isEmpty());
+}
+
+ImageSource::~ImageSource()
+{
+}
+
+bool ImageSource::open()
+{
+	TS_ZONE();
+
+	TS_ASSERT(!file.isOpen() && "ImageSource is already opened.");
+	if (file.isOpen())
+		return false;
+
+	if (!file.open(filepath, file::InputFileMode_ReadBinary))
+		return false;
+
+	fileSize = file.getSize();
+	if (fileSize <= 0)
+	{
+		file.close();
+		return false;
+	}
+
+	sniffData.resize((size_t)math::min(fileSize, (PosType)SniffSize));
+
+	const PosType numBytesRead = file.read(&sniffData[0], (uint32_t)sniffData.size());
+	if (numBytesRead != (PosType)sniffData.size())
+	{
+		TS_WLOG_ERROR("Failed to read the start of the file. File: %s", filepath);
+		file.close();
+		return false;
+	}
+
+	// Mapping reads nothing by itself, filesystems without mapping support are read from the file
+	mappedFile.open(file, file::MappedFileAccess_Sequential);
+
+	return true;
+}
+
+const String &ImageSource::getFilepath() const
+{
+	return filepath;
+}
+
+PosType ImageSource::getSize() const
+{
+	return fileSize;
+}
+
+const Byte *ImageSource::getSniffData() const
+{
+	return !sniffData.empty() ? &sniffData[0] : nullptr;
+}
+
+SizeType ImageSource::getSniffSize() const
+{
+	return (SizeType)sniffData.size();
+}
+
+const Byte *ImageSource::getMappedData() const
+{
+	return mappedFile.getData();
+}
+
+file::InputFile ImageSource::takeFile()
+{
+	MutexGuard lock(mutex);
+	return std::move(file);
+}
+
+TS_END_PACKAGE2()
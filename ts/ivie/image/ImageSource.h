@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ts/file/InputFile.h"
+#include "ts/file/MappedFile.h"
+
+TS_PACKAGE2(app, image)
+
+/* An image file opened once for sniffing, probing and loading. Opening reads the first
+ * SniffSize bytes and maps the whole file if the filesystem allows it. Sniffing looks at the
+ * mapping, or at the start of the file if there is none. The loader reads the mapping or takes
+ * the opened file over, so an image costs one open and one initial read however many steps
+ * look at it.
+ *
+ * Shared between the image, its header probe and its loader. Everything but takeFile
+ * can be used from several threads once opened.
+ */
+class ImageSource : public lang::Noncopyable
+{
+public:
+	// Enough for signatures at the start of a file. Formats recognized by their end, such as TGA,
+	// need the mapping or the whole file.
+	static const SizeType SniffSize = 4096;
+
+	explicit ImageSource(const String &filepath);
+	~ImageSource();
+
+	/* Returns: false if the file doesn't exist or can't be read.
+	 */
+	bool open();
+
+	const String &getFilepath() const;
+	PosType getSize() const;
+
+	// Start of the file, shorter than SniffSize for small files
+	const Byte *getSniffData() const;
+	SizeType getSniffSize() const;
+
+	/* Returns: the whole file, nullptr if it couldn't be mapped.
+	 */
+	const Byte *getMappedData() const;
+
+	/* Hands the opened file to a loader reading it without the mapping. The file is positioned
+	 * right after the sniff data. Only one loader can take it, later calls get a closed file.
+	 */
+	file::InputFile takeFile();
+
+private:
+	const String filepath;
+
+	file::InputFile file;
+	file::MappedFile mappedFile;
+	PosType fileSize = -1;
+
+	std::vector<Byte> sniffData;
+
+	Mutex mutex;
+};
+
+TS_END_PACKAGE2()
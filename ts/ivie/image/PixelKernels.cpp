@@ -0,0 +1,769 @@
+#include "Precompiled.h"
+#include "PixelKernels.h"
+
+#include "ts/ivie/util/CpuFeatures.h"
+
+#if TS_SIMD_X86 == TS_TRUE
+	#include <emmintrin.h>
+	#include <tmmintrin.h>
+	#include <immintrin.h>
+#endif
+
+TS_PACKAGE2(app, image)
+
+static const uint32_t OpaqueAlpha = 0xFF000000U;
+
+static const int32_t WeightRounding = 1 << (PixelKernels::WeightPrecision - 1);
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels, also used for the tails of the vectorized loops
+
+static void copyBGRAOpaqueScalar(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		uint32_t pixel;
+		memcpy(&pixel, src + i * 4, 4);
+		pixel |= OpaqueAlpha;
+		memcpy(dst + i * 4, &pixel, 4);
+	}
+}
+
+static void expandBGRToBGRAScalar(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255U;
+		src += 3;
+		dst += 4;
+	}
+}
+
+static void swizzleBGRAToRGBAScalar(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		uint32_t pixel;
+		memcpy(&pixel, src + i * 4, 4);
+		pixel = (pixel & 0xFF00FF00U) | ((pixel >> 16) & 0xFFU) | ((pixel & 0xFFU) << 16);
+		memcpy(dst + i * 4, &pixel, 4);
+	}
+}
+
+static void expandGreyToBGRAScalar(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		const uint32_t pixel = (uint32_t)src[i] * 0x010101U | OpaqueAlpha;
+		memcpy(dst + i * 4, &pixel, 4);
+	}
+}
+
+static void expandIndexedToBGRAScalar(const uint8_t *src, const uint32_t *palette, uint8_t *dst, SizeType numPixels)
+{
+	// Lookups don't vectorize well, gathers are not faster than this on most processors.
+	SizeType i = 0;
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		const uint32_t pixels[4] = {
+			palette[src[i + 0]],
+			palette[src[i + 1]],
+			palette[src[i + 2]],
+			palette[src[i + 3]],
+		};
+		memcpy(dst + i * 4, pixels, 16);
+	}
+	for (; i < numPixels; ++i)
+		memcpy(dst + i * 4, &palette[src[i]], 4);
+}
+
+static void interleaveYUVA420Scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *a, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		dst[0] = y[i];
+		dst[1] = u[i / 2];
+		dst[2] = v[i / 2];
+		dst[3] = a != nullptr ? a[i] : 255U;
+		dst += 4;
+	}
+}
+
+// Exact division by 255 with rounding for values up to 255 * 255
+static inline uint32_t divideBy255(uint32_t value)
+{
+	value += 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+static void blendBGRAOverScalar(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType i = 0; i < numPixels; ++i)
+	{
+		const uint8_t *s = src + i * 4;
+		uint8_t *d = dst + i * 4;
+
+		const uint32_t alpha = s[3];
+		if (alpha == 255U)
+		{
+			memcpy(d, s, 4);
+		}
+		else if (alpha != 0U)
+		{
+			const uint32_t inverse = 255U - alpha;
+			d[0] = (uint8_t)divideBy255(s[0] * alpha + d[0] * inverse);
+			d[1] = (uint8_t)divideBy255(s[1] * alpha + d[1] * inverse);
+			d[2] = (uint8_t)divideBy255(s[2] * alpha + d[2] * inverse);
+			d[3] = (uint8_t)divideBy255(alpha * 255U + d[3] * inverse);
+		}
+	}
+}
+
+// Also finishes the bytes left over by the vectorized versions
+static void sumRowsWeightedRange(const uint8_t *const *rows, const int16_t *weights, SizeType numRows,
+	uint8_t *dst, SizeType begin, SizeType end)
+{
+	for (SizeType i = begin; i < end; ++i)
+	{
+		int32_t sum = WeightRounding;
+		for (SizeType r = 0; r < numRows; ++r)
+			sum += rows[r][i] * weights[r];
+
+		dst[i] = (uint8_t)(sum >> PixelKernels::WeightPrecision);
+	}
+}
+
+static void sumRowsWeightedScalar(const uint8_t *const *rows, const int16_t *weights, SizeType numRows, uint8_t *dst, SizeType numBytes)
+{
+	sumRowsWeightedRange(rows, weights, numRows, dst, 0, numBytes);
+}
+
+static void resampleRowScalar(const uint8_t *src, const uint32_t *firstPixels, const int16_t *weights, SizeType numTaps, uint8_t *dst, SizeType numPixels)
+{
+	for (SizeType x = 0; x < numPixels; ++x)
+	{
+		const uint8_t *s = src + (size_t)firstPixels[x] * 4;
+		const int16_t *w = weights + (size_t)x * numTaps;
+
+		int32_t sum[4] = { WeightRounding, WeightRounding, WeightRounding, WeightRounding };
+		for (SizeType t = 0; t < numTaps; ++t)
+		{
+			sum[0] += s[t * 4 + 0] * w[t];
+			sum[1] += s[t * 4 + 1] * w[t];
+			sum[2] += s[t * 4 + 2] * w[t];
+			sum[3] += s[t * 4 + 3] * w[t];
+		}
+
+		uint8_t *d = dst + x * 4;
+		d[0] = (uint8_t)(sum[0] >> PixelKernels::WeightPrecision);
+		d[1] = (uint8_t)(sum[1] >> PixelKernels::WeightPrecision);
+		d[2] = (uint8_t)(sum[2] >> PixelKernels::WeightPrecision);
+		d[3] = (uint8_t)(sum[3] >> PixelKernels::WeightPrecision);
+	}
+}
+
+// Two weights in one 32-bit lane, the first in the low half, for multiply-adding pairs of 16-bit values
+static inline int32_t packWeightPair(int16_t first, int16_t second)
+{
+	return (int32_t)((uint32_t)(uint16_t)first | ((uint32_t)(uint16_t)second << 16));
+}
+
+#if TS_SIMD_X86 == TS_TRUE
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels
+
+static void copyBGRAOpaqueSSE2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i alpha = _mm_set1_epi32((int32_t)OpaqueAlpha);
+
+	SizeType i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(a, alpha));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_or_si128(b, alpha));
+	}
+	copyBGRAOpaqueScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+static void swizzleBGRAToRGBASSE2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i keepMask = _mm_set1_epi32((int32_t)0xFF00FF00U);
+	const __m128i lowMask = _mm_set1_epi32(0x000000FF);
+
+	SizeType i = 0;
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		__m128i r = _mm_and_si128(p, keepMask);
+		r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi32(p, 16), lowMask));
+		r = _mm_or_si128(r, _mm_slli_epi32(_mm_and_si128(p, lowMask), 16));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), r);
+	}
+	swizzleBGRAToRGBAScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+static void expandGreyToBGRASSE2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+	SizeType i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		__m128i g = _mm_loadu_si128((const __m128i*)(src + i));
+
+		// gg = g0 g0 g1 g1 ..., ga = g0 ff g1 ff ...
+		__m128i ggLow = _mm_unpacklo_epi8(g, g);
+		__m128i ggHigh = _mm_unpackhi_epi8(g, g);
+		__m128i gaLow = _mm_unpacklo_epi8(g, alpha);
+		__m128i gaHigh = _mm_unpackhi_epi8(g, alpha);
+
+		uint8_t *out = dst + i * 4;
+		_mm_storeu_si128((__m128i*)(out +  0), _mm_unpacklo_epi16(ggLow, gaLow));
+		_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(ggLow, gaLow));
+		_mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(ggHigh, gaHigh));
+		_mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(ggHigh, gaHigh));
+	}
+	expandGreyToBGRAScalar(src + i, dst + i * 4, numPixels - i);
+}
+
+static void interleaveYUVA420SSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *a, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+
+	SizeType i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		__m128i luma = _mm_loadu_si128((const __m128i*)(y + i));
+		__m128i alpha = a != nullptr ? _mm_loadu_si128((const __m128i*)(a + i)) : opaque;
+
+		// Duplicate chroma samples for both pixels they cover
+		__m128i chromaU = _mm_loadl_epi64((const __m128i*)(u + i / 2));
+		__m128i chromaV = _mm_loadl_epi64((const __m128i*)(v + i / 2));
+		chromaU = _mm_unpacklo_epi8(chromaU, chromaU);
+		chromaV = _mm_unpacklo_epi8(chromaV, chromaV);
+
+		// yu = y0 u0 y1 u0 ..., va = v0 a0 v0 a1 ...
+		__m128i yuLow = _mm_unpacklo_epi8(luma, chromaU);
+		__m128i yuHigh = _mm_unpackhi_epi8(luma, chromaU);
+		__m128i vaLow = _mm_unpacklo_epi8(chromaV, alpha);
+		__m128i vaHigh = _mm_unpackhi_epi8(chromaV, alpha);
+
+		uint8_t *out = dst + i * 4;
+		_mm_storeu_si128((__m128i*)(out +  0), _mm_unpacklo_epi16(yuLow, vaLow));
+		_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(yuLow, vaLow));
+		_mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(yuHigh, vaHigh));
+		_mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(yuHigh, vaHigh));
+	}
+	interleaveYUVA420Scalar(y + i, u + i / 2, v + i / 2, a != nullptr ? a + i : nullptr, dst + i * 4, numPixels - i);
+}
+
+// Blends two pixels widened to 16 bits per channel, alpha channel is blended as alpha + dst * (255 - alpha)
+static inline __m128i blendPixels16SSE2(__m128i s, __m128i d)
+{
+	const __m128i colorLanes = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+	const __m128i alphaLanes = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i rounding = _mm_set1_epi16(128);
+
+	__m128i alpha = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+	const __m128i sourceFactor = _mm_or_si128(_mm_and_si128(alpha, colorLanes), alphaLanes);
+	const __m128i destinationFactor = _mm_sub_epi16(full, alpha);
+
+	// At most 255 * 255 + 128, fits unsigned 16 bits
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(s, sourceFactor), _mm_mullo_epi16(d, destinationFactor));
+	sum = _mm_add_epi16(sum, rounding);
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_epi16(sum, 8)), 8);
+}
+
+static void blendBGRAOverSSE2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i alphaMask = _mm_set1_epi32((int32_t)OpaqueAlpha);
+	const __m128i zero = _mm_setzero_si128();
+
+	SizeType i = 0;
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		const __m128i alpha = _mm_and_si128(s, alphaMask);
+
+		// Animation frames are mostly runs of fully opaque or fully transparent pixels
+		const __m128i opaque = _mm_cmpeq_epi32(alpha, alphaMask);
+		const __m128i transparent = _mm_cmpeq_epi32(alpha, zero);
+		if (_mm_movemask_epi8(opaque) == 0xFFFF)
+		{
+			_mm_storeu_si128((__m128i*)(dst + i * 4), s);
+			continue;
+		}
+		if (_mm_movemask_epi8(transparent) == 0xFFFF)
+			continue;
+
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+
+		__m128i result;
+		if (_mm_movemask_epi8(_mm_or_si128(opaque, transparent)) == 0xFFFF)
+		{
+			result = _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, d));
+		}
+		else
+		{
+			const __m128i low = blendPixels16SSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			const __m128i high = blendPixels16SSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			result = _mm_packus_epi16(low, high);
+		}
+		_mm_storeu_si128((__m128i*)(dst + i * 4), result);
+	}
+	blendBGRAOverScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+static void sumRowsWeightedSSE2(const uint8_t *const *rows, const int16_t *weights, SizeType numRows, uint8_t *dst, SizeType numBytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi32(WeightRounding);
+
+	SizeType i = 0;
+	for (; i + 16 <= numBytes; i += 16)
+	{
+		__m128i sum0 = rounding;
+		__m128i sum1 = rounding;
+		__m128i sum2 = rounding;
+		__m128i sum3 = rounding;
+
+		// Rows go in pairs, bytes of both interleaved so each multiply-add covers two rows
+		for (SizeType r = 0; r < numRows; r += 2)
+		{
+			const bool hasPair = r + 1 < numRows;
+			const __m128i a = _mm_loadu_si128((const __m128i*)(rows[r] + i));
+			const __m128i b = hasPair ? _mm_loadu_si128((const __m128i*)(rows[r + 1] + i)) : zero;
+			const __m128i w = _mm_set1_epi32(packWeightPair(weights[r], hasPair ? weights[r + 1] : 0));
+
+			const __m128i low = _mm_unpacklo_epi8(a, b);
+			const __m128i high = _mm_unpackhi_epi8(a, b);
+			sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), w));
+			sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), w));
+			sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), w));
+			sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), w));
+		}
+
+		sum0 = _mm_srai_epi32(sum0, PixelKernels::WeightPrecision);
+		sum1 = _mm_srai_epi32(sum1, PixelKernels::WeightPrecision);
+		sum2 = _mm_srai_epi32(sum2, PixelKernels::WeightPrecision);
+		sum3 = _mm_srai_epi32(sum3, PixelKernels::WeightPrecision);
+
+		const __m128i result = _mm_packus_epi16(_mm_packs_epi32(sum0, sum1), _mm_packs_epi32(sum2, sum3));
+		_mm_storeu_si128((__m128i*)(dst + i), result);
+	}
+	sumRowsWeightedRange(rows, weights, numRows, dst, i, numBytes);
+}
+
+static void resampleRowSSE2(const uint8_t *src, const uint32_t *firstPixels, const int16_t *weights, SizeType numTaps, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi32(WeightRounding);
+
+	for (SizeType x = 0; x < numPixels; ++x)
+	{
+		const uint8_t *s = src + (size_t)firstPixels[x] * 4;
+		const int16_t *w = weights + (size_t)x * numTaps;
+
+		__m128i sum = rounding;
+
+		SizeType t = 0;
+		for (; t + 2 <= numTaps; t += 2)
+		{
+			// Two pixels to pairs of the same channel: b0 b1 g0 g1 r0 r1 a0 a1
+			const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + t * 4)), zero);
+			const __m128i pairs = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi32(packWeightPair(w[t], w[t + 1]))));
+		}
+
+		if (t < numTaps)
+		{
+			int32_t pixel;
+			memcpy(&pixel, s + t * 4, 4);
+			const __m128i pairs = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi32(packWeightPair(w[t], 0))));
+		}
+
+		sum = _mm_srai_epi32(sum, PixelKernels::WeightPrecision);
+		sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+
+		const int32_t result = _mm_cvtsi128_si32(sum);
+		memcpy(dst + x * 4, &result, 4);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// SSSE3 kernels
+
+TS_TARGET_SSSE3
+static void expandBGRToBGRASSSE3(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	// Spreads four packed 24-bit pixels from the low 12 bytes, alpha bytes are zeroed
+	const __m128i expandMask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int32_t)OpaqueAlpha);
+
+	SizeType i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		// 16 pixels in exactly 48 bytes, realign each group of four to the start of a register
+		const uint8_t *in = src + i * 3;
+		__m128i a = _mm_loadu_si128((const __m128i*)(in +  0));
+		__m128i b = _mm_loadu_si128((const __m128i*)(in + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(in + 32));
+
+		__m128i p0 = a;
+		__m128i p1 = _mm_alignr_epi8(b, a, 12);
+		__m128i p2 = _mm_alignr_epi8(c, b, 8);
+		__m128i p3 = _mm_srli_si128(c, 4);
+
+		uint8_t *out = dst + i * 4;
+		_mm_storeu_si128((__m128i*)(out +  0), _mm_or_si128(_mm_shuffle_epi8(p0, expandMask), alpha));
+		_mm_storeu_si128((__m128i*)(out + 16), _mm_or_si128(_mm_shuffle_epi8(p1, expandMask), alpha));
+		_mm_storeu_si128((__m128i*)(out + 32), _mm_or_si128(_mm_shuffle_epi8(p2, expandMask), alpha));
+		_mm_storeu_si128((__m128i*)(out + 48), _mm_or_si128(_mm_shuffle_epi8(p3, expandMask), alpha));
+	}
+	expandBGRToBGRAScalar(src + i * 3, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_SSSE3
+static void swizzleBGRAToRGBASSSE3(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m128i swizzleMask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	SizeType i = 0;
+	for (; i + 4 <= numPixels; i += 4)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i * 4));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(p, swizzleMask));
+	}
+	swizzleBGRAToRGBAScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels
+
+TS_TARGET_AVX2
+static void copyBGRAOpaqueAVX2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i alpha = _mm256_set1_epi32((int32_t)OpaqueAlpha);
+
+	SizeType i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i * 4 + 32));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(a, alpha));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4 + 32), _mm256_or_si256(b, alpha));
+	}
+	copyBGRAOpaqueScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static void expandBGRToBGRAAVX2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i expandMask = _mm256_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int32_t)OpaqueAlpha);
+
+	// Each iteration reads 28 bytes for 8 pixels (24 bytes), stop before reading past the source.
+	SizeType i = 0;
+	for (; i + 10 <= numPixels; i += 8)
+	{
+		const uint8_t *in = src + i * 3;
+		__m256i p = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in)));
+		p = _mm256_inserti128_si256(p, _mm_loadu_si128((const __m128i*)(in + 12)), 1);
+		p = _mm256_or_si256(_mm256_shuffle_epi8(p, expandMask), alpha);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), p);
+	}
+	expandBGRToBGRAScalar(src + i * 3, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static void swizzleBGRAToRGBAAVX2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i swizzleMask = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	SizeType i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(p, swizzleMask));
+	}
+	swizzleBGRAToRGBAScalar(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static void expandGreyToBGRAAVX2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i replicate = _mm256_set1_epi32(0x010101);
+	const __m256i alpha = _mm256_set1_epi32((int32_t)OpaqueAlpha);
+
+	SizeType i = 0;
+	for (; i + 16 <= numPixels; i += 16)
+	{
+		__m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+		__m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i + 8)));
+		a = _mm256_or_si256(_mm256_mullo_epi32(a, replicate), alpha);
+		b = _mm256_or_si256(_mm256_mullo_epi32(b, replicate), alpha);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), a);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4 + 32), b);
+	}
+	expandGreyToBGRAScalar(src + i, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static void interleaveYUVA420AVX2(const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *a, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i opaque = _mm256_set1_epi8((char)0xFF);
+
+	SizeType i = 0;
+	for (; i + 32 <= numPixels; i += 32)
+	{
+		__m256i luma = _mm256_loadu_si256((const __m256i*)(y + i));
+		__m256i alpha = a != nullptr ? _mm256_loadu_si256((const __m256i*)(a + i)) : opaque;
+
+		// Widening keeps the chroma in order across lanes, then duplicate to the high byte
+		__m256i chromaU = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u + i / 2)));
+		__m256i chromaV = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v + i / 2)));
+		chromaU = _mm256_or_si256(chromaU, _mm256_slli_epi16(chromaU, 8));
+		chromaV = _mm256_or_si256(chromaV, _mm256_slli_epi16(chromaV, 8));
+
+		// Unpacks work within 128-bit lanes, the results hold pixels
+		// [0-3 | 16-19], [4-7 | 20-23], [8-11 | 24-27] and [12-15 | 28-31]
+		__m256i yuLow = _mm256_unpacklo_epi8(luma, chromaU);
+		__m256i yuHigh = _mm256_unpackhi_epi8(luma, chromaU);
+		__m256i vaLow = _mm256_unpacklo_epi8(chromaV, alpha);
+		__m256i vaHigh = _mm256_unpackhi_epi8(chromaV, alpha);
+
+		__m256i p0 = _mm256_unpacklo_epi16(yuLow, vaLow);
+		__m256i p1 = _mm256_unpackhi_epi16(yuLow, vaLow);
+		__m256i p2 = _mm256_unpacklo_epi16(yuHigh, vaHigh);
+		__m256i p3 = _mm256_unpackhi_epi16(yuHigh, vaHigh);
+
+		uint8_t *out = dst + i * 4;
+		_mm256_storeu_si256((__m256i*)(out +  0), _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(p2, p3, 0x20));
+		_mm256_storeu_si256((__m256i*)(out + 64), _mm256_permute2x128_si256(p0, p1, 0x31));
+		_mm256_storeu_si256((__m256i*)(out + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+	interleaveYUVA420SSE2(y + i, u + i / 2, v + i / 2, a != nullptr ? a + i : nullptr, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static inline __m256i blendPixels16AVX2(__m256i s, __m256i d)
+{
+	const __m256i colorLanes = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+	const __m256i alphaLanes = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+	const __m256i full = _mm256_set1_epi16(255);
+	const __m256i rounding = _mm256_set1_epi16(128);
+
+	__m256i alpha = _mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+	const __m256i sourceFactor = _mm256_or_si256(_mm256_and_si256(alpha, colorLanes), alphaLanes);
+	const __m256i destinationFactor = _mm256_sub_epi16(full, alpha);
+
+	__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(s, sourceFactor), _mm256_mullo_epi16(d, destinationFactor));
+	sum = _mm256_add_epi16(sum, rounding);
+	return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_srli_epi16(sum, 8)), 8);
+}
+
+TS_TARGET_AVX2
+static void blendBGRAOverAVX2(const uint8_t *src, uint8_t *dst, SizeType numPixels)
+{
+	const __m256i alphaMask = _mm256_set1_epi32((int32_t)OpaqueAlpha);
+	const __m256i zero = _mm256_setzero_si256();
+
+	SizeType i = 0;
+	for (; i + 8 <= numPixels; i += 8)
+	{
+		const __m256i s = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		const __m256i alpha = _mm256_and_si256(s, alphaMask);
+
+		const __m256i opaque = _mm256_cmpeq_epi32(alpha, alphaMask);
+		const __m256i transparent = _mm256_cmpeq_epi32(alpha, zero);
+		if (_mm256_movemask_epi8(opaque) == -1)
+		{
+			_mm256_storeu_si256((__m256i*)(dst + i * 4), s);
+			continue;
+		}
+		if (_mm256_movemask_epi8(transparent) == -1)
+			continue;
+
+		const __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i * 4));
+
+		__m256i result;
+		if (_mm256_movemask_epi8(_mm256_or_si256(opaque, transparent)) == -1)
+		{
+			result = _mm256_blendv_epi8(d, s, opaque);
+		}
+		else
+		{
+			// Unpacks and packs both work within 128-bit lanes, pixel order is kept
+			const __m256i low = blendPixels16AVX2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+			const __m256i high = blendPixels16AVX2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+			result = _mm256_packus_epi16(low, high);
+		}
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), result);
+	}
+	blendBGRAOverSSE2(src + i * 4, dst + i * 4, numPixels - i);
+}
+
+TS_TARGET_AVX2
+static void sumRowsWeightedAVX2(const uint8_t *const *rows, const int16_t *weights, SizeType numRows, uint8_t *dst, SizeType numBytes)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i rounding = _mm256_set1_epi32(WeightRounding);
+
+	// Unpacking and packing both work within 128-bit lanes, so the bytes end up back in order
+	SizeType i = 0;
+	for (; i + 32 <= numBytes; i += 32)
+	{
+		__m256i sum0 = rounding;
+		__m256i sum1 = rounding;
+		__m256i sum2 = rounding;
+		__m256i sum3 = rounding;
+
+		for (SizeType r = 0; r < numRows; r += 2)
+		{
+			const bool hasPair = r + 1 < numRows;
+			const __m256i a = _mm256_loadu_si256((const __m256i*)(rows[r] + i));
+			const __m256i b = hasPair ? _mm256_loadu_si256((const __m256i*)(rows[r + 1] + i)) : zero;
+			const __m256i w = _mm256_set1_epi32(packWeightPair(weights[r], hasPair ? weights[r + 1] : 0));
+
+			const __m256i low = _mm256_unpacklo_epi8(a, b);
+			const __m256i high = _mm256_unpackhi_epi8(a, b);
+			sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi8(low, zero), w));
+			sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi8(low, zero), w));
+			sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(_mm256_unpacklo_epi8(high, zero), w));
+			sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(_mm256_unpackhi_epi8(high, zero), w));
+		}
+
+		sum0 = _mm256_srai_epi32(sum0, PixelKernels::WeightPrecision);
+		sum1 = _mm256_srai_epi32(sum1, PixelKernels::WeightPrecision);
+		sum2 = _mm256_srai_epi32(sum2, PixelKernels::WeightPrecision);
+		sum3 = _mm256_srai_epi32(sum3, PixelKernels::WeightPrecision);
+
+		const __m256i result = _mm256_packus_epi16(_mm256_packs_epi32(sum0, sum1), _mm256_packs_epi32(sum2, sum3));
+		_mm256_storeu_si256((__m256i*)(dst + i), result);
+	}
+	sumRowsWeightedRange(rows, weights, numRows, dst, i, numBytes);
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static const PixelKernels KernelsScalar =
+{
+	"Scalar",
+	copyBGRAOpaqueScalar,
+	expandBGRToBGRAScalar,
+	swizzleBGRAToRGBAScalar,
+	expandGreyToBGRAScalar,
+	expandIndexedToBGRAScalar,
+	interleaveYUVA420Scalar,
+	blendBGRAOverScalar,
+	sumRowsWeightedScalar,
+	resampleRowScalar,
+};
+
+#if TS_SIMD_X86 == TS_TRUE
+
+static const PixelKernels KernelsSSE2 =
+{
+	"SSE2",
+	copyBGRAOpaqueSSE2,
+	expandBGRToBGRAScalar, // Needs byte shuffles to be worthwhile
+	swizzleBGRAToRGBASSE2,
+	expandGreyToBGRASSE2,
+	expandIndexedToBGRAScalar,
+	interleaveYUVA420SSE2,
+	blendBGRAOverSSE2,
+	sumRowsWeightedSSE2,
+	resampleRowSSE2,
+};
+
+static const PixelKernels KernelsSSSE3 =
+{
+	"SSSE3",
+	copyBGRAOpaqueSSE2,
+	expandBGRToBGRASSSE3,
+	swizzleBGRAToRGBASSSE3,
+	expandGreyToBGRASSE2,
+	expandIndexedToBGRAScalar,
+	interleaveYUVA420SSE2,
+	blendBGRAOverSSE2,
+	sumRowsWeightedSSE2,
+	resampleRowSSE2,
+};
+
+static const PixelKernels KernelsAVX2 =
+{
+	"AVX2",
+	copyBGRAOpaqueAVX2,
+	expandBGRToBGRAAVX2,
+	swizzleBGRAToRGBAAVX2,
+	expandGreyToBGRAAVX2,
+	expandIndexedToBGRAScalar,
+	interleaveYUVA420AVX2,
+	blendBGRAOverAVX2,
+	sumRowsWeightedAVX2,
+	resampleRowSSE2, // Few taps per pixel, wider registers don't pay off
+};
+
+#endif
+
+bool isPixelKernelLevelSupported(PixelKernelLevel level)
+{
+	switch (level)
+	{
+		case PixelKernelLevel_Scalar: return true;
+		case PixelKernelLevel_SSE2:   return util::hasCpuFeatures(util::CpuFeature_SSE2);
+		case PixelKernelLevel_SSSE3:  return util::hasCpuFeatures(util::CpuFeature_SSE2 | util::CpuFeature_SSSE3);
+		case PixelKernelLevel_AVX2:   return util::hasCpuFeatures(util::CpuFeature_SSE2 | util::CpuFeature_AVX2);
+		default: return false;
+	}
+}
+
+const PixelKernels &getPixelKernels(PixelKernelLevel level)
+{
+	switch (level)
+	{
+#if TS_SIMD_X86 == TS_TRUE
+		case PixelKernelLevel_SSE2:  return KernelsSSE2;
+		case PixelKernelLevel_SSSE3: return KernelsSSSE3;
+		case PixelKernelLevel_AVX2:  return KernelsAVX2;
+#endif
+		default: return KernelsScalar;
+	}
+}
+
+static const PixelKernels &resolvePixelKernels()
+{
+	for (int32_t level = PixelKernelLevel_NumLevels - 1; level > PixelKernelLevel_Scalar; --level)
+	{
+		if (isPixelKernelLevelSupported((PixelKernelLevel)level))
+			return getPixelKernels((PixelKernelLevel)level);
+	}
+	return KernelsScalar;
+}
+
+const PixelKernels &getPixelKernels()
+{
+	static const PixelKernels &kernels = resolvePixelKernels();
+	return kernels;
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,79 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+/* Pixel conversion kernels used to prepare decoded images for texture upload.
+ * All kernels write 32-bit pixels in the same byte order as the source (FreeImage stores
+ * little endian BGR(A), which is uploaded as sf::Texture::BGRA). Source and destination
+ * may not overlap, except for copyBGRAOpaque which can also be used in-place.
+ */
+struct PixelKernels
+{
+	typedef void (*ConvertFunction)(const uint8_t *src, uint8_t *dst, SizeType numPixels);
+	typedef void (*IndexedConvertFunction)(const uint8_t *src, const uint32_t *palette, uint8_t *dst, SizeType numPixels);
+	typedef void (*PlanarConvertFunction)(const uint8_t *y, const uint8_t *u, const uint8_t *v, const uint8_t *a, uint8_t *dst, SizeType numPixels);
+	typedef void (*RowSumFunction)(const uint8_t *const *rows, const int16_t *weights, SizeType numRows, uint8_t *dst, SizeType numBytes);
+	typedef void (*ResampleFunction)(const uint8_t *src, const uint32_t *firstPixels, const int16_t *weights, SizeType numTaps, uint8_t *dst, SizeType numPixels);
+
+	// Resampling weights are fixed point with this many fractional bits and must add up to one.
+	// Sums are integers so every level gives exactly the same result.
+	static const int32_t WeightPrecision = 14;
+
+	const char *name;
+
+	// 32-bit pixels to 32-bit pixels with alpha forced to 255.
+	ConvertFunction copyBGRAOpaque;
+
+	// 24-bit pixels to 32-bit pixels with alpha set to 255.
+	ConvertFunction expandBGRToBGRA;
+
+	// Swaps red and blue channels of 32-bit pixels, works both ways.
+	ConvertFunction swizzleBGRAToRGBA;
+
+	// 8-bit luminance to 32-bit grey pixels with alpha set to 255.
+	ConvertFunction expandGreyToBGRA;
+
+	// 8-bit palette indices to 32-bit pixels by the 256 entry palette lookup table.
+	IndexedConvertFunction expandIndexedToBGRA;
+
+	// One row of planar 4:2:0 YUV to 32-bit YUVA, each chroma sample covers two pixels.
+	// Alpha plane may be null in which case alpha is set to 255.
+	PlanarConvertFunction interleaveYUVA420;
+
+	// Alpha blends 32-bit pixels over the destination pixels in-place, the same way
+	// sf::BlendAlpha does. Fully opaque and fully transparent pixels are copied and skipped.
+	ConvertFunction blendBGRAOver;
+
+	// Weighted sum of the bytes of numRows rows, one weight per row. Channel order doesn't matter.
+	RowSumFunction sumRowsWeighted;
+
+	// Each 32-bit destination pixel is the weighted sum of numTaps source pixels starting from
+	// firstPixels[x], with weights numTaps apart for each destination pixel.
+	ResampleFunction resampleRow;
+};
+
+enum PixelKernelLevel
+{
+	PixelKernelLevel_Scalar,
+	PixelKernelLevel_SSE2,
+	PixelKernelLevel_SSSE3,
+	PixelKernelLevel_AVX2,
+
+	PixelKernelLevel_NumLevels,
+};
+
+/* Returns: kernels for the best instruction set supported by the running processor.
+ * Dispatch is resolved once on the first call.
+ */
+extern const PixelKernels &getPixelKernels();
+
+/* Returns: kernels for the given level. Useful for comparing implementations, callers
+ * must check the level is supported first since unsupported levels crash when called.
+ */
+extern const PixelKernels &getPixelKernels(PixelKernelLevel level);
+
+/* Returns: true if kernels of the given level can be run on this processor.
+ */
+extern bool isPixelKernelLevelSupported(PixelKernelLevel level);
+
+TS_END_PACKAGE2()
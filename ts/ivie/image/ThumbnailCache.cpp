@@ -0,0 +1,240 @@
+#include "Precompiled.h"
+#include "ThumbnailCache.h"
+
+#include "ts/file/FileUtils.h"
+#include "ts/file/InputFile.h"
+#include "ts/file/OutputFile.h"
+#include "ts/math/Hash.h"
+
+#include "lz4.h"
+
+TS_PACKAGE2(app, image)
+
+namespace
+{
+
+const uint32_t ThumbnailFileMagic = 0x43545649; // "IVTC"
+const uint32_t ThumbnailFileVersion = 1;
+
+// Anything bigger is not a thumbnail, the file is broken
+const uint32_t MaxThumbnailSize = 2048;
+const uint32_t MaxPathBytes = 32 * 1024;
+
+struct ThumbnailFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	int64_t modifiedTime;
+	uint32_t width;
+	uint32_t height;
+	uint32_t imageWidth;
+	uint32_t imageHeight;
+	// UTF-8 path of the image follows the header, then the compressed pixels
+	uint32_t pathBytes;
+	uint32_t compressedBytes;
+};
+
+}
+
+bool ThumbnailCache::makeKey(const String &filepath, Key &outKey)
+{
+	file::InputFile input;
+	if (!input.open(filepath, file::InputFileMode_ReadBinary))
+		return false;
+
+	return makeKey(filepath, input.getSize(), outKey);
+}
+
+bool ThumbnailCache::makeKey(const String &filepath, PosType fileSize, Key &outKey)
+{
+	if (fileSize < 0)
+		return false;
+
+	outKey.filepath = filepath;
+	outKey.fileSize = (BigSizeType)fileSize;
+	outKey.modifiedTime = file::getFileModifiedTime(filepath);
+	return true;
+}
+
+ThumbnailCache::ThumbnailCache(const String &directory)
+	: directory(directory)
+{
+	TS_ASSERT(!directory.isEmpty());
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+}
+
+bool ThumbnailCache::load(const Key &key, Thumbnail &outThumbnail)
+{
+	TS_ZONE();
+
+	const String cacheFilepath = getCacheFilepath(key);
+
+	auto miss = [this]()
+	{
+		MutexGuard lock(mutex);
+		stats.numMissed++;
+		return false;
+	};
+
+	// Checked first, opening a missing file logs an error
+	if (!file::exists(cacheFilepath))
+		return miss();
+
+	file::InputFile input;
+	if (!input.open(cacheFilepath, file::InputFileMode_ReadBinary))
+		return miss();
+
+	ThumbnailFileHeader header;
+	if (input.readVariable(header) != sizeof(header))
+		return miss();
+
+	if (header.magic != ThumbnailFileMagic || header.version != ThumbnailFileVersion)
+		return miss();
+
+	if (header.fileSize != key.fileSize || header.modifiedTime != key.modifiedTime)
+		return miss();
+
+	if (header.width == 0 || header.height == 0 || header.width > MaxThumbnailSize || header.height > MaxThumbnailSize ||
+		header.pathBytes > MaxPathBytes || header.compressedBytes > (uint32_t)LZ4_compressBound(header.width * header.height * 4))
+	{
+		TS_LOG_WARNING("Thumbnail cache file is corrupted. File: %s", cacheFilepath);
+		return miss();
+	}
+
+	std::string storedPath(header.pathBytes, '\0');
+	if (header.pathBytes > 0 && input.read(&storedPath[0], header.pathBytes) != (PosType)header.pathBytes)
+		return miss();
+
+	if (storedPath != key.filepath.toUtf8())
+		return miss();
+
+	std::vector<char> compressed(header.compressedBytes);
+	if (header.compressedBytes == 0 || input.read(&compressed[0], header.compressedBytes) != (PosType)header.compressedBytes)
+		return miss();
+
+	const SizeType numBytes = header.width * header.height * 4;
+	outThumbnail.pixels.resize(numBytes);
+
+	const int32_t decompressedSize = LZ4_decompress_safe(
+		&compressed[0], reinterpret_cast<char*>(&outThumbnail.pixels[0]), (int32_t)compressed.size(), (int32_t)numBytes);
+
+	if (decompressedSize != (int32_t)numBytes)
+	{
+		TS_LOG_WARNING("Failed to decompress cached thumbnail. File: %s", cacheFilepath);
+		return miss();
+	}
+
+	outThumbnail.size = math::VC2U(header.width, header.height);
+	outThumbnail.imageSize = math::VC2U(header.imageWidth, header.imageHeight);
+
+	MutexGuard lock(mutex);
+	stats.numLoaded++;
+
+	return true;
+}
+
+bool ThumbnailCache::store(const Key &key, const Thumbnail &thumbnail)
+{
+	TS_ZONE();
+
+	TS_ASSERT(thumbnail.size.x > 0 && thumbnail.size.y > 0);
+	TS_ASSERT(thumbnail.pixels.size() == (size_t)thumbnail.size.x * thumbnail.size.y * 4);
+	if (thumbnail.pixels.size() != (size_t)thumbnail.size.x * thumbnail.size.y * 4 || thumbnail.pixels.empty())
+		return false;
+
+	if (!ensureDirectory())
+		return false;
+
+	std::vector<char> compressed((size_t)LZ4_compressBound((int32_t)thumbnail.pixels.size()));
+	const int32_t compressedSize = LZ4_compress_default(
+		reinterpret_cast<const char*>(&thumbnail.pixels[0]), &compressed[0], (int32_t)thumbnail.pixels.size(), (int32_t)compressed.size());
+
+	if (compressedSize <= 0)
+	{
+		TS_LOG_ERROR("Failed to compress thumbnail for the thumbnail cache.");
+		return false;
+	}
+
+	const std::string utf8Path = key.filepath.toUtf8();
+
+	ThumbnailFileHeader header;
+	header.magic = ThumbnailFileMagic;
+	header.version = ThumbnailFileVersion;
+	header.fileSize = key.fileSize;
+	header.modifiedTime = key.modifiedTime;
+	header.width = thumbnail.size.x;
+	header.height = thumbnail.size.y;
+	header.imageWidth = thumbnail.imageSize.x;
+	header.imageHeight = thumbnail.imageSize.y;
+	header.pathBytes = (uint32_t)utf8Path.size();
+	header.compressedBytes = (uint32_t)compressedSize;
+
+	// Written under a unique name so concurrent writers and readers never see a partial file
+	static std::atomic<uint32_t> temporaryCounter(0);
+	const String cacheFilepath = getCacheFilepath(key);
+	const String temporaryFilepath = TS_WFMT("%s.%u.tmp", cacheFilepath, temporaryCounter++);
+
+	{
+		file::OutputFile output;
+		if (!output.open(temporaryFilepath, file::OutputFileMode_WriteBinaryTruncate))
+			return false;
+
+		bool success = output.writeVariable(header);
+		success = success && (utf8Path.empty() || output.write(utf8Path.c_str(), header.pathBytes));
+		success = success && output.write(&compressed[0], header.compressedBytes);
+		success = success && output.flush();
+
+		if (!success)
+		{
+			output.close();
+			file::removeFile(temporaryFilepath);
+			return false;
+		}
+	}
+
+	if (!file::renameFile(temporaryFilepath, cacheFilepath))
+	{
+		file::removeFile(temporaryFilepath);
+		return false;
+	}
+
+	MutexGuard lock(mutex);
+	stats.numStored++;
+
+	return true;
+}
+
+ThumbnailCache::CacheStats ThumbnailCache::getStats() const
+{
+	MutexGuard lock(mutex);
+	return stats;
+}
+
+String ThumbnailCache::getCacheFilepath(const Key &key) const
+{
+	const uint64_t hash = math::simpleHash64(key.filepath);
+	return file::joinPaths(directory, TS_WFMT("%016llx.ivt", (unsigned long long)hash));
+}
+
+bool ThumbnailCache::ensureDirectory()
+{
+	MutexGuard lock(mutex);
+
+	if (directoryCreated)
+		return true;
+
+	// Don't keep trying (and logging) if the location isn't writable
+	if (directoryFailed)
+		return false;
+
+	directoryCreated = file::createDirectory(directory);
+	directoryFailed = !directoryCreated;
+
+	return directoryCreated;
+}
+
+TS_END_PACKAGE2()
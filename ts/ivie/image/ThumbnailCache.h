@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ts/file/FileTime.h"
+
+TS_PACKAGE2(app, image)
+
+/* Thumbnails stored on disk so they outlive the images they were made from. Each thumbnail is
+ * a small LZ4 compressed file keyed by the absolute path, size and modified time of the image
+ * file, a changed file simply misses the cache. The path is stored in the file as well so
+ * hash collisions can't return the wrong thumbnail.
+ *
+ * Safe to use from multiple threads, files are written under a temporary name and renamed.
+ */
+class ThumbnailCache : public lang::Noncopyable
+{
+public:
+	struct Key
+	{
+		String filepath;
+		BigSizeType fileSize = 0;
+		file::FileTime modifiedTime = 0;
+	};
+
+	/* Reads the size and modified time of the file for the key.
+	 * Returns: false if the file can't be accessed.
+	 */
+	static bool makeKey(const String &filepath, Key &outKey);
+	// Same with the size of an already opened file, only the modified time is read
+	static bool makeKey(const String &filepath, PosType fileSize, Key &outKey);
+
+	struct Thumbnail
+	{
+		math::VC2U size;
+		// Size of the image the thumbnail was made from
+		math::VC2U imageSize;
+		// RGBA, top row first
+		std::vector<Byte> pixels;
+	};
+
+	explicit ThumbnailCache(const String &directory);
+	~ThumbnailCache();
+
+	/* Returns: false if there is no thumbnail for the key, or it couldn't be read.
+	 */
+	bool load(const Key &key, Thumbnail &outThumbnail);
+	bool store(const Key &key, const Thumbnail &thumbnail);
+
+	struct CacheStats
+	{
+		SizeType numLoaded = 0;
+		SizeType numMissed = 0;
+		SizeType numStored = 0;
+	};
+	CacheStats getStats() const;
+
+private:
+	String getCacheFilepath(const Key &key) const;
+	bool ensureDirectory();
+
+	const String directory;
+	bool directoryCreated = false;
+	bool directoryFailed = false;
+
+	CacheStats stats;
+
+	mutable Mutex mutex;
+};
+
+TS_END_PACKAGE2()
@@ -0,0 +1,207 @@
+#include "Precompiled.h"
+#include "ThumbnailScaler.h"
+
+#include "ts/thread/ThreadScheduler.h"
+
+TS_PACKAGE2(app, image)
+
+namespace
+{
+
+// Bands smaller than this aren't worth handing to another thread
+const SizeType MinRowsPerBand = 16;
+
+// Which source pixels each destination pixel is made of, along one axis
+struct Contributions
+{
+	SizeType numTaps = 0;
+	std::vector<uint32_t> first;
+	// numTaps per destination pixel, zero for taps outside of its area
+	std::vector<int16_t> weights;
+};
+
+void computeContributions(uint32_t sourceSize, uint32_t destinationSize, Contributions &out)
+{
+	TS_ASSERT(destinationSize > 0 && destinationSize <= sourceSize);
+
+	// Source pixel i covers [i * destinationSize, (i + 1) * destinationSize) and destination pixel
+	// o covers [o * sourceSize, (o + 1) * sourceSize), so overlaps are exact integers
+	out.numTaps = math::min((sourceSize + destinationSize - 1) / destinationSize + 1, sourceSize);
+	out.first.resize(destinationSize);
+	out.weights.assign((size_t)destinationSize * out.numTaps, 0);
+
+	const int32_t one = 1 << PixelKernels::WeightPrecision;
+
+	for (uint32_t o = 0; o < destinationSize; ++o)
+	{
+		const uint64_t begin = (uint64_t)o * sourceSize;
+		const uint64_t end = begin + sourceSize;
+		const uint32_t firstPixel = (uint32_t)(begin / destinationSize);
+		const uint32_t lastPixel = (uint32_t)((end - 1) / destinationSize);
+
+		// Taps are kept inside the source, pixels before the area get zero weight
+		const uint32_t start = math::min(firstPixel, sourceSize - out.numTaps);
+		out.first[o] = start;
+
+		int16_t *weights = &out.weights[(size_t)o * out.numTaps];
+
+		int32_t total = 0;
+		uint32_t largest = firstPixel;
+		for (uint32_t p = firstPixel; p <= lastPixel; ++p)
+		{
+			const uint64_t overlap = math::min(end, (uint64_t)(p + 1) * destinationSize) - math::max(begin, (uint64_t)p * destinationSize);
+			const int32_t weight = (int32_t)(overlap * one / sourceSize);
+
+			weights[p - start] = (int16_t)weight;
+			total += weight;
+
+			if (weight > weights[largest - start])
+				largest = p;
+		}
+
+		// Rounding error goes to the largest weight so they add up to exactly one
+		weights[largest - start] = (int16_t)(weights[largest - start] + one - total);
+	}
+}
+
+struct ScaleJob
+{
+	const Byte *source = nullptr;
+	SizeType sourcePitch = 0;
+	math::VC2U sourceSize;
+	bool flipRows = false;
+
+	Byte *destination = nullptr;
+	math::VC2U destinationSize;
+
+	const PixelKernels *kernels = nullptr;
+
+	Contributions rows;
+	Contributions columns;
+
+	SizeType numBands = 0;
+	SizeType rowsPerBand = 0;
+	std::atomic<SizeType> nextBand;
+	SizeType numBandsDone = 0;
+
+	Mutex mutex;
+	ConditionVariable condition;
+};
+
+void processBands(ScaleJob &job)
+{
+	std::vector<Byte> summedRow;
+	std::vector<const uint8_t*> rowPointers(job.rows.numTaps);
+
+	const SizeType rowBytes = job.sourceSize.x * 4;
+
+	while (true)
+	{
+		// Bands are claimed one at a time, whoever gets to them first
+		const SizeType band = job.nextBand++;
+		if (band >= job.numBands)
+			return;
+
+		if (summedRow.empty())
+			summedRow.resize(rowBytes);
+
+		const SizeType firstRow = band * job.rowsPerBand;
+		const SizeType lastRow = math::min(firstRow + job.rowsPerBand, job.destinationSize.y);
+
+		for (SizeType y = firstRow; y < lastRow; ++y)
+		{
+			for (SizeType t = 0; t < job.rows.numTaps; ++t)
+			{
+				SizeType sourceRow = job.rows.first[y] + t;
+				if (job.flipRows)
+					sourceRow = job.sourceSize.y - 1 - sourceRow;
+
+				rowPointers[t] = job.source + (size_t)sourceRow * job.sourcePitch;
+			}
+
+			job.kernels->sumRowsWeighted(&rowPointers[0], &job.rows.weights[(size_t)y * job.rows.numTaps],
+				job.rows.numTaps, &summedRow[0], rowBytes);
+
+			job.kernels->resampleRow(&summedRow[0], &job.columns.first[0], &job.columns.weights[0],
+				job.columns.numTaps, job.destination + (size_t)y * job.destinationSize.x * 4, job.destinationSize.x);
+		}
+
+		MutexGuard lock(job.mutex);
+		job.numBandsDone++;
+		job.condition.notifyAll();
+	}
+}
+
+}
+
+math::VC2U getThumbnailSize(const math::VC2U &imageSize, SizeType maxSize)
+{
+	TS_ASSERT(maxSize > 0);
+
+	if (imageSize.x <= maxSize && imageSize.y <= maxSize)
+		return imageSize;
+
+	if (imageSize.x >= imageSize.y)
+		return math::VC2U(maxSize, math::max(1U, (uint32_t)((uint64_t)imageSize.y * maxSize / imageSize.x)));
+
+	return math::VC2U(math::max(1U, (uint32_t)((uint64_t)imageSize.x * maxSize / imageSize.y)), maxSize);
+}
+
+void scaleAreaAverage(const Byte *source, SizeType sourcePitch, const math::VC2U &sourceSize, bool flipRows,
+	Byte *destination, const math::VC2U &destinationSize, const PixelKernels &kernels, thread::ThreadScheduler *scheduler)
+{
+	TS_ZONE();
+
+	TS_ASSERT(source != nullptr && destination != nullptr);
+	TS_ASSERT(destinationSize.x > 0 && destinationSize.y > 0);
+	TS_ASSERT(destinationSize.x <= sourceSize.x && destinationSize.y <= sourceSize.y);
+
+	// Helper tasks may start after the scaling is done, they only touch the job through this
+	SharedPointer<ScaleJob> job = makeShared<ScaleJob>();
+	job->source = source;
+	job->sourcePitch = sourcePitch;
+	job->sourceSize = sourceSize;
+	job->flipRows = flipRows;
+	job->destination = destination;
+	job->destinationSize = destinationSize;
+	job->kernels = &kernels;
+
+	computeContributions(sourceSize.y, destinationSize.y, job->rows);
+	computeContributions(sourceSize.x, destinationSize.x, job->columns);
+
+	SizeType numThreads = 1;
+	if (scheduler != nullptr)
+		numThreads = math::max(1U, math::min(scheduler->getNumWorkers(), destinationSize.y / MinRowsPerBand));
+
+	// A few bands per thread evens out threads that get going late
+	job->numBands = numThreads > 1 ? numThreads * 4 : 1;
+	job->rowsPerBand = (destinationSize.y + job->numBands - 1) / job->numBands;
+	job->numBands = (destinationSize.y + job->rowsPerBand - 1) / job->rowsPerBand;
+	job->nextBand = 0;
+
+	std::vector<thread::SchedulerTaskId> helperTasks;
+	for (SizeType i = 1; i < numThreads; ++i)
+	{
+		helperTasks.push_back(scheduler->scheduleDetached(thread::Priority_High, TimeSpan::zero, [job]()
+		{
+			processBands(*job);
+		}));
+	}
+
+	// Bands no helper has claimed are done here, so this can't wait on a busy scheduler
+	processBands(*job);
+
+	{
+		MutexGuard lock(job->mutex);
+		job->condition.wait(lock, [&job]()
+		{
+			return job->numBandsDone == job->numBands;
+		});
+	}
+
+	// Helpers that haven't started have nothing left to do
+	for (thread::SchedulerTaskId taskId : helperTasks)
+		scheduler->cancelTask(taskId, false);
+}
+
+TS_END_PACKAGE2()
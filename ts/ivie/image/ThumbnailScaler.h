@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ts/ivie/image/PixelKernels.h"
+
+TS_DECLARE1(thread, ThreadScheduler);
+
+TS_PACKAGE2(app, image)
+
+/* Returns: size of a thumbnail fitting maxSize with the aspect ratio of the image.
+ * Thumbnails are never larger than the image.
+ */
+extern math::VC2U getThumbnailSize(const math::VC2U &imageSize, SizeType maxSize);
+
+/* Downscales 32-bit pixels by area averaging on the CPU, each destination pixel is the average
+ * of the source area it covers. Weights are fixed point and sums are integers, so the result is
+ * the same bit for bit with every kernel level and any number of threads.
+ *
+ * source: rows sourcePitch bytes apart. Channel order is kept as it is.
+ * flipRows: source rows are bottom-up (FreeImage order), destination rows are always top-down.
+ * destination: tightly packed, destinationSize must not be larger than sourceSize.
+ * scheduler: if given, bands of rows are also processed on its workers. Safe to call from a worker.
+ */
+extern void scaleAreaAverage(const Byte *source, SizeType sourcePitch, const math::VC2U &sourceSize, bool flipRows,
+	Byte *destination, const math::VC2U &destinationSize,
+	const PixelKernels &kernels = getPixelKernels(), thread::ThreadScheduler *scheduler = nullptr);
+
+TS_END_PACKAGE2()
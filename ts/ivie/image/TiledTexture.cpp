@@ -0,0 +1,145 @@
+#include "Precompiled.h"
+#include "TiledTexture.h"
+
+#include <algorithm>
+
+TS_PACKAGE2(app, image)
+
+// Small enough to give uploads some granularity and to skip offscreen parts when zoomed in
+static const uint32_t PreferredTileSize = 4096;
+
+TiledTexture::TiledTexture(const math::VC2U &imageSizeParam, uint32_t tileSize)
+	: imageSize(imageSizeParam)
+{
+	TS_ASSERT(tileSize > 0);
+	TS_ASSERT(imageSize.x > 0 && imageSize.y > 0);
+
+	const uint32_t numColumns = (imageSize.x + tileSize - 1) / tileSize;
+	const uint32_t numRows = (imageSize.y + tileSize - 1) / tileSize;
+
+	tiles.reserve((size_t)numColumns * numRows);
+	for (uint32_t row = 0; row < numRows; ++row)
+	{
+		for (uint32_t column = 0; column < numColumns; ++column)
+		{
+			Tile tile;
+			tile.position = math::VC2U(column * tileSize, row * tileSize);
+			tile.size.x = math::min(tileSize, imageSize.x - tile.position.x);
+			tile.size.y = math::min(tileSize, imageSize.y - tile.position.y);
+			tiles.push_back(tile);
+		}
+	}
+
+	// View starts out centered, the middle of the image is what becomes visible first
+	const math::VC2 center = static_cast<math::VC2>(imageSize) * 0.5f;
+	auto distanceToCenter = [this, &center](SizeType index)
+	{
+		const Tile &tile = tiles[index];
+		const math::VC2 tileCenter = static_cast<math::VC2>(tile.position) + static_cast<math::VC2>(tile.size) * 0.5f;
+		const math::VC2 delta = tileCenter - center;
+		return delta.x * delta.x + delta.y * delta.y;
+	};
+
+	uploadOrder.resize(tiles.size());
+	for (SizeType index = 0; index < uploadOrder.size(); ++index)
+		uploadOrder[index] = index;
+
+	std::stable_sort(uploadOrder.begin(), uploadOrder.end(),
+		[&distanceToCenter](SizeType a, SizeType b)
+		{
+			return distanceToCenter(a) < distanceToCenter(b);
+		});
+}
+
+TiledTexture::~TiledTexture()
+{
+}
+
+uint32_t TiledTexture::getDefaultTileSize()
+{
+	return math::min(PreferredTileSize, sf::Texture::getMaximumSize());
+}
+
+bool TiledTexture::needsTiling(const math::VC2U &imageSize)
+{
+	const uint32_t maxSize = sf::Texture::getMaximumSize();
+	return imageSize.x > maxSize || imageSize.y > maxSize;
+}
+
+bool TiledTexture::uploadNextTile(const Byte *pixels, SizeType pitch)
+{
+	TS_ZONE();
+
+	TS_ASSERT(pixels != nullptr);
+	TS_ASSERT(!isComplete() && "All tiles have been uploaded already.");
+	if (isComplete())
+		return false;
+
+	const SizeType tileIndex = uploadOrder[numTilesUploaded];
+
+	// Layout of the tiles doesn't change after construction, reading it needs no locking
+	const math::VC2U position = tiles[tileIndex].position;
+	const math::VC2U size = tiles[tileIndex].size;
+
+	// Tile rows are copied in the same bottom-up order, the display shader flips them
+	const SizeType tilePitch = size.x * 4;
+	stagingBuffer.resize((size_t)tilePitch * size.y);
+
+	const SizeType firstScanline = imageSize.y - position.y - size.y;
+	for (SizeType y = 0; y < size.y; ++y)
+	{
+		const Byte *source = pixels + (size_t)(firstScanline + y) * pitch + (size_t)position.x * 4;
+		memcpy(&stagingBuffer[(size_t)y * tilePitch], source, tilePitch);
+	}
+
+	SharedPointer<sf::Texture> texture = makeShared<sf::Texture>();
+	if (texture == nullptr || !texture->create(size.x, size.y))
+	{
+		TS_LOG_ERROR("Failed to create texture for image tile. Tile size: %u x %u", size.x, size.y);
+		return false;
+	}
+
+	texture->update(&stagingBuffer[0], size.x, size.y, 0, 0, sf::Texture::BGRA);
+	texture->generateMipmap();
+	texture->setRepeated(false);
+
+	MutexGuard lock(mutex);
+	tiles[tileIndex].texture = texture;
+	numTilesUploaded++;
+
+	if (numTilesUploaded == tiles.size())
+	{
+		stagingBuffer.clear();
+		stagingBuffer.shrink_to_fit();
+	}
+
+	return true;
+}
+
+bool TiledTexture::isComplete() const
+{
+	MutexGuard lock(mutex);
+	return numTilesUploaded == tiles.size();
+}
+
+void TiledTexture::getUploadedTiles(std::vector<Tile> &outTiles) const
+{
+	MutexGuard lock(mutex);
+
+	outTiles.clear();
+	outTiles.reserve(numTilesUploaded);
+
+	for (const Tile &tile : tiles)
+	{
+		if (tile.texture != nullptr)
+			outTiles.push_back(tile);
+	}
+}
+
+SizeType TiledTexture::getNumTilesUploaded() const
+{
+	MutexGuard lock(mutex);
+	return numTilesUploaded;
+}
+
+TS_END_PACKAGE2()
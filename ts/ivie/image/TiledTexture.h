@@ -0,0 +1,61 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+/* Image split to a grid of textures, used for images larger than the maximum texture size.
+ * Tiles are uploaded one at a time from the loader thread starting from the center of the
+ * image, the tiles uploaded so far can be drawn while the rest are still coming in.
+ */
+class TiledTexture
+{
+public:
+	struct Tile
+	{
+		SharedPointer<sf::Texture> texture;
+		// Area of the image covered by the tile, in image pixels
+		math::VC2U position;
+		math::VC2U size;
+	};
+
+	TiledTexture(const math::VC2U &imageSize, uint32_t tileSize);
+	~TiledTexture();
+
+	/* Returns: tile size for splitting images, limited by the maximum texture size.
+	 */
+	static uint32_t getDefaultTileSize();
+
+	/* Returns: true if the image can't be stored in a single texture.
+	 */
+	static bool needsTiling(const math::VC2U &imageSize);
+
+	/* Uploads the next tile from 32-bit BGRA pixels in FreeImage order (bottom row first),
+	 * covering the whole image with rows pitch bytes apart.
+	 * Returns: false if creating the texture failed.
+	 */
+	bool uploadNextTile(const Byte *pixels, SizeType pitch);
+
+	bool isComplete() const;
+
+	/* Copies the tiles that have been uploaded so far to outTiles.
+	 */
+	void getUploadedTiles(std::vector<Tile> &outTiles) const;
+
+	const math::VC2U &getImageSize() const { return imageSize; }
+	SizeType getNumTiles() const { return (SizeType)tiles.size(); }
+	SizeType getNumTilesUploaded() const;
+
+private:
+	const math::VC2U imageSize;
+
+	std::vector<Tile> tiles;
+	// Indices to tiles, sorted by distance to the center of the image
+	std::vector<SizeType> uploadOrder;
+	SizeType numTilesUploaded = 0;
+
+	// Rows of the tile being uploaded, only touched by the uploading thread
+	std::vector<Byte> stagingBuffer;
+
+	mutable Mutex mutex;
+};
+
+TS_END_PACKAGE2()
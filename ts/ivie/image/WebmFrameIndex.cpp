@@ -0,0 +1,34 @@
+#include "Precompiled.h"
+#include "WebmFrameIndex.h"
+
+#include <algorithm>
+
+TS_PACKAGE2(app, image)
+
+void WebmFrameIndex::addKeyframe(uint32_t frameIndex, uint64_t timestamp)
+{
+	// A keyframe packet that didn't output a frame shares the index with the next one
+	if (!keyframes.empty() && keyframes.back().frameIndex >= frameIndex)
+		return;
+
+	Keyframe keyframe;
+	keyframe.frameIndex = frameIndex;
+	keyframe.timestamp = timestamp;
+	keyframes.push_back(keyframe);
+}
+
+const WebmFrameIndex::Keyframe *WebmFrameIndex::findKeyframe(uint32_t frameIndex) const
+{
+	auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frameIndex,
+		[](uint32_t index, const Keyframe &keyframe)
+		{
+			return index < keyframe.frameIndex;
+		});
+
+	if (it == keyframes.begin())
+		return nullptr;
+
+	return &*(it - 1);
+}
+
+TS_END_PACKAGE2()
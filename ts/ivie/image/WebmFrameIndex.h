@@ -0,0 +1,43 @@
+#pragma once
+
+TS_PACKAGE2(app, image)
+
+/* Keyframe index of a WebM video track, built by the loader during the first full pass
+ * through the stream and cached on the Image so it survives unloading. A loader unloaded
+ * before the end of the stream leaves a partial index of the keyframes it got through.
+ */
+class WebmFrameIndex
+{
+public:
+	struct Keyframe
+	{
+		// Index of the keyframe among the displayed frames
+		uint32_t frameIndex = 0;
+		// Block timestamp in nanoseconds, used for seeking
+		uint64_t timestamp = 0;
+	};
+
+	// Adds a keyframe, frames must be added in stream order. Repeated frame indices are ignored.
+	void addKeyframe(uint32_t frameIndex, uint64_t timestamp);
+
+	/* Returns: the last keyframe at or before the given frame, null if there is none.
+	 */
+	const Keyframe *findKeyframe(uint32_t frameIndex) const;
+
+	SizeType getNumKeyframes() const { return (SizeType)keyframes.size(); }
+
+	// Frames gone through so far, the exact number in the stream once complete
+	uint32_t numFrames = 0;
+	TimeSpan duration;
+
+	// Whole stream has been gone through
+	bool isComplete = false;
+
+	// Stream has cues, nestegg can only seek by timestamp if it does
+	bool isSeekable = false;
+
+private:
+	std::vector<Keyframe> keyframes;
+};
+
+TS_END_PACKAGE2()
@@ -13,6 +13,7 @@ void makepack()
 		"shader/background_gradient.frag",
 		"shader/convert_freeimage.frag",
 		"shader/convert_webm.frag",
+		"shader/convert_webm_planar.frag",
 		"SourceHanSans-Medium.ttc",
 		"selawk.ttf",
 		"ivie_logo_32.png",
@@ -702,6 +702,33 @@ bool ImageViewerScene::updateImageInfo()
 	return false;
 }
 
+void ImageViewerScene::refreshProbedImageInfo()
+{
+	TS_ASSERT(current.image != nullptr);
+
+	image::ImageData imageData;
+	if (!current.image->getImageData(imageData))
+	{
+		// Header was fine but decoding wasn't, shown like any other failed image
+		if (current.image->hasError())
+			current.hasData = false;
+		return;
+	}
+
+	if (imageData.probed)
+		return;
+
+	// Header and decoded sizes only differ for odd files, the layout is redone if they do
+	const bool sizeChanged = imageData.size != current.data.size;
+	current.data = std::move(imageData);
+
+	if (sizeChanged)
+	{
+		updateDefaultScale();
+		defaultScale.cutToTarget();
+	}
+}
+
 void ImageViewerScene::update(const TimeSpan deltaTime)
 {
 	TS_ZONE();
@@ -711,8 +738,15 @@ void ImageViewerScene::update(const TimeSpan deltaTime)
 	framePadding = math::max(20.f, view.size.x * 0.02f);
 	updateViewport(view);
 
+	viewerManager->setDisplaySize(static_cast<math::VC2U>(view.size));
+
 	if (current.image != nullptr && !current.hasError && !current.hasData)
 		updateImageInfo();
+	else if (current.image != nullptr && current.hasData && current.data.probed)
+		refreshProbedImageInfo();
+
+	if (current.image != nullptr && current.hasData)
+		current.image->updateDisplayScale(defaultScale.getValue() * imageScale.getTarget());
 
 	if (!sf::Mouse::isButtonPressed(sf::Mouse::Middle))
 	{
@@ -885,6 +919,104 @@ void ImageViewerScene::filesDropped(const std::vector<engine::window::DroppedFil
 	viewerManager->setViewerPath(files[0].filepath);
 }
 
+void ImageViewerScene::renderTiles(sf::RenderTarget &renderTarget, const engine::window::WindowView &view,
+	const image::TiledTexture &tiledTexture, const sf::Transform &transform, image::DisplayShaderParams params)
+{
+	TS_ZONE();
+
+	tiledTexture.getUploadedTiles(uploadedTiles);
+
+	// View is centered on the origin
+	const sf::FloatRect viewRect(view.size.x * -0.5f, view.size.y * -0.5f, view.size.x, view.size.y);
+
+	for (image::TiledTexture::Tile &tile : uploadedTiles)
+	{
+		const sf::FloatRect tileRect((float)tile.position.x, (float)tile.position.y, (float)tile.size.x, (float)tile.size.y);
+		if (!transform.transformRect(tileRect).intersects(viewRect))
+			continue;
+
+		sf::VertexArray va = util::makeQuadVertexArrayScaled(
+			tile.size.x, tile.size.y,
+			tile.size.x, tile.size.y,
+			tile.position.x, tile.position.y
+		);
+
+		tile.texture->setSmooth(displaySmooth);
+
+		params.regionSize = tile.size;
+
+		sf::RenderStates states;
+		states.texture = tile.texture.get();
+		states.transform = transform;
+		states.shader = current.image->getDisplayShader(&params);
+
+		renderTarget.draw(va, states);
+	}
+
+	uploadedTiles.clear();
+}
+
+void ImageViewerScene::renderDeepZoom(sf::RenderTarget &renderTarget, const engine::window::WindowView &view,
+	image::DeepZoomImage &deepZoom, const math::Transform &transform, image::DisplayShaderParams params)
+{
+	TS_ZONE();
+
+	// Deep zoom image may have been decoded smaller than the reported image size
+	const math::VC2 imageSize = static_cast<math::VC2>(current.data.size);
+	const math::VC2 zoomSize = static_cast<math::VC2>(deepZoom.getImageSize());
+	const math::VC2 zoomToImage(imageSize.x / zoomSize.x, imageSize.y / zoomSize.y);
+
+	// Bounds of the view in the deep zoom image, view is centered on the origin
+	const math::Transform inverse = transform.getInverse();
+	const math::VC2 halfSize = view.size * 0.5f;
+	const math::VC2 corners[4] = {
+		inverse.transformPoint(math::VC2(-halfSize.x, -halfSize.y)),
+		inverse.transformPoint(math::VC2( halfSize.x, -halfSize.y)),
+		inverse.transformPoint(math::VC2( halfSize.x,  halfSize.y)),
+		inverse.transformPoint(math::VC2(-halfSize.x,  halfSize.y)),
+	};
+
+	math::VC2 visibleMin = corners[0];
+	math::VC2 visibleMax = corners[0];
+	for (const math::VC2 &corner : corners)
+	{
+		visibleMin.x = math::min(visibleMin.x, corner.x);
+		visibleMin.y = math::min(visibleMin.y, corner.y);
+		visibleMax.x = math::max(visibleMax.x, corner.x);
+		visibleMax.y = math::max(visibleMax.y, corner.y);
+	}
+	visibleMin = math::VC2(visibleMin.x / zoomToImage.x, visibleMin.y / zoomToImage.y);
+	visibleMax = math::VC2(visibleMax.x / zoomToImage.x, visibleMax.y / zoomToImage.y);
+
+	const float displayScale = params.scale * zoomToImage.x;
+	deepZoom.getTiles(displayScale, visibleMin, visibleMax, deepZoomTiles);
+
+	for (image::DeepZoomImage::DrawTile &tile : deepZoomTiles)
+	{
+		sf::VertexArray va = util::makeQuadVertexArray(tile.size.x, tile.size.y);
+
+		tile.texture->setSmooth(displaySmooth);
+
+		sf::Transform tileTransform = (sf::Transform)transform;
+		tileTransform
+			.translate(tile.position.x * zoomToImage.x, tile.position.y * zoomToImage.y)
+			.scale(tile.scale.x * zoomToImage.x, tile.scale.y * zoomToImage.y);
+
+		// Shader works in texels of the tile, which are larger than image pixels on coarser levels
+		params.scale = displayScale * tile.scale.x;
+		params.regionSize = tile.size;
+
+		sf::RenderStates states;
+		states.texture = tile.texture.get();
+		states.transform = tileTransform;
+		states.shader = current.image->getDisplayShader(&params);
+
+		renderTarget.draw(va, states);
+	}
+
+	deepZoomTiles.clear();
+}
+
 void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const engine::window::WindowView &view)
 {
 	TS_ZONE();
@@ -915,7 +1047,7 @@ void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const e
 			image::FrameStorage currentFrame = *current.image->getCurrentFrameStorage();
 			current.frameTime = currentFrame.frameTime;
 
-			if (currentFrame.texture != nullptr)
+			if (currentFrame.texture != nullptr || currentFrame.tiledTexture != nullptr || currentFrame.deepZoom != nullptr)
 			{
 				if (current.image->getIsAnimated())
 				{
@@ -929,16 +1061,6 @@ void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const e
 					}
 				}
 
-				sf::VertexArray va = util::makeQuadVertexArrayScaled(
-					current.data.size.x, current.data.size.y,
-					current.data.size.x, current.data.size.y
-				);
-
-				currentFrame.texture->setSmooth(displaySmooth);
-
-				sf::RenderStates states;
-				states.texture = currentFrame.texture.get();
-
 				const math::VC2 offset = positionOffset.getValue() + viewportOffset;
 
 				math::Transform transform;
@@ -948,15 +1070,40 @@ void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const e
 					.translate(scaledSize * -0.5f)
 					.scale(scale, scale);
 
-				states.transform = (sf::Transform)transform;
-
 				image::DisplayShaderParams params;
 				params.viewSize = view.size;
 				params.scale = scale;
 				params.offset = offset;
-				states.shader = current.image->getDisplayShader(&params);
+				params.frameFormat = currentFrame.format;
 
-				renderTarget.draw(va, states);
+				if (currentFrame.deepZoom != nullptr)
+				{
+					renderDeepZoom(renderTarget, view, *currentFrame.deepZoom, transform, params);
+				}
+				else if (currentFrame.tiledTexture != nullptr)
+				{
+					renderTiles(renderTarget, view, *currentFrame.tiledTexture, (sf::Transform)transform, params);
+				}
+				else
+				{
+					// Texture may be smaller than the image if it was decoded at reduced resolution
+					const math::VC2U textureSize = currentFrame.format == image::FrameFormat_Texels
+						? math::VC2U(currentFrame.texture->getSize()) : current.data.size;
+
+					sf::VertexArray va = util::makeQuadVertexArrayScaled(
+						current.data.size.x, current.data.size.y,
+						textureSize.x, textureSize.y
+					);
+
+					currentFrame.texture->setSmooth(displaySmooth);
+
+					sf::RenderStates states;
+					states.texture = currentFrame.texture.get();
+					states.transform = (sf::Transform)transform;
+					states.shader = current.image->getDisplayShader(&params);
+
+					renderTarget.draw(va, states);
+				}
 			}
 			else
 			{
@@ -964,15 +1111,33 @@ void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const e
 			}
 		}
 		
-		if (!displayable && current.hasData)
+		if (!displayable)
 		{
 			SharedPointer<sf::Texture> thumbnail = current.image->getThumbnail();
-			if (thumbnail != nullptr)
+
+			// Thumbnails from the thumbnail cache show up before the image data
+			math::VC2U imageSize = current.data.size;
+			float placeholderScale = scale;
+			if (thumbnail != nullptr && !current.hasData)
+			{
+				imageSize = current.image->getThumbnailImageSize();
+				if (imageSize.x > 0 && imageSize.y > 0)
+				{
+					const math::VC2 viewportSize = viewport.getSize();
+					placeholderScale = math::min(
+						math::min(1.f, (viewportSize.x - framePadding) / imageSize.x),
+						math::min(1.f, (viewportSize.y - framePadding) / imageSize.y)
+					);
+				}
+			}
+
+			if (thumbnail != nullptr && imageSize.x > 0 && imageSize.y > 0)
 			{
 				const math::VC2U thumbnailSize = thumbnail->getSize();
+				const math::VC2 placeholderSize = static_cast<math::VC2>(imageSize) * placeholderScale;
 
 				sf::VertexArray va = util::makeQuadVertexArrayScaled(
-					current.data.size.x, current.data.size.y,
+					imageSize.x, imageSize.y,
 					thumbnailSize.x, thumbnailSize.y
 				);
 
@@ -984,14 +1149,14 @@ void ImageViewerScene::renderApplication(sf::RenderTarget &renderTarget, const e
 				transform
 					.translate(offset)
 					.rotate(rotationInfo.visualRotation.getValue())
-					.translate(scaledSize * -0.5f)
-					.scale(scale, scale);
+					.translate(placeholderSize * -0.5f)
+					.scale(placeholderScale, placeholderScale);
 
 				states.transform = (sf::Transform)transform;
 
 				sf::Shader &gaussian = *gaussianShader->getResource();
 // 				gaussian.setUniform("u_textureSize", static_cast<math::VC2>(thumbnailSize));
-				gaussian.setUniform("u_textureSize", static_cast<math::VC2>(current.data.size));
+				gaussian.setUniform("u_textureSize", static_cast<math::VC2>(imageSize));
 				gaussian.setUniform("u_direction", math::VC2(0.5f, 0.f));
 				states.shader = &gaussian;
 
@@ -1284,9 +1449,10 @@ void ImageViewerScene::renderInterface(sf::RenderTarget &renderTarget, const eng
 			thread::ThreadScheduler::SchedulerStats stats = ts.getStats();
 
 			debugText.setString(TS_FMT(
-				"Scheduler: %u / %u working  %u pending [%u interval]",
+				"Scheduler: %u / %u working  %u pending [%u interval]  %u helper threads",
 				stats.numWorkedTasks, stats.numBackgroundWorkers,
-				stats.numQueuedTasks, stats.numIntervalTasks
+				stats.numQueuedTasks, stats.numIntervalTasks,
+				stats.numHelperThreads
 			));
 
 			debugText.setPosition(10.f, 200.f);
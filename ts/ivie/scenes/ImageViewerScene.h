@@ -4,6 +4,7 @@
 
 #include "ts/math/Damper.h"
 #include "ts/ivie/image/Image.h"
+#include "ts/ivie/image/DeepZoomImage.h"
 
 #include "ts/engine/window/WindowManager.h"
 
@@ -77,6 +78,8 @@ protected:
 
 	void updateDefaultScale();
 	bool updateImageInfo();
+	// Replaces image data read from the file header with the loader's once it's available
+	void refreshProbedImageInfo();
 
 	void drawLoaderGadget(sf::RenderTarget &renderTarget,
 		const math::VC2 &centerPosition, float width = 12.f, float size = 5.f);
@@ -156,6 +159,17 @@ protected:
 
 	bool displaySmooth = true;
 
+	// Draws the uploaded tiles of a tiled frame, skipping the ones outside of the view
+	void renderTiles(sf::RenderTarget &renderTarget, const engine::window::WindowView &view,
+		const image::TiledTexture &tiledTexture, const sf::Transform &transform, image::DisplayShaderParams params);
+	// Kept around to avoid allocating every frame
+	std::vector<image::TiledTexture::Tile> uploadedTiles;
+
+	// Draws the tiles the view needs from the deep zoom cache, requesting the missing ones
+	void renderDeepZoom(sf::RenderTarget &renderTarget, const engine::window::WindowView &view,
+		image::DeepZoomImage &deepZoom, const math::Transform &transform, image::DisplayShaderParams params);
+	std::vector<image::DeepZoomImage::DrawTile> deepZoomTiles;
+
 	math::VC2I lastMousePosition;
 
 	bool showManagerStatus = false;
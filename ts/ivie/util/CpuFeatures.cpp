@@ -0,0 +1,90 @@
+#include "Precompiled.h"
+#include "CpuFeatures.h"
+
+#if TS_SIMD_X86 == TS_TRUE
+	#if TS_COMPILER == TS_MSC
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+TS_PACKAGE2(app, util)
+
+#if TS_SIMD_X86 == TS_TRUE
+
+static void cpuid(int32_t leaf, int32_t subleaf, uint32_t registers[4])
+{
+#if TS_COMPILER == TS_MSC
+	__cpuidex(reinterpret_cast<int*>(registers), leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static uint64_t getExtendedControlRegister()
+{
+#if TS_COMPILER == TS_MSC
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t detectCpuFeatures()
+{
+	enum Registers { EAX, EBX, ECX, EDX };
+
+	uint32_t registers[4] = { 0 };
+	cpuid(0, 0, registers);
+	const uint32_t maxLeaf = registers[EAX];
+	if (maxLeaf < 1)
+		return 0;
+
+	uint32_t features = 0;
+
+	cpuid(1, 0, registers);
+	if (registers[EDX] & (1 << 26))
+		features |= CpuFeature_SSE2;
+	if (registers[ECX] & (1 << 9))
+		features |= CpuFeature_SSSE3;
+	if (registers[ECX] & (1 << 19))
+		features |= CpuFeature_SSE41;
+
+	// AVX state must also be enabled by the OS (OSXSAVE set and XMM/YMM state saved)
+	const bool osSavesYmm = (registers[ECX] & (1 << 27)) != 0 &&
+		(getExtendedControlRegister() & 0x6) == 0x6;
+
+	if (osSavesYmm && maxLeaf >= 7)
+	{
+		cpuid(7, 0, registers);
+		if (registers[EBX] & (1 << 5))
+			features |= CpuFeature_AVX2;
+	}
+
+	return features;
+}
+
+#else
+
+static uint32_t detectCpuFeatures()
+{
+	return 0;
+}
+
+#endif
+
+uint32_t getCpuFeatures()
+{
+	static const uint32_t features = detectCpuFeatures();
+	return features;
+}
+
+bool hasCpuFeatures(uint32_t features)
+{
+	return (getCpuFeatures() & features) == features;
+}
+
+TS_END_PACKAGE2()
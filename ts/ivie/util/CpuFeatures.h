@@ -0,0 +1,40 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define TS_SIMD_X86 TS_TRUE
+#else
+	#define TS_SIMD_X86 TS_FALSE
+#endif
+
+// GCC and Clang only allow instruction set intrinsics in functions compiled for the target,
+// MSVC allows them anywhere. Kernels using them must only be called after checking support.
+#if TS_COMPILER == TS_MSC
+	#define TS_TARGET_SSSE3
+	#define TS_TARGET_SSE41
+	#define TS_TARGET_AVX2
+#else
+	#define TS_TARGET_SSSE3 __attribute__((target("ssse3")))
+	#define TS_TARGET_SSE41 __attribute__((target("sse4.1")))
+	#define TS_TARGET_AVX2  __attribute__((target("avx2")))
+#endif
+
+TS_PACKAGE2(app, util)
+
+enum CpuFeatureBits
+{
+	CpuFeature_SSE2  = (1 << 0),
+	CpuFeature_SSSE3 = (1 << 1),
+	CpuFeature_SSE41 = (1 << 2),
+	CpuFeature_AVX2  = (1 << 3),
+};
+
+/* Returns: combination of CpuFeatureBits supported by both the processor and the OS.
+ * Detection is only done once, subsequent calls return the cached value.
+ */
+extern uint32_t getCpuFeatures();
+
+/* Returns: true if all of the given feature bits are supported.
+ */
+extern bool hasCpuFeatures(uint32_t features);
+
+TS_END_PACKAGE2()
@@ -0,0 +1,177 @@
+#include "Precompiled.h"
+#include "ImageResidency.h"
+
+#include "ts/container/ContainerUtil.h"
+
+#include <algorithm>
+
+TS_PACKAGE2(app, viewer)
+
+ImageResidency::ImageResidency()
+{
+}
+
+ImageResidency::~ImageResidency()
+{
+}
+
+void ImageResidency::setLimits(const Limits &limitsParam)
+{
+	limits = limitsParam;
+}
+
+const ImageResidency::Limits &ImageResidency::getLimits() const
+{
+	return limits;
+}
+
+void ImageResidency::touch(uint32_t imageHash)
+{
+	entries[imageHash].lastViewed = ++viewCounter;
+}
+
+void ImageResidency::track(uint32_t imageHash)
+{
+	entries[imageHash];
+}
+
+void ImageResidency::remove(uint32_t imageHash)
+{
+	entries.erase(imageHash);
+}
+
+void ImageResidency::setUsage(uint32_t imageHash, const image::Image::MemoryUsage &usage)
+{
+	auto it = entries.find(imageHash);
+	if (it != entries.end())
+		it->second.usage = usage;
+}
+
+image::Image::MemoryUsage ImageResidency::getTotalUsage() const
+{
+	image::Image::MemoryUsage total;
+	for (const auto &it : entries)
+	{
+		total.cpuBytes += it.second.usage.cpuBytes;
+		total.gpuBytes += it.second.usage.gpuBytes;
+	}
+	return total;
+}
+
+SizeType ImageResidency::getImageCapacity() const
+{
+	image::Image::MemoryUsage total;
+	SizeType numMeasured = 0;
+	for (const auto &it : entries)
+	{
+		if (it.second.usage.cpuBytes == 0 && it.second.usage.gpuBytes == 0)
+			continue;
+
+		total.cpuBytes += it.second.usage.cpuBytes;
+		total.gpuBytes += it.second.usage.gpuBytes;
+		numMeasured++;
+	}
+
+	if (numMeasured == 0)
+		return limits.maxImages;
+
+	BigSizeType capacity = limits.maxImages;
+	if (total.cpuBytes > 0)
+		capacity = math::min(capacity, limits.cpuBytes * numMeasured / total.cpuBytes);
+	if (total.gpuBytes > 0)
+		capacity = math::min(capacity, limits.gpuBytes * numMeasured / total.gpuBytes);
+
+	return (SizeType)capacity;
+}
+
+void ImageResidency::collectEvictions(const std::vector<uint32_t> &protectedImages, std::vector<uint32_t> &outEvictions) const
+{
+	outEvictions.clear();
+
+	image::Image::MemoryUsage remaining = getTotalUsage();
+	if (remaining.cpuBytes <= limits.cpuBytes && remaining.gpuBytes <= limits.gpuBytes)
+		return;
+
+	std::vector<std::pair<uint32_t, const Entry*>> order;
+	getViewOrder(order);
+
+	for (const auto &it : order)
+	{
+		if (remaining.cpuBytes <= limits.cpuBytes && remaining.gpuBytes <= limits.gpuBytes)
+			break;
+
+		const image::Image::MemoryUsage &usage = it.second->usage;
+		if (usage.cpuBytes == 0 && usage.gpuBytes == 0)
+			continue;
+
+		if (ts::util::findIfContains(protectedImages, it.first))
+			continue;
+
+		// Evicting something that doesn't help with the budget that's over would only cost a reload
+		const bool cpuOver = remaining.cpuBytes > limits.cpuBytes;
+		const bool gpuOver = remaining.gpuBytes > limits.gpuBytes;
+		if ((!cpuOver || usage.cpuBytes == 0) && (!gpuOver || usage.gpuBytes == 0))
+			continue;
+
+		outEvictions.push_back(it.first);
+		remaining.cpuBytes -= usage.cpuBytes;
+		remaining.gpuBytes -= usage.gpuBytes;
+	}
+}
+
+void ImageResidency::collectStaleEntries(const std::vector<uint32_t> &protectedImages, std::vector<uint32_t> &outStale) const
+{
+	outStale.clear();
+
+	if (entries.size() <= limits.maxImages)
+		return;
+
+	std::vector<std::pair<uint32_t, const Entry*>> order;
+	getViewOrder(order);
+
+	SizeType numExcess = (SizeType)entries.size() - limits.maxImages;
+	for (const auto &it : order)
+	{
+		if (numExcess == 0)
+			break;
+
+		const image::Image::MemoryUsage &usage = it.second->usage;
+		if (usage.cpuBytes > 0 || usage.gpuBytes > 0)
+			continue;
+
+		if (ts::util::findIfContains(protectedImages, it.first))
+			continue;
+
+		outStale.push_back(it.first);
+		numExcess--;
+	}
+}
+
+String ImageResidency::getStats() const
+{
+	const image::Image::MemoryUsage total = getTotalUsage();
+	const double megabyte = 1024.0 * 1024.0;
+
+	return TS_WFMT("Residency: %u / %u images, CPU %.1f / %.1f MB, GPU %.1f / %.1f MB",
+		(SizeType)entries.size(), limits.maxImages,
+		total.cpuBytes / megabyte, limits.cpuBytes / megabyte,
+		total.gpuBytes / megabyte, limits.gpuBytes / megabyte
+	);
+}
+
+void ImageResidency::getViewOrder(std::vector<std::pair<uint32_t, const Entry*>> &outOrder) const
+{
+	outOrder.clear();
+	outOrder.reserve(entries.size());
+
+	for (const auto &it : entries)
+		outOrder.push_back(std::make_pair(it.first, &it.second));
+
+	std::stable_sort(outOrder.begin(), outOrder.end(),
+		[](const std::pair<uint32_t, const Entry*> &a, const std::pair<uint32_t, const Entry*> &b)
+		{
+			return a.second->lastViewed < b.second->lastViewed;
+		});
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ts/ivie/image/Image.h"
+
+TS_PACKAGE2(app, viewer)
+
+/* Bookkeeping for the memory held by the images in the viewer's image storage. Images are
+ * ordered by when they were last viewed, and when the total goes over the budget the least
+ * recently viewed images outside the prefetch window are picked for eviction.
+ *
+ * Only keeps the accounting, ViewerManager does the actual unloading.
+ */
+class ImageResidency : public lang::Noncopyable
+{
+public:
+	static const BigSizeType DefaultCpuBudget = 1024ULL * 1024 * 1024;
+	static const BigSizeType DefaultGpuBudget = 768ULL * 1024 * 1024;
+	// Unloaded images still cost a little, entries past this are dropped
+	static const SizeType DefaultMaxImages = 128;
+
+	struct Limits
+	{
+		BigSizeType cpuBytes = DefaultCpuBudget;
+		BigSizeType gpuBytes = DefaultGpuBudget;
+		SizeType maxImages = DefaultMaxImages;
+	};
+
+	ImageResidency();
+	~ImageResidency();
+
+	void setLimits(const Limits &limits);
+	const Limits &getLimits() const;
+
+	// Marks the image as the most recently viewed one
+	void touch(uint32_t imageHash);
+
+	// Adds the image as never viewed if it isn't tracked yet
+	void track(uint32_t imageHash);
+	void remove(uint32_t imageHash);
+
+	void setUsage(uint32_t imageHash, const image::Image::MemoryUsage &usage);
+	image::Image::MemoryUsage getTotalUsage() const;
+
+	/* Returns: how many images of the average size seen so far fit the budget,
+	 * the maximum number of images until any have been measured.
+	 */
+	SizeType getImageCapacity() const;
+
+	/* Picks images to evict until the rest fits the budget, least recently viewed first.
+	 * protectedImages: images in the prefetch window, never picked.
+	 */
+	void collectEvictions(const std::vector<uint32_t> &protectedImages, std::vector<uint32_t> &outEvictions) const;
+
+	/* Picks images holding no memory beyond the maximum number of entries, least recently viewed first.
+	 */
+	void collectStaleEntries(const std::vector<uint32_t> &protectedImages, std::vector<uint32_t> &outStale) const;
+
+	String getStats() const;
+
+private:
+	struct Entry
+	{
+		// Zero for images that have only been prefetched
+		uint64_t lastViewed = 0;
+		image::Image::MemoryUsage usage;
+	};
+	std::map<uint32_t, Entry> entries;
+
+	// Tracked images from the least recently viewed to the most recent
+	void getViewOrder(std::vector<std::pair<uint32_t, const Entry*>> &outOrder) const;
+
+	Limits limits;
+	uint64_t viewCounter = 0;
+};
+
+TS_END_PACKAGE2()
@@ -0,0 +1,137 @@
+#include "Precompiled.h"
+#include "PrefetchPlanner.h"
+
+TS_PACKAGE2(app, viewer)
+
+namespace
+{
+
+// Pauses longer than this end the run, the rate starts over
+const TimeSpan IdleTime = 1500_ms;
+// How much of the new interval goes into the smoothed rate
+const float RateSmoothing = 0.5f;
+// Seconds of browsing the window reaches ahead for
+const float LookaheadSeconds = 0.5f;
+// Going faster than this there's no time to go back, one image behind is enough
+const float SteadyRate = 2.f;
+
+}
+
+PrefetchPlanner::PrefetchPlanner()
+{
+}
+
+void PrefetchPlanner::recordMove(int32_t step, Time time)
+{
+	if (step == 0)
+		return;
+
+	const int32_t newDirection = step > 0 ? 1 : -1;
+	const TimeSpan interval = time - lastMoveTime;
+
+	if (direction != 0 && newDirection != direction)
+	{
+		reversed = true;
+		rate = 0.f;
+	}
+	else if (direction != 0 && interval < IdleTime)
+	{
+		const float currentRate = 1.f / math::max(interval.getSecondsAsFloat(), 0.001f);
+		rate = rate > 0.f ? math::lerp(rate, currentRate, RateSmoothing) : currentRate;
+	}
+	else
+	{
+		rate = 0.f;
+	}
+
+	direction = newDirection;
+	stride = (SizeType)std::abs(step);
+	lastMoveTime = time;
+}
+
+void PrefetchPlanner::reset()
+{
+	direction = 0;
+	stride = 1;
+	rate = 0.f;
+	reversed = false;
+}
+
+float PrefetchPlanner::getCurrentRate(Time time) const
+{
+	return time - lastMoveTime < IdleTime ? rate : 0.f;
+}
+
+void PrefetchPlanner::plan(SizeType numImages, SizeType maxImages, std::vector<int32_t> &outOffsets, Time time) const
+{
+	outOffsets.clear();
+	outOffsets.push_back(0);
+
+	std::vector<int32_t> candidates;
+
+	const int32_t forward = direction != 0 ? direction : 1;
+
+	if (stride > 1)
+	{
+		// Landing spots of the next jumps first, neighbours for stepping around once there
+		const int32_t jump = (int32_t)stride * forward;
+		candidates.push_back(jump);
+		candidates.push_back(forward);
+		for (SizeType i = 2; i <= NumStridesAhead; ++i)
+			candidates.push_back(jump * (int32_t)i);
+		candidates.push_back(-forward);
+		candidates.push_back(-jump);
+	}
+	else
+	{
+		SizeType numAhead = DefaultNumAhead;
+		SizeType numBehind = DefaultNumBehind;
+
+		if (direction != 0)
+		{
+			const float currentRate = getCurrentRate(time);
+			numAhead = math::clamp(DefaultNumAhead + (SizeType)(currentRate * LookaheadSeconds), DefaultNumAhead, MaxNumAhead);
+			numBehind = currentRate >= SteadyRate ? 1 : DefaultNumBehind;
+		}
+
+		// The image just left comes right after the next one, the rest ahead before the rest behind
+		candidates.push_back(forward);
+		candidates.push_back(-forward);
+		for (SizeType i = 2; i <= numAhead; ++i)
+			candidates.push_back(forward * (int32_t)i);
+		for (SizeType i = 2; i <= numBehind; ++i)
+			candidates.push_back(-forward * (int32_t)i);
+	}
+
+	const SizeType maxOffsets = math::min(numImages, math::max(maxImages, 1U));
+
+	std::vector<SizeType> indices(1, 0);
+	for (int32_t offset : candidates)
+	{
+		if (outOffsets.size() >= maxOffsets)
+			break;
+
+		// Small lists wrap around onto images already in the window
+		const SizeType index = (SizeType)(((int64_t)offset % (int64_t)numImages + numImages) % numImages);
+		if (std::find(indices.begin(), indices.end(), index) != indices.end())
+			continue;
+
+		indices.push_back(index);
+		outOffsets.push_back(offset);
+	}
+}
+
+bool PrefetchPlanner::consumeReversal()
+{
+	const bool result = reversed;
+	reversed = false;
+	return result;
+}
+
+String PrefetchPlanner::getStats() const
+{
+	return TS_FMT("Prefetch: direction %d, stride %u, %.1f moves/s",
+		direction, stride, getCurrentRate(Time::now()));
+}
+
+TS_END_PACKAGE2()
@@ -0,0 +1,60 @@
+#pragma once
+
+TS_PACKAGE2(app, viewer)
+
+/* Plans which images around the current one are prefetched. Navigation is tracked for its
+ * direction, rate and stride: the window reaches further ahead the faster images are flipped
+ * through, keeps a single image behind while moving steadily one way, and follows the stride
+ * of larger jumps (+10 and +20 after PageDown).
+ *
+ * Only plans the offsets, ViewerManager does the loading.
+ */
+class PrefetchPlanner
+{
+public:
+	// Window before there's any navigation to go by
+	static const SizeType DefaultNumAhead = 2;
+	static const SizeType DefaultNumBehind = 2;
+	// Furthest the window reaches ahead, before the memory budget is applied
+	static const SizeType MaxNumAhead = 8;
+	// Jumps prefetched ahead at the stride
+	static const SizeType NumStridesAhead = 2;
+
+	PrefetchPlanner();
+
+	/* Records a move from the current image.
+	 * step: signed number of images moved, larger than one for jumps like PageDown.
+	 */
+	void recordMove(int32_t step, Time time = Time::now());
+
+	// Forgets the navigation, for jumps to unrelated images
+	void reset();
+
+	/* Plans the window around the current image, most important first. The first offset is always zero.
+	 * numImages: images in the list, offsets wrapping around onto the same image are dropped.
+	 * maxImages: images the memory budget has room for, the window is cut to it.
+	 */
+	void plan(SizeType numImages, SizeType maxImages, std::vector<int32_t> &outOffsets, Time time = Time::now()) const;
+
+	/* Returns: true once after the direction has reversed, prefetches the other way are stale.
+	 */
+	bool consumeReversal();
+
+	String getStats() const;
+
+private:
+	// Moves per second the window reaches ahead for, right now
+	float getCurrentRate(Time time) const;
+
+	// 0 before any navigation
+	int32_t direction = 0;
+	SizeType stride = 1;
+
+	// Moves per second, smoothed
+	float rate = 0.f;
+	Time lastMoveTime;
+
+	bool reversed = false;
+};
+
+TS_END_PACKAGE2()
@@ -10,6 +10,7 @@
 #include "ts/thread/AbstractThreadEntry.h"
 #include "ts/thread/Thread.h"
 
+#include "ts/ivie/AppConfig.h"
 #include "ts/ivie/util/NaturalSort.h"
 #include "ts/ivie/viewer/SupportedFormats.h"
 
@@ -44,7 +45,12 @@ public:
 
 	~BackgroundImageUnloader()
 	{
-		running = false;
+		{
+			MutexGuard lock(mutex);
+			running = false;
+			condition.notifyAll();
+		}
+
 		if (thread != nullptr)
 			Thread::joinThread(thread);
 	}
@@ -55,6 +61,7 @@ public:
 			"Image hash not found in storage, don't try to unload images that aren't even loaded.");
 
 		unloadQueue[imageHash] = Time::now() + delay;
+		condition.notifyAll();
 	}
 
 	void removeFromQueue(uint32_t imageHash)
@@ -65,15 +72,36 @@ public:
 		unloadQueue.erase(imageHash);
 	}
 
+	bool isQueued(uint32_t imageHash) const
+	{
+		return unloadQueue.find(imageHash) != unloadQueue.end();
+	}
+
 	void entry()
 	{
 		while (running)
 		{
 			MutexGuard lock(mutex);
-			condition.waitFor(lock, 50_ms, [this]()
+
+			// Sleep until the earliest unload is due, queue changes wake the thread up early
+			if (unloadQueue.empty())
 			{
-				return !running;// || !unloadQueue.empty();
-			});
+				condition.wait(lock, [this]()
+				{
+					return !running || !unloadQueue.empty();
+				});
+			}
+			else
+			{
+				Time nextUnload = unloadQueue.begin()->second;
+				for (const auto &it : unloadQueue)
+					nextUnload = it.second < nextUnload ? it.second : nextUnload;
+
+				const Time now = Time::now();
+				if (nextUnload > now)
+					condition.waitFor(lock, nextUnload - now);
+			}
+
 			if (!running)
 				return;
 
@@ -85,7 +113,10 @@ public:
 			{
 				if (Time::now() >= it->second)
 				{
-					unloadables.push_back(viewerManager->imageStorage[it->first]);
+					auto image = viewerManager->imageStorage.find(it->first);
+					if (image != viewerManager->imageStorage.end())
+						unloadables.push_back(image->second);
+
 					it = unloadQueue.erase(it);
 				}
 				else
@@ -104,8 +135,6 @@ public:
 					image->unload();
 				}
 			}
-
-			Thread::sleep(10_ms);
 		}
 	}
 
@@ -113,6 +142,22 @@ public:
 
 std::atomic_bool ViewerManager::quitting = false;
 
+// How often image memory usage is checked against the residency budget
+static const TimeSpan ResidencyUpdateInterval = 250_ms;
+
+// Loaders further from the current image give way to closer ones when the workers are busy.
+// Distance is the place in the prefetch window, so the landing spot of the next jump counts as near.
+static thread::TaskPriority getLoadingPriority(SizeType distance)
+{
+	if (distance == 0)
+		return thread::Priority_High;
+	if (distance == 1)
+		return thread::Priority_Normal;
+	if (distance <= 3)
+		return thread::Priority_Low;
+	return thread::Priority_VeryLow;
+}
+
 ViewerManager::ViewerManager()
 {
 	gigaton.registerClass(this);
@@ -133,6 +178,9 @@ bool ViewerManager::initialize()
 
 	allowedExtensions = viewer::SupportedFormats::getSupportedFormatExtensions();
 
+	thumbnailCache.reset(new image::ThumbnailCache(
+		file::joinPaths(file::getExecutableDirectory(), APP_THUMBNAIL_CACHE_DIRECTORY)));
+
 	backgroundUnloader.reset(new BackgroundImageUnloader(this));
 
 	return true;
@@ -157,6 +205,8 @@ void ViewerManager::deinitialize()
 	}
 	imageStorage.clear();
 
+	thumbnailCache.reset();
+
 	alphaCheckerPatternTexture.reset();
 }
 
@@ -186,6 +236,74 @@ void ViewerManager::update(const TimeSpan deltaTime)
 
 		imageChangedSignal(currentImage);
 	}
+
+	const Time now = Time::now();
+	if (now - lastResidencyUpdate >= ResidencyUpdateInterval)
+	{
+		lastResidencyUpdate = now;
+		updateResidency();
+	}
+}
+
+void ViewerManager::setResidencyLimits(const ImageResidency::Limits &limits)
+{
+	MutexGuard lock(mutex);
+	residency.setLimits(limits);
+}
+
+ImageResidency::Limits ViewerManager::getResidencyLimits() const
+{
+	MutexGuard lock(mutex);
+	return residency.getLimits();
+}
+
+void ViewerManager::updateResidency()
+{
+	TS_ZONE();
+
+	MutexGuard lock(mutex);
+
+	for (ImageStorageList::iterator it = imageStorage.begin(); it != imageStorage.end(); ++it)
+	{
+		// Busy images keep the usage from the previous update
+		image::Image::MemoryUsage usage;
+		if (it->second != nullptr && it->second->getMemoryUsage(usage))
+			residency.setUsage(it->first, usage);
+	}
+
+	std::vector<uint32_t> evictions;
+	residency.collectEvictions(lastActiveImages, evictions);
+
+	std::vector<uint32_t> removals;
+	residency.collectStaleEntries(lastActiveImages, removals);
+
+	if (evictions.empty() && removals.empty())
+		return;
+
+	MutexGuard unloaderLock(backgroundUnloader->mutex);
+
+	for (const uint32_t imageHash : evictions)
+	{
+		SharedPointer<image::Image> &image = imageStorage[imageHash];
+		if (image != nullptr && !image->isUnloaded())
+		{
+			// Skips the delay inactive images normally get
+			backgroundUnloader->addToQueue(imageHash, TimeSpan::zero);
+			continue;
+		}
+
+		// Already unloaded, the frame cache and the thumbnail go with the image
+		removals.push_back(imageHash);
+	}
+
+	for (const uint32_t imageHash : removals)
+	{
+		if (backgroundUnloader->isQueued(imageHash))
+			continue;
+
+		imageStorage.erase(imageHash);
+		residency.remove(imageHash);
+	}
 }
 
 void ViewerManager::setPendingImage(SizeType imageIndex)
@@ -255,7 +373,7 @@ void ViewerManager::watchNotify(const std::vector<file::FileNotifyEvent> &notify
 				if (!currentFileList.empty())
 				{
 					if (current.viewerFile.filepath == notifyEvent.name)
-						jumpToImage(current.imageIndex);
+						jumpToImageUnsafe(current.imageIndex);
 					else
 						ensureImageIndexNeeded = true;
 				}
@@ -329,11 +447,11 @@ void ViewerManager::setViewerPath(const String &filepath)
 	{
 		if (file::isFile(filepath))
 		{
-			jumpToImageByFilename(filepath);
+			jumpToImageByFilenameUnsafe(filepath);
 		}
 		else if (file::isDirectory(filepath))
 		{
-			jumpToImageByDirectory(filepath);
+			jumpToImageByDirectoryUnsafe(filepath);
 		}
 		
 		return;
@@ -370,11 +488,11 @@ void ViewerManager::setViewerPath(const String &filepath)
 		action = IndexingAction_Reset;
 	}
 
-	scannerTaskId = threadScheduler->scheduleOnce(
+	scannerTaskId = threadScheduler->scheduleDetached(
 		thread::Priority_Critical,
 		TimeSpan::zero,
 		&ThisClass::updateFilelist, this, directoryPath, false, action
-	).getTaskId();
+	);
 }
 
 const String &ViewerManager::getViewerPath() const
@@ -403,17 +521,35 @@ void ViewerManager::setRecursiveScan(bool recursiveEnabled, bool immediateRescan
 
 		firstScanComplete = false;
 
-		scannerTaskId = threadScheduler->scheduleOnce(
+		scannerTaskId = threadScheduler->scheduleDetached(
 			thread::Priority_Critical,
 			TimeSpan::zero,
 			&ThisClass::updateFilelist, this, currentDirectoryPath, true, IndexingAction_KeepCurrentFile
-		).getTaskId();
+		);
 	}
 }
 
 //////////////////////////////////////////////////////
 
 void ViewerManager::jumpToImage(SizeType index)
+{
+	MutexGuard lock(mutex);
+	jumpToImageUnsafe(index);
+}
+
+void ViewerManager::jumpToImageByFilename(const String &filename)
+{
+	MutexGuard lock(mutex);
+	jumpToImageByFilenameUnsafe(filename);
+}
+
+void ViewerManager::jumpToImageByDirectory(const String &directory)
+{
+	MutexGuard lock(mutex);
+	jumpToImageByDirectoryUnsafe(directory);
+}
+
+void ViewerManager::jumpToImageUnsafe(SizeType index)
 {
 	TS_ZONE();
 
@@ -427,21 +563,24 @@ void ViewerManager::jumpToImage(SizeType index)
 // 	if (index == current.imageIndex)
 // 		return;
 
+	// Not part of any navigation the prefetch could follow
+	prefetchPlanner.reset();
+
 	setPendingImage(index);
 }
 
-void ViewerManager::jumpToImageByFilename(const String &filename)
+void ViewerManager::jumpToImageByFilenameUnsafe(const String &filename)
 {
 	const String relativePath = file::stripRootPath(filename, currentDirectoryPath);
 
 	PosType index = findFileIndexByName(relativePath, currentFileList);
 	if (index >= 0)
-		jumpToImage((SizeType)index);
+		jumpToImageUnsafe((SizeType)index);
 	else
-		jumpToImage(0);
+		jumpToImageUnsafe(0);
 }
 
-void ViewerManager::jumpToImageByDirectory(const String &filename)
+void ViewerManager::jumpToImageByDirectoryUnsafe(const String &filename)
 {
 	const String relativePath = file::stripRootPath(filename, currentDirectoryPath);
 
@@ -457,9 +596,9 @@ void ViewerManager::jumpToImageByDirectory(const String &filename)
 	}
 
 	if (index >= 0)
-		jumpToImage((SizeType)index);
+		jumpToImageUnsafe((SizeType)index);
 	else
-		jumpToImage(0);
+		jumpToImageUnsafe(0);
 }
 
 void ViewerManager::changeToNextImage()
@@ -473,6 +612,12 @@ void ViewerManager::changeToPreviousImage()
 }
 
 void ViewerManager::changeImage(int32_t amount)
+{
+	MutexGuard lock(mutex);
+	changeImageUnsafe(amount);
+}
+
+void ViewerManager::changeImageUnsafe(int32_t amount)
 {
 	if (amount == 0)
 		return;
@@ -481,8 +626,10 @@ void ViewerManager::changeImage(int32_t amount)
 	if (numImagesTotal == 0)
 		return;
 
-	SizeType index = (current.imageIndex + numImagesTotal + amount) % numImagesTotal;
-	jumpToImage(index);
+	SizeType index = (SizeType)(((int64_t)current.imageIndex + amount % (int64_t)numImagesTotal + numImagesTotal) % numImagesTotal);
+	prefetchPlanner.recordMove(amount);
+
+	setPendingImage(index);
 }
 
 bool ViewerManager::deleteCurrentImage()
@@ -577,6 +724,18 @@ const String ViewerManager::getCurrentFilepath(bool absolute) const
 	return absolute ? file::joinPaths(currentDirectoryPath, current.viewerFile.filepath) : current.viewerFile.filepath;
 }
 
+void ViewerManager::setDisplaySize(const math::VC2U &size)
+{
+	MutexGuard lock(displaySizeMutex);
+	displaySize = size;
+}
+
+math::VC2U ViewerManager::getDisplaySize() const
+{
+	MutexGuard lock(displaySizeMutex);
+	return displaySize;
+}
+
 //////////////////////////////////////////////////////
 
 void ViewerManager::setSorting(SortingStyle style, bool reversed)
@@ -611,7 +770,7 @@ bool ViewerManager::getSortingReversed() const
 
 //////////////////////////////////////////////////////
 
-const std::vector<ImageEntry> ViewerManager::getListSliceForBuffering(SizeType numForward, SizeType numBackward)
+const std::vector<ImageEntry> ViewerManager::getListSliceForBuffering(const std::vector<int32_t> &offsets)
 {
 	TS_ZONE();
 
@@ -621,31 +780,13 @@ const std::vector<ImageEntry> ViewerManager::getListSliceForBuffering(SizeType n
 	if (fileListSize == 0)
 		return result;
 
-	// Always returns the current image
-	SizeType numEntries = math::min(fileListSize, 1 + numForward + numBackward);
-	result.reserve(numEntries);
-
-	for (SizeType base = 0; base < numForward + 1; ++base)
-	{
-		SizeType index = (current.imageIndex + base) % fileListSize;
-		result.push_back(ImageEntry{ currentFileList[index].filepath, index, ImageEntry::Buffering_Forwards });
-
-		numEntries--;
-		if (numEntries == 0)
-			break;
-	}
+	result.reserve(offsets.size());
 
-	if (numEntries > 0)
+	for (int32_t offset : offsets)
 	{
-		for (SizeType base = 0; base < numBackward; ++base)
-		{
-			SizeType index = (current.imageIndex + (fileListSize - 1 - (PosType)base)) % fileListSize;
-			result.push_back(ImageEntry{ currentFileList[index].filepath, index, ImageEntry::Buffering_Backwards });
-		
-			numEntries--;
-			if (numEntries == 0)
-				break;
-		}
+		SizeType index = (SizeType)(((int64_t)current.imageIndex + offset % (int64_t)fileListSize + fileListSize) % fileListSize);
+		result.push_back(ImageEntry{ currentFileList[index].filepath, index,
+			offset >= 0 ? ImageEntry::Buffering_Forwards : ImageEntry::Buffering_Backwards });
 	}
 
 	return result;
@@ -791,11 +932,11 @@ bool ViewerManager::updateFilelist(const String directoryPath,
 
 	if (allowFullRecursive == false && scanStyle == file::FileListStyle_Files_Recursive)
 	{
-		scannerTaskId = threadScheduler->scheduleOnce(
+		scannerTaskId = threadScheduler->scheduleDetached(
 			thread::Priority_Normal,
 			TimeSpan::zero,
 			&ThisClass::updateFilelist, this, directoryPath, true, IndexingAction_KeepCurrentFile
-		).getTaskId();
+		);
 	}
 	else if (allowFullRecursive == true || scanStyle != file::FileListStyle_Files_Recursive)
 	{
@@ -901,7 +1042,7 @@ void ViewerManager::ensureImageIndex()
 		{
 			SizeType index = (SizeType)(state->imageIndex > 0 ? state->imageIndex - 1 : 0);
 			index = math::min(index, (SizeType)currentFileList.size() - 1);
-			jumpToImage(index);
+			jumpToImageUnsafe(index);
 		}
 	}
 }
@@ -923,6 +1064,8 @@ PosType ViewerManager::findFileIndexByName(const String &filepath, const std::ve
 
 String ViewerManager::getStats()
 {
+	MutexGuard lock(mutex);
+
 	std::vector<String> stats;
 
 	for (ImageStorageList::iterator it = imageStorage.begin(); it != imageStorage.end(); ++it)
@@ -933,6 +1076,16 @@ String ViewerManager::getStats()
 
 	std::sort(stats.begin(), stats.end());
 
+	stats.insert(stats.begin(), residency.getStats());
+	stats.insert(stats.begin() + 1, prefetchPlanner.getStats());
+
+	if (thumbnailCache != nullptr)
+	{
+		const image::ThumbnailCache::CacheStats cacheStats = thumbnailCache->getStats();
+		stats.insert(stats.begin() + 2, TS_FMT("Thumbnail cache: %u loaded, %u missed, %u stored",
+			cacheStats.numLoaded, cacheStats.numMissed, cacheStats.numStored));
+	}
+
 	return string::joinString(stats, "\n");
 }
 
@@ -942,6 +1095,11 @@ SharedPointer<image::Image> ViewerManager::getCurrentImage() const
 	return currentImage;
 }
 
+image::ThumbnailCache *ViewerManager::getThumbnailCache() const
+{
+	return thumbnailCache.get();
+}
+
 void ViewerManager::prepareShaders()
 {
 	{
@@ -975,8 +1133,9 @@ void ViewerManager::prepareShaders()
 		}
 	}
 
-	displayShaderFiles.insert(std::make_pair(DisplayShader_FreeImage, "shader/convert_freeimage.frag"));
-	displayShaderFiles.insert(std::make_pair(DisplayShader_Webm,      "shader/convert_webm.frag"));
+	displayShaderFiles.insert(std::make_pair(DisplayShader_FreeImage,  "shader/convert_freeimage.frag"));
+	displayShaderFiles.insert(std::make_pair(DisplayShader_Webm,       "shader/convert_webm.frag"));
+	displayShaderFiles.insert(std::make_pair(DisplayShader_WebmPlanar, "shader/convert_webm_planar.frag"));
 }
 
 SharedPointer<resource::ShaderResource> ViewerManager::loadDisplayShader(DisplayShaderTypes type)
@@ -1006,22 +1165,27 @@ void ViewerManager::updateCurrentImage(SizeType previousDirectoryHash, SizeType
 {
 	TS_ZONE();
 
-	const PosType numForwardBuffered = 2;
-	const PosType numBackwardBuffered = 2;
+	std::vector<int32_t> prefetchOffsets;
+	prefetchPlanner.plan((SizeType)currentFileList.size(), residency.getImageCapacity(), prefetchOffsets);
+
+	// Prefetches still loading the way the user came from won't be needed any time soon
+	const bool directionReversed = prefetchPlanner.consumeReversal();
 
 	std::vector<uint32_t> activeImages;
-	std::vector<ImageEntry> imagesToLoad = getListSliceForBuffering(numForwardBuffered, numBackwardBuffered);
+	std::vector<ImageEntry> imagesToLoad = getListSliceForBuffering(prefetchOffsets);
 
 	if (imagesToLoad.empty())
 		currentImage = nullptr;
 
 	// uint32_t currentImageHash = 0;
 
-	for (const ImageEntry &entry : imagesToLoad)
+	for (SizeType distance = 0; distance < imagesToLoad.size(); ++distance)
 	{
+		const ImageEntry &entry = imagesToLoad[distance];
 		uint32_t imageHash = math::hashCombine(currentDirectoryPathHash, entry.filepath);
 
 		activeImages.push_back(imageHash);
+		residency.track(imageHash);
 
 		SharedPointer<image::Image> &image = imageStorage[imageHash];
 		if (image == nullptr)
@@ -1032,11 +1196,17 @@ void ViewerManager::updateCurrentImage(SizeType previousDirectoryHash, SizeType
 
 		bool isCurrentImage = (entry.index == current.imageIndex);
 		if (isCurrentImage)
+		{
 			currentImage = image;
+			residency.touch(imageHash);
+		}
 
 		if (image->hasError())
 			continue;
 
+		// Moves loaders still waiting in the scheduler when the current image changes
+		image->setLoadingPriority(getLoadingPriority(distance));
+
 		if (image->isUnloaded())
 		{
 			image->startLoading(!isCurrentImage);
@@ -1096,8 +1266,11 @@ void ViewerManager::updateCurrentImage(SizeType previousDirectoryHash, SizeType
 			if (image->getState() == image::Image::Unloaded)
 				continue;
 
+			const bool stalePrefetch = directionReversed && image->getState() == image::Image::Loading;
+
+			// Stale prefetches are stopped at once instead of kept around for a possible return
 			image->suspendLoader();
-			backgroundUnloader->addToQueue(imageHash, 2000_ms);
+			backgroundUnloader->addToQueue(imageHash, stalePrefetch ? TimeSpan::zero : 2000_ms);
 		}
 	}
 }
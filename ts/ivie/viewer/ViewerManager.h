@@ -6,7 +6,10 @@
 #include "ts/file/FileList.h"
 #include "ts/file/FileWatcher.h"
 #include "ts/ivie/image/Image.h"
+#include "ts/ivie/image/ThumbnailCache.h"
 #include "ts/ivie/viewer/ViewerImageFile.h"
+#include "ts/ivie/viewer/ImageResidency.h"
+#include "ts/ivie/viewer/PrefetchPlanner.h"
 
 TS_PACKAGE2(app, viewer)
 
@@ -87,17 +90,29 @@ public:
 
 	const String getCurrentFilepath(bool absolute = true) const;
 
+	// Size of the area images are displayed in, loaders may decode at a lower resolution to fit it.
+	void setDisplaySize(const math::VC2U &size);
+	math::VC2U getDisplaySize() const;
+
 	SharedPointer<image::Image> getCurrentImage() const;
 
+	// Thumbnails persisted on disk, nullptr before initialization.
+	image::ThumbnailCache *getThumbnailCache() const;
+
 	enum DisplayShaderTypes
 	{
 		DisplayShader_FreeImage,
 		DisplayShader_Webm,
+		DisplayShader_WebmPlanar,
 	};
 	SharedPointer<resource::ShaderResource> loadDisplayShader(DisplayShaderTypes type);
 
 	String getStats();
 
+	// Memory budget for the images kept around, the least recently viewed ones are unloaded when over it.
+	void setResidencyLimits(const ImageResidency::Limits &limits);
+	ImageResidency::Limits getResidencyLimits() const;
+
 	// When file list changes, parameter is number of files
 	lang::Signal<SizeType> filelistChangedSignal;
 
@@ -115,6 +130,12 @@ private:
 	void applySorting(std::vector<ViewerImageFile> &filelist);
 	void ensureImageIndex();
 
+	// Same as the public ones, the caller holds the mutex
+	void jumpToImageUnsafe(SizeType index);
+	void jumpToImageByFilenameUnsafe(const String &filename);
+	void jumpToImageByDirectoryUnsafe(const String &directory);
+	void changeImageUnsafe(int32_t direction);
+
 	enum IndexingAction
 	{
 		IndexingAction_DoNothing,       // keeps current index
@@ -129,7 +150,8 @@ private:
 	bool firstScanComplete = false;
 	std::atomic_bool scanningFiles;
 
-	const std::vector<ImageEntry> getListSliceForBuffering(SizeType numForward, SizeType numBackward);
+	// Entries at the offsets from the current image, in the same order
+	const std::vector<ImageEntry> getListSliceForBuffering(const std::vector<int32_t> &offsets);
 
 	PosType findFileIndexByName(const String &filepath, const std::vector<ViewerImageFile> &filelist);
 
@@ -161,6 +183,10 @@ private:
 
 	bool pendingImageUpdate = true;
 
+	// Own lock, images read it when they start loading while the viewer lock may be held
+	math::VC2U displaySize;
+	mutable Mutex displaySizeMutex;
+
 	std::vector<ViewerImageFile> currentFileList;
 
 	SortingStyle sortingStyle = SortingStyle_ByName;
@@ -172,6 +198,16 @@ private:
 	ImageStorageList imageStorage;
 	std::vector<uint32_t> lastActiveImages;
 
+	// Decides the prefetch window from how the images are being navigated
+	PrefetchPlanner prefetchPlanner;
+
+	// Evicts images outside the prefetch window when over the memory budget
+	void updateResidency();
+	ImageResidency residency;
+	Time lastResidencyUpdate;
+
+	ScopedPointer<image::ThumbnailCache> thumbnailCache;
+
 	class BackgroundImageUnloader;
 	ScopedPointer<BackgroundImageUnloader> backgroundUnloader;
 
@@ -6,6 +6,9 @@
 
 #define TS_DEBUG_MEMORY_LEAKS TS_TRUE
 
+// Allocation benchmark replaces the global operator new to count allocations, keep off in builds that ship
+#define TS_BENCHMARK_COUNT_ALLOCATIONS TS_FALSE
+
 /************************************
 * General configuration
 */
@@ -18,5 +21,7 @@
  */
 
 #define TS_MAX_THREAD_POOL_THREAD_COUNT 4U
+// Scheduler workers keep their own task deques and steal from each other instead of sharing one queue
+#define TS_THREAD_SCHEDULER_WORK_STEALING TS_FALSE
 
 #define TS_GLOBAL_USING_SFML TS_TRUE
@@ -211,7 +211,7 @@ void ResourceManager::addResourceToLoadQueue(SharedPointer<AbstractResourceBase>
 // 		return;
 
 	thread::ThreadScheduler &tm = getGigaton<thread::ThreadScheduler>();
-	tm.scheduleOnce(thread::Priority_Normal, TimeSpan::zero, &ResourceManager::loadResourceTask, resource);
+	tm.scheduleDetached(thread::Priority_Normal, TimeSpan::zero, &ResourceManager::loadResourceTask, resource);
 }
 
 GUID ResourceManager::findFileGuid(const GUID &resourceGuid)
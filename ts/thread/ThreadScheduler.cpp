@@ -12,6 +12,8 @@ TS_DEFINE_MANAGER_TYPE(thread::ThreadScheduler);
 TS_PACKAGE1(thread)
 
 thread_local SchedulerTaskId ThreadScheduler::currentThreadTaskId = InvalidTaskId;
+thread_local ThreadScheduler *ThreadScheduler::currentThreadScheduler = nullptr;
+thread_local SizeType ThreadScheduler::currentThreadWorkerIndex = 0;
 
 class ThreadScheduler::BackgroundScheduler : public AbstractThreadEntry
 {
@@ -34,38 +36,49 @@ public:
 
 	void entry()
 	{
-		while (true)
-		{
-			MutexGuard lock(scheduler->queueMutex);
-			scheduler->schedulerCondition.waitFor(lock, 10_ms,
-			[this]()
-			{
-				return !scheduler->running || !scheduler->waitingTaskQueue.empty();
-			});
-
-			if (!scheduler->running)// && scheduler->waitingTaskQueue.empty())
-				return;
+		MutexGuard lock(scheduler->queueMutex);
 
+		while (scheduler->running)
+		{
 			if (scheduler->waitingTaskQueue.empty())
+			{
+				scheduler->schedulerCondition.wait(lock, [this]()
+				{
+					return !scheduler->running || !scheduler->waitingTaskQueue.empty();
+				});
 				continue;
+			}
 
-			if (Time::now() >= scheduler->waitingTaskQueue.top()->scheduledTime)
+			// Move every task that's due from the waiting queue to the pending queue
+			const Time now = Time::now();
+			SizeType numMoved = 0;
+			while (!scheduler->waitingTaskQueue.empty() && scheduler->waitingTaskQueue.top()->scheduledTime <= now)
 			{
-				// Move task from pending list to the active list
-				scheduler->pendingTaskQueue.push(scheduler->waitingTaskQueue.top());
+				SharedScheduledTask task = scheduler->waitingTaskQueue.top();
 				scheduler->waitingTaskQueue.pop();
 
-				lock.unlock();
+				if (scheduler->executionMode == Execution_WorkStealing)
+				{
+					// Wakes a parked worker by itself
+					task->queueState = ScheduledTask::Queue_None;
+					scheduler->makeReady(task);
+					continue;
+				}
 
-				// Notifies any waiting worker to start handling it
-				scheduler->workerCondition.notifyOne();
-			}
-			else
-			{
-				lock.unlock();
+				task->queueState = ScheduledTask::Queue_Pending;
+				task->queueHandle = scheduler->pendingTaskQueue.push(task);
+				numMoved++;
 			}
 
-			Thread::sleep(10_ms);
+			// Notifies waiting workers to start handling them
+			if (numMoved == 1)
+				scheduler->workerCondition.notifyOne();
+			else if (numMoved > 1)
+				scheduler->workerCondition.notifyAll();
+
+			// Sleeps until the next deadline, tasks due earlier than it wake the thread up
+			if (!scheduler->waitingTaskQueue.empty())
+				scheduler->schedulerCondition.waitFor(lock, scheduler->waitingTaskQueue.top()->scheduledTime - Time::now());
 		}
 	}
 };
@@ -95,6 +108,20 @@ public:
 	{
 		TS_LOG_DEBUG("BackgroundWorker %u running. Waiting for tasks...", workerIndex);
 
+		ThreadScheduler::currentThreadScheduler = scheduler;
+		ThreadScheduler::currentThreadWorkerIndex = workerIndex;
+
+		if (scheduler->executionMode == Execution_WorkStealing)
+			runWorkStealing();
+		else
+			runSharedQueue();
+
+		TS_LOG_DEBUG("Thread Worker %u quitting.", workerIndex);
+	}
+
+private:
+	void runSharedQueue()
+	{
 		while (true)
 		{
 			SharedScheduledTask task = nullptr;
@@ -111,44 +138,180 @@ public:
 
 				task = scheduler->pendingTaskQueue.top();
 				scheduler->pendingTaskQueue.pop();
-
-				scheduler->workerToTaskMap[workerIndex] = task->taskId;
+				task->queueState = ScheduledTask::Queue_None;
 			}
 			TS_ASSERT(task != nullptr);
 
-			ThreadScheduler::currentThreadTaskId = task->taskId;
+			scheduler->runTask(workerIndex, task);
+		}
+	}
+
+	void runWorkStealing()
+	{
+		// Seeds the victim selection differently for every worker, xorshift needs a nonzero state
+		uint32_t randomState = 0x9E3779B9U * (uint32_t)(workerIndex + 1);
+
+		while (scheduler->running)
+		{
+			SharedScheduledTask task = scheduler->takeReadyTask(workerIndex, randomState);
+			if (task == nullptr)
+			{
+				scheduler->parkWorker();
+				continue;
+			}
 
-			task->workedByWorkerIndex = workerIndex;
-			bool canReschedule = task->run();
-			task->workedByWorkerIndex = ScheduledTask::InvalidWorkerIndex;
+			scheduler->runTask(workerIndex, task);
+		}
+	}
+};
 
-			ThreadScheduler::currentThreadTaskId = InvalidTaskId;
+std::atomic<SchedulerTaskId> ScheduledTask::nextTaskId = 1;
+Mutex ScheduledTask::completionMutex;
+ConditionVariable ScheduledTask::completionCondition;
 
+void ScheduledTask::markCompleted()
+{
+	completed = true;
+	numCompletedRuns++;
+
+	// Pairs with the increment in waitForCompletion, either the waiter sees this run complete or this sees the waiter
+	if (numWaiters > 0)
+	{
+		MutexGuard lock(completionMutex);
+		completionCondition.notifyAll();
+	}
+}
+
+void ScheduledTask::waitForCompletion()
+{
+	// Read first, a run that completes after this was checked still ends the wait
+	const SizeType numRuns = numCompletedRuns;
+
+	if (!completed)
+	{
+		TS_PRINTF("waitForCompletion() Task ID %u : waiting\n", taskId);
+
+		numWaiters++;
+		{
+			MutexGuard lock(completionMutex);
+			completionCondition.wait(lock, [this, numRuns]()
 			{
-				MutexGuard lock(scheduler->queueMutex);
+				return numCompletedRuns != numRuns;
+			});
+		}
+		numWaiters--;
+	}
+	else
+	{
+		TS_PRINTF("waitForCompletion() Task UD %u : was already completed\n", taskId);
+	}
+}
+
+bool ScheduledTask::waitForCompletion(TimeSpan timeout)
+{
+	const SizeType numRuns = numCompletedRuns;
+	if (completed)
+		return true;
 
-				scheduler->workerToTaskMap[workerIndex] = InvalidTaskId;
+	numWaiters++;
+	bool wasCompleted = false;
+	{
+		MutexGuard lock(completionMutex);
+		wasCompleted = completionCondition.waitFor(lock, timeout, [this, numRuns]()
+		{
+			return numCompletedRuns != numRuns;
+		});
+	}
+	numWaiters--;
 
-				if (canReschedule && scheduler->cancelledTasks.count(task->taskId) == 0)
-				{
-					task->reschedule();
-					scheduler->waitingTaskQueue.push(task);
-					scheduler->schedulerCondition.notifyAll();
-				}
-				else
-				{
-					scheduler->incompleteTasks.erase(task->taskId);
-				}
+	return wasCompleted;
+}
+
+void ScheduledTask::recycle(ScheduledTask *task)
+{
+	ThreadScheduler *scheduler = task->scheduler;
+	const SchedulerTaskId taskId = task->taskId;
+
+	// Whatever the task function holds is released outside of the pool lock
+	task->~ScheduledTask();
+	scheduler->freeTask(taskId, task);
+}
+
+ThreadScheduler::TaskShard::~TaskShard()
+{
+	for (ScheduledTask *&bucket : taskBuckets)
+	{
+		while (bucket != nullptr)
+			std::exchange(bucket, bucket->nextInBucket)->releaseReference();
+	}
+}
+
+ScheduledTask *ThreadScheduler::TaskShard::findTask(SchedulerTaskId taskId) const
+{
+	if (taskBuckets.empty())
+		return nullptr;
+
+	// Ids of a shard are NumTaskShards apart, dividing spreads consecutive ones to consecutive buckets
+	ScheduledTask *task = taskBuckets[(taskId / NumTaskShards) & (taskBuckets.size() - 1)];
+	while (task != nullptr && task->taskId != taskId)
+		task = task->nextInBucket;
+	return task;
+}
+
+void ThreadScheduler::TaskShard::insertTask(ScheduledTask &task)
+{
+	TS_ASSERT(findTask(task.taskId) == nullptr && "Task is already in the shard.");
+
+	// Grows rarely and keeps the buckets, once big enough inserting never allocates
+	if (numTasks >= taskBuckets.size())
+	{
+		std::vector<ScheduledTask *> previousBuckets(math::max<SizeType>((SizeType)taskBuckets.size() * 2, 64), nullptr);
+		previousBuckets.swap(taskBuckets);
+
+		for (ScheduledTask *bucket : previousBuckets)
+		{
+			while (bucket != nullptr)
+			{
+				ScheduledTask *moved = std::exchange(bucket, bucket->nextInBucket);
+				ScheduledTask *&head = taskBuckets[(moved->taskId / NumTaskShards) & (taskBuckets.size() - 1)];
+				moved->nextInBucket = head;
+				head = moved;
 			}
 		}
-
-		TS_LOG_DEBUG("Thread Worker %u quitting.", workerIndex);
 	}
-};
 
-SchedulerTaskId ScheduledTask::nextTaskId = 1;
+	ScheduledTask *&head = taskBuckets[(task.taskId / NumTaskShards) & (taskBuckets.size() - 1)];
+	task.addReference();
+	task.nextInBucket = head;
+	head = &task;
+	numTasks++;
+}
 
-ThreadScheduler::ThreadScheduler()
+ThreadScheduler::SharedScheduledTask ThreadScheduler::TaskShard::eraseTask(SchedulerTaskId taskId)
+{
+	if (taskBuckets.empty())
+		return nullptr;
+
+	ScheduledTask **link = &taskBuckets[(taskId / NumTaskShards) & (taskBuckets.size() - 1)];
+	while (*link != nullptr && (*link)->taskId != taskId)
+		link = &(*link)->nextInBucket;
+
+	ScheduledTask *task = *link;
+	if (task == nullptr)
+		return nullptr;
+
+	*link = std::exchange(task->nextInBucket, nullptr);
+	numTasks--;
+
+	// Hands the shard's reference over to the caller
+	SharedScheduledTask erased(task);
+	task->releaseReference();
+	return erased;
+}
+
+ThreadScheduler::ThreadScheduler(ExecutionMode executionMode, SizeType numWorkers)
+	: executionMode(executionMode)
+	, numWorkersToCreate(numWorkers)
 {
 	gigaton.registerClass(this);
 }
@@ -161,9 +324,13 @@ ThreadScheduler::~ThreadScheduler()
 bool ThreadScheduler::initialize()
 {
 // 	const SizeType numWorkers = math::min(TS_MAX_THREAD_POOL_THREAD_COUNT, ThreadScheduler::numHardwareThreads());
-	const SizeType numWorkers = TS_MAX_THREAD_POOL_THREAD_COUNT;
+	const SizeType numWorkers = numWorkersToCreate;
 	createBackgroundWorkers(numWorkers);
 
+	// Hardware threads left over after the workers (and the main thread) can be lent out as helper threads
+	const SizeType numHardware = ThreadScheduler::numHardwareThreads();
+	numHelperThreadsTotal = numHardware > numWorkers + 1 ? numHardware - numWorkers - 1 : 0;
+
 	return true;
 }
 
@@ -182,7 +349,18 @@ void ThreadScheduler::createBackgroundWorkers(SizeType numWorkers)
 	backgroundScheduler.reset(new BackgroundScheduler(this));
 
 	backgroundWorkers.reserve(numWorkers);
-	workerToTaskMap.resize(numWorkers, InvalidTaskId);
+
+	workerToTaskMap = std::vector<std::atomic<SchedulerTaskId>>(numWorkers);
+	for (std::atomic<SchedulerTaskId> &taskId : workerToTaskMap)
+		taskId = InvalidTaskId;
+
+	// Workers steal from each other as soon as they start, all the deques have to exist by then
+	if (executionMode == Execution_WorkStealing)
+	{
+		workerQueues.reserve(numWorkers);
+		for (SizeType index = 0; index < numWorkers; ++index)
+			workerQueues.push_back(makeUnique<WorkerQueues>());
+	}
 
 	for (SizeType index = 0; index < numWorkers; ++index)
 	{
@@ -201,25 +379,32 @@ void ThreadScheduler::destroyBackgroundWorkers()
 	schedulerCondition.notifyAll();
 	workerCondition.notifyAll();
 
+	{
+		// Parking workers check running with the park mutex held, notifying under it can't be missed
+		MutexGuard lock(parkMutex);
+		parkCondition.notifyAll();
+	}
+
 	backgroundScheduler.reset();
 
 	for (SizeType index = 0; index < backgroundWorkers.size(); ++index)
 	{
 		backgroundWorkers[index].reset();
 	}
+
+	freeReadyTasks();
 }
 
 SizeType ThreadScheduler::getNumTasks() const
 {
 	MutexGuard lock(queueMutex);
-	return (SizeType)(waitingTaskQueue.size() + pendingTaskQueue.size());
+	return (SizeType)(waitingTaskQueue.size() + pendingTaskQueue.size() + numReadyTasks);
 }
 
 SizeType ThreadScheduler::getNumTasksInProgress() const
 {
-	MutexGuard lock(queueMutex);
 	SizeType numTasks = 0;
-	for (SchedulerTaskId id : workerToTaskMap)
+	for (const std::atomic<SchedulerTaskId> &id : workerToTaskMap)
 	{
 		if (id != InvalidTaskId)
 			numTasks++;
@@ -233,6 +418,11 @@ SizeType ThreadScheduler::getNumWorkers() const
 	return (SizeType)backgroundWorkers.size();
 }
 
+ThreadScheduler::ExecutionMode ThreadScheduler::getExecutionMode() const
+{
+	return executionMode;
+}
+
 ThreadScheduler::SchedulerStats ThreadScheduler::getStats() const
 {
 // 	MutexGuard lock(queueMutex);
@@ -240,23 +430,53 @@ ThreadScheduler::SchedulerStats ThreadScheduler::getStats() const
 
 	stats.numBackgroundWorkers = (SizeType)backgroundWorkers.size();
 	
-	stats.numQueuedTasks = (SizeType)(waitingTaskQueue.size() + pendingTaskQueue.size());
+	stats.numQueuedTasks = (SizeType)(waitingTaskQueue.size() + pendingTaskQueue.size() + numReadyTasks);
 
-	for (SchedulerTaskId id : workerToTaskMap)
+	for (const std::atomic<SchedulerTaskId> &id : workerToTaskMap)
 		stats.numWorkedTasks += (id != InvalidTaskId ? 1 : 0);
 
+	// Interval tasks in the work stealing ready queues can't be walked through, they aren't counted
 	for (auto &it : waitingTaskQueue)
 		stats.numIntervalTasks += (it->interval > TimeSpan::zero ? 1 : 0);
 	for (auto &it : pendingTaskQueue)
 		stats.numIntervalTasks += (it->interval > TimeSpan::zero ? 1 : 0);
 
+	stats.numHelperThreads = numHelperThreadsReserved;
+
+	for (const TaskShard &shard : taskShards)
+	{
+		MutexGuard lock(shard.poolMutex);
+		stats.numPooledTasks += shard.taskPool.getCapacity();
+	}
+
 	return stats;
 }
 
+SizeType ThreadScheduler::reserveHelperThreads(SizeType numRequested)
+{
+	MutexGuard lock(queueMutex);
+	const SizeType numGranted = math::min(numRequested, numHelperThreadsTotal - numHelperThreadsReserved);
+	numHelperThreadsReserved += numGranted;
+	return numGranted;
+}
+
+void ThreadScheduler::releaseHelperThreads(SizeType numThreads)
+{
+	MutexGuard lock(queueMutex);
+	TS_ASSERT(numThreads <= numHelperThreadsReserved && "Releasing more helper threads than were reserved.");
+	numHelperThreadsReserved -= math::min(numThreads, numHelperThreadsReserved);
+}
+
+SizeType ThreadScheduler::getNumAvailableHelperThreads() const
+{
+	MutexGuard lock(queueMutex);
+	return numHelperThreadsTotal - numHelperThreadsReserved;
+}
+
 bool ThreadScheduler::hasTasks() const
 {
 	MutexGuard lock(queueMutex);
-	return !waitingTaskQueue.empty() && !pendingTaskQueue.empty();
+	return !waitingTaskQueue.empty() || !pendingTaskQueue.empty() || numReadyTasks > 0;
 }
 
 // void ThreadScheduler::clearTasks()
@@ -272,74 +492,404 @@ bool ThreadScheduler::hasTasks() const
 // }
 
 bool ThreadScheduler::isTaskQueued(SchedulerTaskId taskId)
+{
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.mutex);
+
+	ScheduledTask *task = shard.findTask(taskId);
+	return task != nullptr && isTaskQueuedUnsafe(*task);
+}
+
+bool ThreadScheduler::isTaskQueuedUnsafe(ScheduledTask &task)
 {
 	MutexGuard lock(queueMutex);
-	return isTaskQueuedUnsafe(taskId);
+	return task.queueState != ScheduledTask::Queue_None || (task.readyGeneration & 1) != 0;
 }
 
-bool ThreadScheduler::isTaskQueuedUnsafe(SchedulerTaskId taskId)
+bool ThreadScheduler::eraseFromQueueUnsafe(ScheduledTask &task)
 {
-	auto pred = [taskId](const SharedScheduledTask &t)
+	MutexGuard lock(queueMutex);
+
+	bool wasErased = false;
+	switch (task.queueState)
 	{
-		return t->taskId == taskId;
-	};
+		case ScheduledTask::Queue_Waiting: wasErased = waitingTaskQueue.erase(task.queueHandle); break;
+		case ScheduledTask::Queue_Pending: wasErased = pendingTaskQueue.erase(task.queueHandle); break;
+		default: return unready(task);
+	}
 
-	return (waitingTaskQueue.find_if(pred) != waitingTaskQueue.end()) ||
-		   (pendingTaskQueue.find_if(pred) != pendingTaskQueue.end());
+	TS_ASSERT(wasErased && "Task is not where it was queued.");
+	task.queueState = ScheduledTask::Queue_None;
+	return wasErased;
 }
 
 bool ThreadScheduler::cancelTask(SchedulerTaskId taskId, bool waitCompletion)
 {
-	MutexGuard lock(queueMutex);
+	// Declared before the lock, so a task erased here is recycled after the shard is unlocked
+	SharedScheduledTask task = nullptr;
+
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.mutex);
 
-	TasksList::iterator taskIt = incompleteTasks.find(taskId);
-	if (taskIt == incompleteTasks.end())
+	task = SharedScheduledTask(shard.findTask(taskId));
+	if (task == nullptr)
 		return false;
 
-	cancelledTasks.insert(taskId);
+	shard.cancelledTasks.insert(taskId);
 
-	auto tryEraseFromQueue = [this, taskId]() -> bool
+	bool wasErased = eraseFromQueueUnsafe(*task);
+	if (wasErased)
 	{
-		const auto pred = [taskId](const SharedScheduledTask &t)
-		{
-			return t->taskId == taskId;
-		};
+		shard.eraseTask(taskId);
+	}
+	else if (waitCompletion)
+	{
+		lock.unlock();
+		task->waitForCompletion();
+	}
 
-		TaskPriorityQueue::const_iterator queueIter = waitingTaskQueue.find_if(pred);
-		if (queueIter != waitingTaskQueue.end())
-		{
-			waitingTaskQueue.erase(queueIter);
-			return true;
-		}
+	return true;
+}
 
-		queueIter = pendingTaskQueue.find_if(pred);
-		if (queueIter != pendingTaskQueue.end())
+bool ThreadScheduler::isTaskCancelled(SchedulerTaskId taskId) const
+{
+	const TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.mutex);
+	return shard.cancelledTasks.count(taskId) > 0;
+}
+
+void *ThreadScheduler::allocateTask(SchedulerTaskId taskId)
+{
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.poolMutex);
+	return shard.taskPool.allocate();
+}
+
+void ThreadScheduler::freeTask(SchedulerTaskId taskId, void *storage)
+{
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.poolMutex);
+	shard.taskPool.free(storage);
+}
+
+void ThreadScheduler::submit(SharedScheduledTask task)
+{
+	TaskShard &shard = getTaskShard(task->taskId);
+	MutexGuard lock(shard.mutex);
+
+	shard.insertTask(*task);
+	enqueueUnsafe(std::move(task));
+}
+
+void ThreadScheduler::enqueueUnsafe(SharedScheduledTask task)
+{
+	TS_ASSERT(task->queueState == ScheduledTask::Queue_None && "Task is already queued.");
+
+	if (task->scheduledTime <= Time::now())
+	{
+		if (executionMode == Execution_WorkStealing)
 		{
-			pendingTaskQueue.erase(queueIter);
-			return true;
+			makeReady(task);
+			return;
 		}
 
+		MutexGuard lock(queueMutex);
+		task->queueState = ScheduledTask::Queue_Pending;
+		task->queueHandle = pendingTaskQueue.push(task);
+		workerCondition.notifyOne();
+		return;
+	}
+
+	MutexGuard lock(queueMutex);
+
+	// Only a new earliest deadline changes how long the background scheduler sleeps
+	const bool earliest = waitingTaskQueue.empty() || task->scheduledTime < waitingTaskQueue.top()->scheduledTime;
+	task->queueState = ScheduledTask::Queue_Waiting;
+	task->queueHandle = waitingTaskQueue.push(task);
+
+	if (earliest)
+		schedulerCondition.notifyAll();
+}
+
+void ThreadScheduler::runTask(SizeType workerIndex, SharedScheduledTask task)
+{
+	workerToTaskMap[workerIndex] = task->taskId;
+	ThreadScheduler::currentThreadTaskId = task->taskId;
+
+	task->workedByWorkerIndex = workerIndex;
+	bool canReschedule = task->run();
+	task->workedByWorkerIndex = ScheduledTask::InvalidWorkerIndex;
+
+	ThreadScheduler::currentThreadTaskId = InvalidTaskId;
+	workerToTaskMap[workerIndex] = InvalidTaskId;
+
+	TaskShard &shard = getTaskShard(task->taskId);
+	MutexGuard lock(shard.mutex);
+
+	if (canReschedule && shard.cancelledTasks.count(task->taskId) == 0)
+	{
+		task->reschedule();
+		enqueueUnsafe(task);
+	}
+	else
+	{
+		// The task is recycled once the caller's reference is gone, not while the shard is locked
+		shard.eraseTask(task->taskId);
+	}
+}
+
+bool ThreadScheduler::setTaskPriority(SchedulerTaskId taskId, TaskPriority priority)
+{
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.mutex);
+
+	ScheduledTask *task = shard.findTask(taskId);
+	if (task == nullptr)
 		return false;
-	};
 
-	bool wasErased = tryEraseFromQueue();
-	if (wasErased)
+	if (task->priority == priority)
+		return true;
+
+	MutexGuard queueLock(queueMutex);
+	task->priority = priority;
+
+	// Waiting tasks are ordered by their deadline only
+	if (task->queueState == ScheduledTask::Queue_Pending)
+		pendingTaskQueue.update(task->queueHandle);
+	else if (executionMode == Execution_WorkStealing)
+		requeueReady(SharedScheduledTask(task));
+
+	return true;
+}
+
+void ThreadScheduler::makeReady(SharedScheduledTask task)
+{
+	TS_ASSERT((task->readyGeneration & 1) == 0 && "Task is already ready.");
+
+	// Counted before it's visible so the count never goes below zero
+	numReadyTasks++;
+
+	const SizeType generation = ++task->readyGeneration;
+	const TaskPriority priority = task->priority;
+	pushReady(createReadyTask(std::move(task), generation), priority);
+}
+
+bool ThreadScheduler::requeueReady(SharedScheduledTask task)
+{
+	SizeType generation = task->readyGeneration;
+	if ((generation & 1) == 0)
+		return false;
+
+	// Stays odd, a worker that got to the old entry first keeps the task
+	if (!task->readyGeneration.compare_exchange_strong(generation, generation + 2))
+		return false;
+
+	const TaskPriority priority = task->priority;
+	pushReady(createReadyTask(std::move(task), generation + 2), priority);
+	return true;
+}
+
+bool ThreadScheduler::unready(ScheduledTask &task)
+{
+	SizeType generation = task.readyGeneration;
+	if ((generation & 1) == 0)
+		return false;
+
+	// Left in its queue as a stale entry
+	if (!task.readyGeneration.compare_exchange_strong(generation, generation + 1))
+		return false;
+
+	numReadyTasks--;
+	return true;
+}
+
+void ThreadScheduler::pushReady(ReadyTask *entry, TaskPriority priority)
+{
+	if (currentThreadScheduler == this)
 	{
-		incompleteTasks.erase(taskIt);
+		workerQueues[currentThreadWorkerIndex]->deques[priority].push(entry);
 	}
-	else if (waitCompletion)
+	else
 	{
-		lock.unlock();
-		taskIt->second->waitForCompletion();
-		lock.lock();
+		MutexGuard lock(injectionMutex);
+		injectionQueues[priority].entries.push_back(entry);
+		numInjectedTasks[priority]++;
 	}
 
+	// Pairs with the fence in parkWorker, either the parking worker sees the task or this sees the worker
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (numParkedWorkers > 0)
+		wakeWorker();
+}
+
+ThreadScheduler::ReadyTask *ThreadScheduler::createReadyTask(SharedScheduledTask task, SizeType generation)
+{
+	void *storage = nullptr;
+	{
+		TaskShard &shard = getTaskShard(task->taskId);
+		MutexGuard lock(shard.poolMutex);
+		storage = shard.readyTaskPool.allocate();
+	}
+	return new (storage) ReadyTask{ std::move(task), generation };
+}
+
+void ThreadScheduler::freeReadyTask(ReadyTask *entry, SchedulerTaskId taskId)
+{
+	entry->~ReadyTask();
+
+	TaskShard &shard = getTaskShard(taskId);
+	MutexGuard lock(shard.poolMutex);
+	shard.readyTaskPool.free(entry);
+}
+
+ThreadScheduler::SharedScheduledTask ThreadScheduler::claimReadyTask(ReadyTask *entry)
+{
+	SharedScheduledTask task = std::move(entry->task);
+	SizeType generation = entry->generation;
+	freeReadyTask(entry, task->taskId);
+
+	if (!task->readyGeneration.compare_exchange_strong(generation, generation + 1))
+		return nullptr;
+
+	numReadyTasks--;
+	return task;
+}
+
+bool ThreadScheduler::popInjectedTask(SizeType priority, ReadyTask *&entry)
+{
+	if (numInjectedTasks[priority] == 0)
+		return false;
+
+	MutexGuard lock(injectionMutex);
+	InjectionQueue &queue = injectionQueues[priority];
+	if (queue.first == queue.entries.size())
+		return false;
+
+	entry = queue.entries[queue.first++];
+
+	// Moves the rest to the front once half is taken, the capacity stays for the next tasks
+	if (queue.first == queue.entries.size())
+	{
+		queue.entries.clear();
+		queue.first = 0;
+	}
+	else if (queue.first >= queue.entries.size() / 2)
+	{
+		queue.entries.erase(queue.entries.begin(), queue.entries.begin() + queue.first);
+		queue.first = 0;
+	}
+
+	numInjectedTasks[priority]--;
 	return true;
 }
 
-bool ThreadScheduler::isTaskCancelled(SchedulerTaskId taskId) const
+ThreadScheduler::SharedScheduledTask ThreadScheduler::takeReadyTask(SizeType workerIndex, uint32_t &randomState)
+{
+	const SizeType NumSearchRounds = 4;
+	const SizeType numWorkers = (SizeType)workerQueues.size();
+	WorkerQueues &ownQueues = *workerQueues[workerIndex];
+
+	for (SizeType round = 0; round < NumSearchRounds; ++round)
+	{
+		for (SizeType priority = 0; priority < NumTaskPriorities; ++priority)
+		{
+			ReadyTask *entry = nullptr;
+
+			// Own tasks first, the newest is the most likely to still be in the cache
+			while (ownQueues.deques[priority].pop(entry))
+			{
+				SharedScheduledTask task = claimReadyTask(entry);
+				if (task != nullptr)
+					return task;
+			}
+
+			while (popInjectedTask(priority, entry))
+			{
+				SharedScheduledTask task = claimReadyTask(entry);
+				if (task != nullptr)
+					return task;
+			}
+
+			// Steals the oldest tasks of the others, starting from a random one so thieves spread out
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+
+			const SizeType firstVictim = randomState % numWorkers;
+			for (SizeType offset = 0; offset < numWorkers; ++offset)
+			{
+				const SizeType victim = (firstVictim + offset) % numWorkers;
+				if (victim == workerIndex)
+					continue;
+
+				while (workerQueues[victim]->deques[priority].steal(entry))
+				{
+					SharedScheduledTask task = claimReadyTask(entry);
+					if (task != nullptr)
+						return task;
+				}
+			}
+		}
+
+		std::this_thread::yield();
+	}
+
+	return nullptr;
+}
+
+void ThreadScheduler::parkWorker()
+{
+	MutexGuard lock(parkMutex);
+
+	numParkedWorkers++;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// A task that became ready after the search ended would otherwise wait for the next push to wake someone
+	if (running && numReadyTasks == 0)
+	{
+		parkCondition.wait(lock, [this]()
+		{
+			return !running || numWakeups > 0;
+		});
+
+		if (numWakeups > 0)
+			numWakeups--;
+	}
+
+	numParkedWorkers--;
+}
+
+void ThreadScheduler::wakeWorker()
 {
-	return cancelledTasks.count(taskId) > 0;
+	MutexGuard lock(parkMutex);
+	numWakeups++;
+	parkCondition.notifyOne();
+}
+
+void ThreadScheduler::freeReadyTasks()
+{
+	ReadyTask *entry = nullptr;
+	for (UniquePointer<WorkerQueues> &queues : workerQueues)
+	{
+		for (ReadyTaskDeque &deque : queues->deques)
+		{
+			while (deque.pop(entry))
+				freeReadyTask(entry, entry->task->taskId);
+		}
+	}
+	workerQueues.clear();
+
+	for (SizeType priority = 0; priority < NumTaskPriorities; ++priority)
+	{
+		InjectionQueue &queue = injectionQueues[priority];
+		for (SizeType index = queue.first; index < queue.entries.size(); ++index)
+			freeReadyTask(queue.entries[index], queue.entries[index]->task->taskId);
+		queue.entries.clear();
+		queue.first = 0;
+		numInjectedTasks[priority] = 0;
+	}
+
+	numReadyTasks = 0;
 }
 
 void ThreadScheduler::waitUntilTaskComplete(SchedulerTaskId taskId)
@@ -347,13 +897,10 @@ void ThreadScheduler::waitUntilTaskComplete(SchedulerTaskId taskId)
 	SharedScheduledTask task = nullptr;
 
 	{
-		MutexGuard lock(queueMutex);
-
-		TasksList::iterator taskIt = incompleteTasks.find(taskId);
-		if (taskIt == incompleteTasks.end())
-			return;
+		TaskShard &shard = getTaskShard(taskId);
+		MutexGuard lock(shard.mutex);
 
-		task = taskIt->second;
+		task = SharedScheduledTask(shard.findTask(taskId));
 	}
 
 	if (task != nullptr)
@@ -364,12 +911,10 @@ SchedulerTaskId ThreadScheduler::scheduleThreadEntry(AbstractThreadEntry *entry,
 {
 	TS_ASSERT(entry != nullptr);
 
-	ScheduledTaskFuture<void> future = scheduleOnce(priority, time_from_now, [=]()
+	return scheduleDetached(priority, time_from_now, [=]()
 	{
 		entry->entry();
 	});
-
-	return future.getTaskId();
 }
 
 SizeType ThreadScheduler::numHardwareThreads()
@@ -8,6 +8,9 @@
 #include "ts/thread/MutexGuard.h"
 
 #include "ts/container/PriorityQueue.h"
+#include "ts/container/WorkStealingDeque.h"
+#include "ts/container/SlabPool.h"
+#include "ts/container/SmallFunction.h"
 
 #include <functional>
 #include <memory>
@@ -29,84 +32,9 @@ enum TaskPriority
 	Priority_VeryLow  = 4,
 };
 
-/*********************************************************
-* Scheduled task container
-*/
-
-template<class ReturnType>
-class ScheduledTaskFuture
-{
-	friend class ThreadScheduler;
-
-public:
-	ScheduledTaskFuture() = delete;
-
-	ScheduledTaskFuture(const ScheduledTaskFuture &other)
-	{
-		*this = other;
-	}
-
-	ScheduledTaskFuture &operator=(const ScheduledTaskFuture &other)
-	{
-		if (this != &other)
-		{
-			future = other.future;
-			taskId = other.taskId;
-		}
-		return *this;
-	}
-
-	ScheduledTaskFuture(ScheduledTaskFuture &&other)
-	{
-		*this = std::move(other);
-	}
-
-	ScheduledTaskFuture &operator=(ScheduledTaskFuture &&other)
-	{
-		if (this != &other)
-		{
-			future = std::move(other.future);
-			taskId = other.taskId;
-			other.taskId = InvalidTaskId;
-		}
-		return *this;
-	}
-
-	ScheduledTaskFuture(std::future<ReturnType> &&future)
-		: future(std::move(future))
-		, taskId(InvalidTaskId)
-	{
-	}
-
-	ReturnType getResult() const
-	{
-		return future.get();
-	}
+static const SizeType NumTaskPriorities = Priority_VeryLow + 1;
 
-	bool isValid() const
-	{
-		return future.valid();
-	}
-
-	void wait() const
-	{
-		future.wait();
-	}
-
-	std::future_status waitFor(TimeSpan waitTime) const
-	{
-		return future.wait_for(std::chrono::microseconds(waitTime.getMicroseconds()));
-	}
-
-	SchedulerTaskId getTaskId() const
-	{
-		return taskId;
-	}
-
-private:
-	std::shared_future<ReturnType> future;
-	SchedulerTaskId taskId = InvalidTaskId;
-};
+class ThreadScheduler;
 
 /*********************************************************
  * Scheduled task container
@@ -115,29 +43,27 @@ private:
 struct ScheduledTask
 {
 	friend class ThreadScheduler;
+	friend class ScheduledTaskPointer;
+	friend struct ScheduledTaskDeadlineSorter;
+	template<class ReturnType>
+	friend class ScheduledTaskFuture;
+
+	// Callables up to this size are kept in the task without a heap allocation
+	static const SizeType InlineFunctionSize = 96;
+	typedef util::SmallFunction<bool(), InlineFunctionSize> TaskFunction;
 
 	ScheduledTask() = delete;
 
-	ScheduledTask(TaskPriority priority, Time time, std::function<bool()> &&task)
+	template<class Function>
+	ScheduledTask(ThreadScheduler *scheduler, SchedulerTaskId taskId, TaskPriority priority, Time time, TimeSpan interval, Function &&task)
 		: initialized(true)
-		, taskId(ScheduledTask::nextTaskId++)
+		, scheduler(scheduler)
+		, taskId(taskId)
 		, priority(priority)
 		, scheduledTime(time)
-		, interval(TimeSpan::zero)
-		, task(std::move(task))
-	{
-		future = promise.get_future();
-	}
-
-	ScheduledTask(TaskPriority priority, TimeSpan interval, bool startImmediately, std::function<bool()> &&task)
-		: initialized(true)
-		, taskId(ScheduledTask::nextTaskId++)
-		, priority(priority)
-		, scheduledTime(startImmediately ? Time::now() : Time::now() + interval)
 		, interval(interval)
-		, task(std::move(task))
+		, task(std::forward<Function>(task))
 	{
-		future = promise.get_future();
 	}
 
 	// Non-copyable
@@ -166,9 +92,8 @@ private:
 		TS_ASSERT(isValid() && "Trying to run an invalid/uninitialized task.");
 		TS_ASSERT(completed == false && "Trying to run already completed.");
 
-		bool reschedulable = std::invoke(task) && (interval > TimeSpan::zero);
-		promise.set_value();
-		completed = true;
+		bool reschedulable = task() && (interval > TimeSpan::zero);
+		markCompleted();
 
 		return reschedulable;
 	}
@@ -179,28 +104,38 @@ private:
 		TS_ASSERT(interval > TimeSpan::zero && "Task with zero interval is not valid for rescheduling.");
 
 		scheduledTime = Time::now() + interval;
+		completed = false;
+	}
 
-		promise = std::promise<void>();
-		future = promise.get_future();
+	void markCompleted();
 
-		completed = false;
+	// Blocks until the task completes, an interval task that already ran waits for its next run
+	void waitForCompletion();
+	// Returns false if the timeout expired before the task completed
+	bool waitForCompletion(TimeSpan timeout);
+
+	void addReference()
+	{
+		refcount.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	void waitForCompletion()
+	void releaseReference()
 	{
-		if (!completed)
-		{
-			TS_PRINTF("waitForCompletion() Task ID %u : waiting\n", taskId);
-			future.wait();
-		}
-		else
-		{
-			TS_PRINTF("waitForCompletion() Task UD %u : was already completed\n", taskId);
-		}
+		if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			recycle(this);
 	}
 
+	// Destroys the task and gives its storage back to the scheduler's pool
+	static void recycle(ScheduledTask *task);
+
 	bool initialized = false;
-	bool completed = false;
+	std::atomic_bool completed = false;
+
+	// Held by the scheduler until the task is complete and by the futures of the task
+	std::atomic<int32_t> refcount = 0;
+	ThreadScheduler *scheduler = nullptr;
+	// Next task in the same bucket of the scheduler's task table
+	ScheduledTask *nextInBucket = nullptr;
 
 	SchedulerTaskId taskId = InvalidTaskId;
 
@@ -208,31 +143,215 @@ private:
 	Time scheduledTime;
 	TimeSpan interval;
 
-	std::function<bool()> task;
+	TaskFunction task;
 
-	std::promise<void> promise;
-	std::future<void> future;
+	// Waiters sleep on the shared condition, completing tasks only notify it if someone waits for them
+	std::atomic<SizeType> numCompletedRuns = 0;
+	std::atomic<SizeType> numWaiters = 0;
+	static Mutex completionMutex;
+	static ConditionVariable completionCondition;
 
 	static const SizeType InvalidWorkerIndex = ~0U;
 	std::atomic<SizeType> workedByWorkerIndex = InvalidWorkerIndex;
 
-	static SchedulerTaskId nextTaskId;
+	// Queue the task is in and its handle there, so it can be found without searching
+	enum QueueState
+	{
+		Queue_None,
+		Queue_Waiting,
+		Queue_Pending,
+	};
+	QueueState queueState = Queue_None;
+	BigSizeType queueHandle = ~0ULL;
+
+	// Work stealing mode, odd while the task sits in a ready queue. Queue entries remember the generation
+	// they were made with, whoever moves it on from that generation owns the task and older entries are stale.
+	std::atomic<SizeType> readyGeneration = 0;
+
+	static std::atomic<SchedulerTaskId> nextTaskId;
 };
 
-struct ScheduledTaskSharedPointerSorter
+// Reference counted pointer to a pooled task, the task is recycled when the last reference is gone
+class ScheduledTaskPointer
 {
-	bool operator()(const SharedPointer<ScheduledTask> &lhs, const SharedPointer<ScheduledTask> &rhs)
+public:
+	ScheduledTaskPointer() = default;
+
+	ScheduledTaskPointer(std::nullptr_t)
+	{
+	}
+
+	explicit ScheduledTaskPointer(ScheduledTask *task)
+		: task(task)
+	{
+		if (task != nullptr)
+			task->addReference();
+	}
+
+	~ScheduledTaskPointer()
+	{
+		reset();
+	}
+
+	ScheduledTaskPointer(const ScheduledTaskPointer &other)
+		: ScheduledTaskPointer(other.task)
+	{
+	}
+
+	ScheduledTaskPointer &operator=(const ScheduledTaskPointer &other)
+	{
+		if (this != &other)
+		{
+			if (other.task != nullptr)
+				other.task->addReference();
+			reset();
+			task = other.task;
+		}
+		return *this;
+	}
+
+	ScheduledTaskPointer(ScheduledTaskPointer &&other) noexcept
+		: task(std::exchange(other.task, nullptr))
+	{
+	}
+
+	ScheduledTaskPointer &operator=(ScheduledTaskPointer &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			task = std::exchange(other.task, nullptr);
+		}
+		return *this;
+	}
+
+	void reset()
+	{
+		if (task != nullptr)
+			std::exchange(task, nullptr)->releaseReference();
+	}
+
+	ScheduledTask *get() const { return task; }
+	ScheduledTask *operator->() const { return task; }
+	ScheduledTask &operator*() const { return *task; }
+
+	explicit operator bool() const { return task != nullptr; }
+	bool operator==(std::nullptr_t) const { return task == nullptr; }
+	bool operator!=(std::nullptr_t) const { return task != nullptr; }
+	bool operator==(const ScheduledTaskPointer &other) const { return task == other.task; }
+	bool operator!=(const ScheduledTaskPointer &other) const { return task != other.task; }
+
+private:
+	ScheduledTask *task = nullptr;
+};
+
+struct ScheduledTaskPointerSorter
+{
+	bool operator()(const ScheduledTaskPointer &lhs, const ScheduledTaskPointer &rhs)
 	{
 		return *lhs < *rhs;
 	}
 };
 
+// Orders waiting tasks by when they're due, the earliest deadline first
+struct ScheduledTaskDeadlineSorter
+{
+	bool operator()(const ScheduledTaskPointer &lhs, const ScheduledTaskPointer &rhs)
+	{
+		return lhs->scheduledTime < rhs->scheduledTime ||
+			(lhs->scheduledTime == rhs->scheduledTime && lhs->taskId < rhs->taskId);
+	}
+};
+
+/*********************************************************
+ * Scheduled task future
+ */
+
+/* Waits on the task itself, so a future of a task without a return value costs nothing extra.
+ * Tasks returning a value keep it in a shared future, the only thing allocated for a future.
+ * A future must not outlive its scheduler.
+ */
+template<class ReturnType>
+class ScheduledTaskFuture
+{
+	friend class ThreadScheduler;
+
+public:
+	ScheduledTaskFuture() = delete;
+
+	ScheduledTaskFuture(const ScheduledTaskFuture &other) = default;
+	ScheduledTaskFuture &operator=(const ScheduledTaskFuture &other) = default;
+
+	ScheduledTaskFuture(ScheduledTaskFuture &&other) = default;
+	ScheduledTaskFuture &operator=(ScheduledTaskFuture &&other) = default;
+
+	ReturnType getResult() const
+	{
+		if constexpr (std::is_void<ReturnType>::value)
+			wait();
+		else
+			return result.get();
+	}
+
+	bool isValid() const
+	{
+		return task != nullptr;
+	}
+
+	void wait() const
+	{
+		TS_ASSERT(isValid() && "Waiting on a task that was never scheduled.");
+		task->waitForCompletion();
+	}
+
+	std::future_status waitFor(TimeSpan waitTime) const
+	{
+		TS_ASSERT(isValid() && "Waiting on a task that was never scheduled.");
+		return task->waitForCompletion(waitTime) ? std::future_status::ready : std::future_status::timeout;
+	}
+
+	SchedulerTaskId getTaskId() const
+	{
+		return task != nullptr ? task->taskId : InvalidTaskId;
+	}
+
+private:
+	ScheduledTaskFuture(ScheduledTaskPointer task, std::shared_future<ReturnType> result)
+		: task(std::move(task))
+		, result(std::move(result))
+	{
+	}
+
+	ScheduledTaskPointer task;
+	// Empty for tasks without a return value
+	std::shared_future<ReturnType> result;
+};
+
 class ThreadScheduler : public engine::system::AbstractManagerBase
 {
 	TS_DECLARE_MANAGER_TYPE(thread::ThreadScheduler);
 
 public:
-	ThreadScheduler();
+	/*  Shared queue:   Workers take tasks from one priority queue guarded by the queue mutex.
+	 *
+	 *  Work stealing:  Each worker has its own lock-free deques, one per priority. Tasks scheduled from
+	 *                  a worker go to its own deques, others to a shared injection queue. Idle workers
+	 *                  steal from random other workers and park when there's nothing left anywhere.
+	 *                  Tasks are taken in priority order, within a priority the order is approximate.
+	 */
+	enum ExecutionMode
+	{
+		Execution_SharedQueue,
+		Execution_WorkStealing,
+	};
+
+#if TS_THREAD_SCHEDULER_WORK_STEALING == TS_TRUE
+	static const ExecutionMode DefaultExecutionMode = Execution_WorkStealing;
+#else
+	static const ExecutionMode DefaultExecutionMode = Execution_SharedQueue;
+#endif
+
+	ThreadScheduler(ExecutionMode executionMode = DefaultExecutionMode, SizeType numWorkers = TS_MAX_THREAD_POOL_THREAD_COUNT);
 	virtual ~ThreadScheduler();
 
 	virtual bool initialize() override;
@@ -242,6 +361,7 @@ public:
 	SizeType getNumTasks() const;
 	SizeType getNumTasksInProgress() const;
 	SizeType getNumWorkers() const;
+	ExecutionMode getExecutionMode() const;
 
 	struct SchedulerStats
 	{
@@ -249,9 +369,21 @@ public:
 		SizeType numQueuedTasks = 0;
 		SizeType numWorkedTasks = 0;
 		SizeType numIntervalTasks = 0;
+		SizeType numHelperThreads = 0;
+		// Task records allocated by the pools, both in use and free for reuse
+		SizeType numPooledTasks = 0;
 	};
 	SchedulerStats getStats() const;
 
+	/* Helper threads are threads started by libraries outside of the scheduler, e.g. a video
+	 * decoder's own thread pool. Reserving them from the hardware threads not already taken by
+	 * the workers keeps the machine from being oversubscribed, so the workers aren't starved.
+	 * Returns: number of threads granted, may be less than requested or zero.
+	 */
+	SizeType reserveHelperThreads(SizeType numRequested);
+	void releaseHelperThreads(SizeType numThreads);
+	SizeType getNumAvailableHelperThreads() const;
+
 	// Returns true if the task is currently in the queue (waiting or pending)
 	bool isTaskQueued(SchedulerTaskId taskId);
 
@@ -259,6 +391,10 @@ public:
 	bool cancelTask(SchedulerTaskId taskId, bool waitCompletion);
 	bool isTaskCancelled(SchedulerTaskId taskId) const;
 
+	// Returns true if the task was found. A queued task moves to its place for the new priority,
+	// a task being worked on keeps running and interval tasks get the priority for their next run.
+	bool setTaskPriority(SchedulerTaskId taskId, TaskPriority priority);
+
 	// Blocks until given task id is complete (returns immediately if task wasn't found)
 	// Can't be used with interval tasks.
 	void waitUntilTaskComplete(SchedulerTaskId taskId);
@@ -274,6 +410,9 @@ public:
 	 *  Schedule once:          A task is executed only once, after the given timeout has expired.
 	 *                          The task function is allowed to return a value via the task future.
 	 *
+	 *  Schedule detached:      Same as schedule once, but only the task id is returned. Use it when
+	 *                          the result isn't needed, nothing is allocated for a future then.
+	 *
 	 *  Schedule with interval: A task is executed with a set interval, until cancelled by cancelTask
 	 *                          or the task method returns false on completion.
 	 *                          The task function cannot return a value via a task future.
@@ -302,6 +441,20 @@ public:
 		TimeSpan time_from_now,
 		ReturnType(Class::*taskFunction)(Args...), Class *instance, Args&&... args);
 
+	// For passing in function pointers and lambda functions
+	template<class Function, class... Args>
+	SchedulerTaskId scheduleDetached(
+		TaskPriority priority,
+		TimeSpan time_from_now,
+		Function &&f, Args&&... args);
+
+	// For passing in instanced class methods
+	template<class ReturnType, class Class, class... Args>
+	SchedulerTaskId scheduleDetached(
+		TaskPriority priority,
+		TimeSpan time_from_now,
+		ReturnType(Class::*taskFunction)(Args...), Class *instance, Args&&... args);
+
 	// For passing in function pointers and lambda functions
 	template<class Function, class... Args>
 	SchedulerTaskId scheduleWithInterval(
@@ -325,37 +478,152 @@ public:
 
 private:
 	static thread_local SchedulerTaskId currentThreadTaskId;
+	// Scheduler and worker index of the current thread if it's a background worker
+	static thread_local ThreadScheduler *currentThreadScheduler;
+	static thread_local SizeType currentThreadWorkerIndex;
 
 	void createBackgroundWorkers(SizeType numWorkers);
 	void destroyBackgroundWorkers();
 
-	bool isTaskQueuedUnsafe(SchedulerTaskId taskId);
+	const ExecutionMode executionMode;
+	const SizeType numWorkersToCreate;
+
+	friend struct ScheduledTask;
+
+	typedef ScheduledTaskPointer SharedScheduledTask;
+	typedef util::PriorityQueue<SharedScheduledTask, ScheduledTaskPointerSorter> TaskPriorityQueue;
+	typedef util::PriorityQueue<SharedScheduledTask, ScheduledTaskDeadlineSorter> TaskDeadlineQueue;
+
+	// Work stealing mode, an entry in a ready queue
+	struct ReadyTask
+	{
+		SharedScheduledTask task;
+		SizeType generation;
+	};
+
+	// Holder for all incomplete tasks, split by task id so workers finishing tasks
+	// and callers looking tasks up rarely wait for each other. Lock a shard before the queue mutex.
+	struct TaskShard
+	{
+		~TaskShard();
+
+		// Tasks and ready queue entries of the shard's task ids are recycled from any thread,
+		// the pools have a lock of their own that's never held while taking another.
+		mutable Mutex poolMutex;
+		util::SlabPool<ScheduledTask> taskPool;
+		util::SlabPool<ReadyTask> readyTaskPool;
+
+		mutable Mutex mutex;
+		// Incomplete tasks hashed by id, chained through the tasks. The shard holds a reference to each.
+		std::vector<ScheduledTask *> taskBuckets;
+		SizeType numTasks = 0;
+		// Keeps note of any task that was cancelled, important for interval tasks to prevent rescheduling.
+		std::set<SchedulerTaskId> cancelledTasks;
+
+		ScheduledTask *findTask(SchedulerTaskId taskId) const;
+		void insertTask(ScheduledTask &task);
+		// Returns the task that was removed, null if it wasn't found
+		SharedScheduledTask eraseTask(SchedulerTaskId taskId);
+	};
+	static const SizeType NumTaskShards = 16;
+	TaskShard taskShards[NumTaskShards];
 
-	typedef SharedPointer<ScheduledTask> SharedScheduledTask;
-	typedef util::PriorityQueue<SharedScheduledTask, ScheduledTaskSharedPointerSorter> TaskPriorityQueue;
+	TaskShard &getTaskShard(SchedulerTaskId taskId) { return taskShards[taskId % NumTaskShards]; }
+	const TaskShard &getTaskShard(SchedulerTaskId taskId) const { return taskShards[taskId % NumTaskShards]; }
 
-	// Holder for all incomplete tasks
-	typedef std::map<SchedulerTaskId, SharedScheduledTask> TasksList;
-	TasksList incompleteTasks;
+	// Must be called with the task's shard locked
+	bool isTaskQueuedUnsafe(ScheduledTask &task);
+	// Takes the task out of the queue it's in using its handle. Must be called with the task's shard locked.
+	bool eraseFromQueueUnsafe(ScheduledTask &task);
 
 	// Queue for waiting tasks, i.e. ones where scheduled time has not yet passed.
-	TaskPriorityQueue waitingTaskQueue;
+	// Sorted by deadline, the background scheduler sleeps until the first one is due.
+	TaskDeadlineQueue waitingTaskQueue;
 	// Queue for pending tasks, i.e. tasks that are ready for execution
 	// and a worker can start processing whenever able.
 	TaskPriorityQueue pendingTaskQueue;
 
-	// Keeps note of any task that was cancelled, important for interval tasks to prevent rescheduling.
-	std::set<SchedulerTaskId> cancelledTasks;
-
 	// Matches worker ids to actively worked tasks
-	std::vector<SchedulerTaskId> workerToTaskMap;
+	std::vector<std::atomic<SchedulerTaskId>> workerToTaskMap;
+
+	// Constructs the task in storage from its shard's pool
+	template<class Function>
+	SharedScheduledTask createTask(TaskPriority priority, Time scheduledTime, TimeSpan interval, Function &&function);
+	void *allocateTask(SchedulerTaskId taskId);
+	void freeTask(SchedulerTaskId taskId, void *storage);
+
+	// Adds the task to its shard and queues it
+	void submit(SharedScheduledTask task);
+
+	// Tasks already due go straight to the workers, the rest wait for the background scheduler.
+	// Must be called with the task's shard locked.
+	void enqueueUnsafe(SharedScheduledTask task);
 
-	template <class ReturnType>
+	// Runs a task taken from a queue and either reschedules or forgets it
+	void runTask(SizeType workerIndex, SharedScheduledTask task);
+
+	/* Work stealing mode */
+
+	typedef util::WorkStealingDeque<ReadyTask *> ReadyTaskDeque;
+
+	struct WorkerQueues
+	{
+		ReadyTaskDeque deques[NumTaskPriorities];
+	};
+	std::vector<UniquePointer<WorkerQueues>> workerQueues;
+
+	// Tasks that became ready outside of the workers, taken in the order they came.
+	// Taken entries are compacted away instead of freed, a steady stream of tasks doesn't allocate.
+	struct InjectionQueue
+	{
+		std::vector<ReadyTask *> entries;
+		SizeType first = 0;
+	};
+	InjectionQueue injectionQueues[NumTaskPriorities];
+	std::atomic<SizeType> numInjectedTasks[NumTaskPriorities] = {};
+	Mutex injectionMutex;
+
+	// Tasks in the ready queues that no worker has taken yet
+	std::atomic<SizeType> numReadyTasks = 0;
+
+	// Puts a due task in a ready queue
+	void makeReady(SharedScheduledTask task);
+	// Gives the task a new entry for its current priority, the old entry becomes stale
+	bool requeueReady(SharedScheduledTask task);
+	// Takes the task out of the ready queues by making its entry stale
+	bool unready(ScheduledTask &task);
+	void pushReady(ReadyTask *entry, TaskPriority priority);
+
+	ReadyTask *createReadyTask(SharedScheduledTask task, SizeType generation);
+	void freeReadyTask(ReadyTask *entry, SchedulerTaskId taskId);
+
+	// Returns nullptr if no ready task was found after a few rounds of looking
+	SharedScheduledTask takeReadyTask(SizeType workerIndex, uint32_t &randomState);
+	// Frees the entry, returns the task if the entry wasn't stale
+	SharedScheduledTask claimReadyTask(ReadyTask *entry);
+	bool popInjectedTask(SizeType priority, ReadyTask *&entry);
+	void freeReadyTasks();
+
+	// Parked workers sleep until a task becomes ready or the scheduler stops
+	void parkWorker();
+	void wakeWorker();
+
+	std::atomic<SizeType> numParkedWorkers = 0;
+	SizeType numWakeups = 0;
+	Mutex parkMutex;
+	ConditionVariable parkCondition;
+
+	template <class ReturnType, class Function>
 	ScheduledTaskFuture<ReturnType> scheduleOnceImpl(
-		TaskPriority priority, TimeSpan time_from_now, std::function<ReturnType()> &&f);
+		TaskPriority priority, TimeSpan time_from_now, Function &&f);
+
+	template <class Function>
+	SchedulerTaskId scheduleDetachedImpl(
+		TaskPriority priority, TimeSpan time_from_now, Function &&f);
 
+	template <class Function>
 	SchedulerTaskId scheduleWithIntervalImpl(
-		TaskPriority priority, TimeSpan interval, bool startImmediately, std::function<bool()> &&f);
+		TaskPriority priority, TimeSpan interval, bool startImmediately, Function &&f);
 
 	class BackgroundScheduler;
 	friend class BackgroundScheduler;
@@ -367,11 +635,27 @@ private:
 
 	std::atomic_bool running = false;
 
+	SizeType numHelperThreadsTotal = 0;
+	SizeType numHelperThreadsReserved = 0;
+
 	ConditionVariable schedulerCondition;
 	ConditionVariable workerCondition;
 	mutable Mutex queueMutex;
 };
 
+template<class Function>
+ThreadScheduler::SharedScheduledTask ThreadScheduler::createTask(
+	TaskPriority priority,
+	Time scheduledTime,
+	TimeSpan interval,
+	Function &&function)
+{
+	const SchedulerTaskId taskId = ScheduledTask::nextTaskId++;
+	void *storage = allocateTask(taskId);
+	return SharedScheduledTask(new (storage) ScheduledTask(
+		this, taskId, priority, scheduledTime, interval, std::forward<Function>(function)));
+}
+
 template<class Function, class... Args>
 ScheduledTaskFuture<typename std::result_of<Function(Args...)>::type> ThreadScheduler::scheduleOnce(
 	TaskPriority priority,
@@ -383,7 +667,7 @@ ScheduledTaskFuture<typename std::result_of<Function(Args...)>::type> ThreadSche
 	return scheduleOnceImpl<ReturnType>(
 		priority,
 		time_from_now,
-		std::move(std::bind(std::forward<Function>(taskFunction), std::forward<Args>(args)...))
+		std::bind(std::forward<Function>(taskFunction), std::forward<Args>(args)...)
 	);
 }
 
@@ -396,42 +680,115 @@ ScheduledTaskFuture<ReturnType> ThreadScheduler::scheduleOnce(
 	return scheduleOnceImpl<ReturnType>(
 		priority,
 		time_from_now,
-		std::move(std::bind(taskFunction, instance, std::forward<Args>(args)...))
+		std::bind(taskFunction, instance, std::forward<Args>(args)...)
 	);
 }
 
-template <class ReturnType>
+template <class ReturnType, class Function>
 ScheduledTaskFuture<ReturnType> ThreadScheduler::scheduleOnceImpl(
 	TaskPriority priority,
 	TimeSpan time_from_now,
-	std::function<ReturnType()> &&function)
+	Function &&function)
 {
-	SharedPointer<std::packaged_task<ReturnType()>> packagedTask =
-		makeShared<std::packaged_task<ReturnType()>>(function);
+	if (!running)
+		return ScheduledTaskFuture<ReturnType>(nullptr, std::shared_future<ReturnType>());
 
-	ScheduledTaskFuture<ReturnType> future = packagedTask->get_future();
-	if (running)
+	if constexpr (std::is_void<ReturnType>::value)
 	{
-// 		ScheduledTask task(priority, Time::now() + time_from_now, [packagedTask]()
-		SharedScheduledTask task = makeShared<ScheduledTask>(
+		// Completion is tracked by the task itself, the future only needs a reference to it
+		SharedScheduledTask task = createTask(
 			priority,
 			Time::now() + time_from_now,
-			[packagedTask]()
+			TimeSpan::zero,
+			[function = std::move(function)]() mutable
 			{
-				std::invoke(*packagedTask);
+				function();
 				return false; // Schedule once task is not reschedulable
 			}
 		);
 
-		MutexGuard lock(queueMutex);
-		future.taskId = task->taskId;
-		incompleteTasks.insert(std::make_pair(task->taskId, task));
-		waitingTaskQueue.push(task);
+		submit(task);
+		return ScheduledTaskFuture<ReturnType>(std::move(task), std::shared_future<ReturnType>());
 	}
+	else
+	{
+		std::promise<ReturnType> promise;
+		std::shared_future<ReturnType> result = promise.get_future().share();
 
-	schedulerCondition.notifyAll();
+		SharedScheduledTask task = createTask(
+			priority,
+			Time::now() + time_from_now,
+			TimeSpan::zero,
+			[function = std::move(function), promise = std::move(promise)]() mutable
+			{
+				try
+				{
+					promise.set_value(function());
+				}
+				catch (...)
+				{
+					promise.set_exception(std::current_exception());
+				}
+				return false; // Schedule once task is not reschedulable
+			}
+		);
 
-	return future;
+		submit(task);
+		return ScheduledTaskFuture<ReturnType>(std::move(task), std::move(result));
+	}
+}
+
+template<class Function, class... Args>
+SchedulerTaskId ThreadScheduler::scheduleDetached(
+	TaskPriority priority,
+	TimeSpan time_from_now,
+	Function &&taskFunction, Args&&... args)
+{
+	return scheduleDetachedImpl(
+		priority,
+		time_from_now,
+		std::bind(std::forward<Function>(taskFunction), std::forward<Args>(args)...)
+	);
+}
+
+template<class ReturnType, class Class, class... Args>
+SchedulerTaskId ThreadScheduler::scheduleDetached(
+	TaskPriority priority,
+	TimeSpan time_from_now,
+	ReturnType(Class::*taskFunction)(Args...), Class *instance, Args&&... args)
+{
+	return scheduleDetachedImpl(
+		priority,
+		time_from_now,
+		std::bind(taskFunction, instance, std::forward<Args>(args)...)
+	);
+}
+
+template <class Function>
+SchedulerTaskId ThreadScheduler::scheduleDetachedImpl(
+	TaskPriority priority,
+	TimeSpan time_from_now,
+	Function &&function)
+{
+	if (!running)
+		return InvalidTaskId;
+
+	SharedScheduledTask task = createTask(
+		priority,
+		Time::now() + time_from_now,
+		TimeSpan::zero,
+		[function = std::move(function)]() mutable
+		{
+			function();
+			return false; // Schedule once task is not reschedulable
+		}
+	);
+
+	// Read before submitting, the task may be complete and recycled by the time submit returns
+	const SchedulerTaskId createdTaskId = task->taskId;
+	submit(std::move(task));
+
+	return createdTaskId;
 }
 
 template<class Function, class... Args>
@@ -447,7 +804,7 @@ SchedulerTaskId ThreadScheduler::scheduleWithInterval(
 		priority,
 		interval,
 		startImmediately,
-		std::move(std::bind(std::forward<Function>(taskFunction), std::forward<Args>(args)...))
+		std::bind(std::forward<Function>(taskFunction), std::forward<Args>(args)...)
 	);
 }
 
@@ -457,45 +814,33 @@ SchedulerTaskId ts::thread::ThreadScheduler::scheduleWithInterval(
 	TimeSpan interval, bool startImmediately,
 	bool(Class::*taskFunction)(Args...), Class *instance, Args&&... args)
 {
-	std::function<bool()> bound = std::bind(taskFunction, instance, std::forward<Args>(args)...);
 	return scheduleWithIntervalImpl(
 		priority,
 		interval,
 		startImmediately,
-		std::move(std::bind(taskFunction, instance, std::forward<Args>(args)...))
+		std::bind(taskFunction, instance, std::forward<Args>(args)...)
 	);
 }
 
-inline SchedulerTaskId ThreadScheduler::scheduleWithIntervalImpl(
+template <class Function>
+SchedulerTaskId ThreadScheduler::scheduleWithIntervalImpl(
 	TaskPriority priority,
 	TimeSpan interval, bool startImmediately,
-	std::function<bool()> &&function)
+	Function &&function)
 {
-	SharedPointer<std::function<bool()>> sharedTask =
-		makeShared<std::function<bool()>>(std::move(function));
-
-	SchedulerTaskId createdTaskId = InvalidTaskId;
-	if (running)
-	{
-// 		ScheduledTask task(priority, interval, [sharedTask]()
-		SharedScheduledTask task = makeShared<ScheduledTask>(
-			priority,
-			interval,
-			startImmediately,
-			[sharedTask]()
-			{
-				// Task return value determines if it will be rescheduled
-				return std::invoke(*sharedTask);
-			}
-		);
-		createdTaskId = task->taskId;
+	if (!running)
+		return InvalidTaskId;
 
-		MutexGuard lock(queueMutex);
-		incompleteTasks.insert(std::make_pair(task->taskId, task));
-		waitingTaskQueue.push(task);
-	}
+	// Task return value determines if it will be rescheduled
+	SharedScheduledTask task = createTask(
+		priority,
+		startImmediately ? Time::now() : Time::now() + interval,
+		interval,
+		std::move(function)
+	);
 
-	schedulerCondition.notifyAll();
+	const SchedulerTaskId createdTaskId = task->taskId;
+	submit(std::move(task));
 
 	return createdTaskId;
 }
@@ -0,0 +1,78 @@
+#version 130
+
+// WebM frames uploaded as packed 8-bit planes, four samples per texel.
+// Layout in bytes, aligned width being the frame width aligned to 8:
+//   Y rows at column 0
+//   U rows at column alignedWidth, V rows right below them
+//   A rows at column alignedWidth * 1.5 (only if u_hasAlpha)
+// Must match ImageBackgroundLoaderWebm::getPlanarLayout.
+
+uniform sampler2D u_texture;
+uniform vec2 u_frameSize;
+uniform bool u_hasAlpha;
+
+vec3 yuvtorgb(vec3 yuv)
+{
+	float y = 1.1643 * (yuv.r - 0.0625);
+	float u = yuv.g - 0.5;
+	float v = yuv.b - 0.5;
+
+	float r = y + 1.5958 * v;
+	float g = y - 0.39173 * u - 0.81290 * v;
+	float b = y + 2.017 * u;
+
+	return vec3(r, g, b);
+}
+
+float fetchSample(int column, int row)
+{
+	vec4 texel = texelFetch(u_texture, ivec2(column >> 2, row), 0);
+	int component = column & 3;
+	if (component == 0) return texel.r;
+	if (component == 1) return texel.g;
+	if (component == 2) return texel.b;
+	return texel.a;
+}
+
+// Samples are packed so texture filtering can't be used, filter by hand instead
+float samplePlane(vec2 position, ivec2 planeSize, ivec2 planeOffset)
+{
+	vec2 p = position - vec2(0.5);
+	vec2 f = fract(p);
+
+	ivec2 base = ivec2(floor(p));
+	ivec2 p0 = clamp(base, ivec2(0), planeSize - ivec2(1)) + planeOffset;
+	ivec2 p1 = clamp(base + ivec2(1), ivec2(0), planeSize - ivec2(1)) + planeOffset;
+
+	float s00 = fetchSample(p0.x, p0.y);
+	float s10 = fetchSample(p1.x, p0.y);
+	float s01 = fetchSample(p0.x, p1.y);
+	float s11 = fetchSample(p1.x, p1.y);
+
+	return mix(mix(s00, s10, f.x), mix(s01, s11, f.x), f.y);
+}
+
+void main()
+{
+	ivec2 frameSize = ivec2(u_frameSize);
+	ivec2 chromaSize = (frameSize + ivec2(1)) / 2;
+	int alignedWidth = (frameSize.x + 7) & ~7;
+
+	// Texture coordinates are given in frame pixels, normalized by the packed texture size
+	vec2 position = gl_TexCoord[0].xy * vec2(textureSize(u_texture, 0));
+
+	vec3 yuv = vec3(
+		samplePlane(position, frameSize, ivec2(0, 0)),
+		samplePlane(position * 0.5, chromaSize, ivec2(alignedWidth, 0)),
+		samplePlane(position * 0.5, chromaSize, ivec2(alignedWidth, chromaSize.y))
+	);
+
+	float alpha = 1.0;
+	if (u_hasAlpha)
+		alpha = samplePlane(position, frameSize, ivec2(alignedWidth + alignedWidth / 2, 0));
+
+	gl_FragColor = mix(
+		vec4(1.0, 0.0, 1.0, 1.0),
+		vec4(yuvtorgb(yuv), 1.0),
+		alpha) * gl_Color;
+}